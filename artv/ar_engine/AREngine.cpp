@@ -4,6 +4,9 @@
 // Licensed under The MIT License[see LICENSE for details]
 // Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
 ///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cfloat>
+#include <climits>
 #include <opencv2/features2d.hpp>
 
 #include <common/OSUtils.h>
@@ -14,285 +17,745 @@ using namespace std;
 using namespace cv;
 
 namespace ar {
+	namespace {
+		//! Project corners in the world into a frame, in undistorted pixels.
+		//	@return False if any corner is behind the camera.
+		bool ProjectCorners(const array<Vec3d, 4>& corners, const Matx33d& R, const Vec3d& t, const Matx33d& K,
+							vector<Point2f>& quad) {
+			quad.clear();
+			for (auto& corner : corners) {
+				Vec3d x = K * (R * corner + t);
+				if (x[2] <= 0)
+					return false;
+				quad.push_back(Point2f(float(x[0] / x[2]), float(x[1] / x[2])));
+			}
+			return true;
+		}
+
+		//! Whether a point is inside a convex quad, which is mirrored if its plane is seen from behind.
+		bool InsideQuad(const vector<Point2f>& quad, const Point2f& pt) {
+			double sign = (quad[1] - quad[0]).cross(quad[3] - quad[0]) > 0 ? 1 : -1;
+			for (int k = 0; k < 4; ++k)
+				if (sign * (quad[(k + 1) % 4] - quad[k]).cross(pt - quad[k]) <= 0)
+					return false;
+			return true;
+		}
+	}
+
 	//! Estimate the 3D location of the interest points with the latest keyframe asynchronously.
 	//	Perform bundle adjustment based on the rough estimation of the extrinsics.
-	void AREngine::EstimateMap() {
+	bool AREngine::EstimateMap() {
 		// TODO: Need implementation. Remember to calculate the average depth!
+		return plane_detector_.Update();
 	}
 
-	void AREngine::MapEstimationLoop() {
-		++thread_cnt_;
-		while (interest_points_.empty() && !to_terminate_)
-			AR_SLEEP(1);
-		while (!to_terminate_)
+	void AREngine::ScheduleMapping() {
+		if (mapping_scheduled_.exchange(true))
+			return;
+		mapping_tasks_.Run([this] {
+			mapping_scheduled_ = false;
 			EstimateMap();
-		--thread_cnt_;
+		});
 	}
 
-	void AREngine::CallMapEstimationLoop(AREngine* engine) {
-		engine->MapEstimationLoop();
+	AREngine::~AREngine() {
+		mapping_tasks_.Cancel();
+		anchor_tasks_.Cancel();
+		mapping_tasks_.Wait();
+		anchor_tasks_.Wait();
 	}
 
-	AREngine::~AREngine() {
-		to_terminate_ = true;
-		do {
-			AR_SLEEP(1);
-		} while (thread_cnt_);
+	AREngine::AREngine(const AREngineConfig& config, WorkerPool* pool) :
+		own_pool_(pool ? NULL : new WorkerPool),
+		pool_(pool ? pool : own_pool_.get()),
+		mapping_tasks_(*pool_, TASK_MAPPING),
+		anchor_tasks_(*pool_, TASK_MAPPING),
+		mapping_scheduled_(false),
+		config_(config),
+		descriptor_pool_(make_shared<DescriptorPool>()),
+		interest_points_tracker_(config.CreateDetector(), config.CreateMatcher()) {
+		ApplyConfig();
+		interest_points_tracker_.SetWorkerPool(pool_);
+		pose_disambiguator_.SetWorkerPool(pool_);
+		compositor_.SetWorkerPool(pool_);
+	}
+
+	AREngine::MemoryUsage AREngine::GetMemoryUsage() const {
+		MemoryUsage usage;
+		usage.frame_arena = frame_arena_.Capacity();
+		usage.descriptors = descriptor_pool_->Bytes();
+		for (auto& ip : interest_points_)
+			usage.interest_points += ip->MemoryUsage();
+		usage.num_interest_points = int(interest_points_.size());
+		usage.keyframes = keyframe_graph_.Bytes();
+		usage.num_keyframes = keyframe_graph_.Size();
+		return usage;
+	}
+
+	void AREngine::RetireVObject(unordered_map<int, VObject*>::iterator it) {
+		{
+			lock_guard<mutex> lock(interaction_mutex_);
+			vobject_ids_.erase(it->first);
+		}
+		if (drag_.id == it->first)
+			drag_.id = -1;
+		retired_vobjects_.push_back(it->second);
+		virtual_objects_.erase(it);
 	}
 
-	AREngine::AREngine() : interest_points_tracker_(ORB::create(), DescriptorMatcher::create("FLANNBASED")) {
-		mapping_thread_ = thread(AREngine::CallMapEstimationLoop, this);
+	void AREngine::RemoveVObject(int id) {
+		lock_guard<mutex> lock(interaction_mutex_);
+		pending_removals_.push_back(id);
 	}
 
-	//! If we have stored too many interest points, we remove the oldest location record
-	//	of the interest points, and remove the interest points that are determined not visible anymore.
-	void AREngine::ReduceInterestPoints() {
-		if (interest_points_.size() > MAX_INTEREST_POINTS) {
-			int new_size = int(interest_points_.size());
-			for (int i = 0; i < new_size; ++i) {
-				if (interest_points_[i]->ToDiscard()) {
-					interest_points_[i] = interest_points_[--new_size];
-					--i;
+	void AREngine::RemoveExpiredVObjects() {
+		auto now = chrono::steady_clock::now();
+		for (auto it = virtual_objects_.begin(); it != virtual_objects_.end();) {
+			auto next = it;
+			++next;
+			if (now - it->second->GetLastViewedTime() > chrono::milliseconds(max_idle_period_))
+				RetireVObject(it);
+			it = next;
+		}
+	}
+
+	void AREngine::ApplyConfig() {
+		interest_points_tracker_.SetDetector(config_.CreateDetector());
+		interest_points_tracker_.UseOrbExtractor(config_.detector_type == DETECTOR_PARALLEL_ORB, config_.GetOrbOptions());
+		interest_points_tracker_.SetMatcher(config_.CreateMatcher());
+		interest_points_tracker_.SetMatchRatio(config_.nn_match_ratio);
+		interest_points_tracker_.SetRansacThresh(config_.ransac_thresh);
+	}
+
+	void AREngine::SetConfig(const AREngineConfig& config) {
+		config_ = config;
+		ApplyConfig();
+		if (quality_controller_)
+			quality_controller_.reset(new AdaptiveQualityController(config_, quality_controller_->GetTargetFrameTime()));
+	}
+
+	void AREngine::EnableAdaptiveQuality(double target_frame_ms) {
+		// The controller degrades from the config set by the user, not from a degraded one.
+		if (quality_controller_) {
+			config_ = quality_controller_->GetBase();
+			ApplyConfig();
+			quality_controller_.reset();
+		}
+		if (target_frame_ms > 0)
+			quality_controller_.reset(new AdaptiveQualityController(config_, target_frame_ms));
+	}
+
+	void AREngine::MaintainLandmarks() {
+		// Points found in fewer frames than this are not judged by their found ratio.
+		const int MIN_SEARCHES = 8;
+		int n = int(interest_points_.size());
+		if (!n)
+			return;
+		double* scores = frame_arena_.AllocateArray<double>(n);
+		int* order = frame_arena_.AllocateArray<int>(n);
+		bool* removed = frame_arena_.AllocateArray<bool>(n);
+		int num_kept = n;
+		for (int i = 0; i < n; ++i) {
+			auto& ip = interest_points_[i];
+			scores[i] = ip->Quality(config_.ransac_thresh);
+			order[i] = i;
+			removed[i] = ip->ToDiscard(frame_id_) ||
+				(ip->search_cnt() >= MIN_SEARCHES && ip->FoundRatio() < config_.min_found_ratio);
+			num_kept -= removed[i];
+		}
+		// The most useful points first.
+		sort(order, order + n, [scores](int a, int b) { return scores[a] > scores[b]; });
+
+		// Fuse the duplicates. A point is fused into a more useful one in its cell, which
+		// takes over its observations at keyframes.
+		double depth = keyframe_graph_.Empty() ? 0 : keyframe_graph_.Get(keyframe_graph_.Last()).average_depth;
+		if (depth > 0 && config_.fusion_cell_rate > 0) {
+			landmark_hash_.Reset(depth * config_.fusion_cell_rate);
+			for (int k = 0; k < n; ++k) {
+				int i = order[k];
+				auto& ip = interest_points_[i];
+				if (removed[i] || !ip->has_loc3d() || ip->average_desc_.empty())
+					continue;
+				int target = -1;
+				landmark_hash_.ForEachInCell(ip->loc3d_, [&](int j) {
+					if (target < 0 &&
+						norm(ip->average_desc_, interest_points_[j]->average_desc_, NORM_HAMMING) <= config_.fusion_max_hamming)
+						target = j;
+				});
+				if (target < 0) {
+					landmark_hash_.Insert(ip->loc3d_, i);
+					continue;
 				}
+				interest_points_[target]->MergeKeyframeObservations(*ip);
+				keyframe_graph_.ReplaceLandmark(ip->id(), interest_points_[target]->id());
+				removed[i] = true;
+				--num_kept;
 			}
-			interest_points_.resize(new_size);
 		}
+
+		// Discard the least useful points until both budgets are met.
+		size_t bytes = 0;
+		for (int i = 0; i < n; ++i)
+			if (!removed[i])
+				bytes += interest_points_[i]->MemoryUsage() + interest_points_[i]->KeyframeDescriptorBytes();
+		for (int k = n - 1; k >= 0 && (num_kept > config_.max_interest_points || bytes > config_.max_landmark_bytes); --k) {
+			int i = order[k];
+			if (removed[i])
+				continue;
+			removed[i] = true;
+			--num_kept;
+			bytes -= interest_points_[i]->MemoryUsage() + interest_points_[i]->KeyframeDescriptorBytes();
+		}
+
+		int new_size = 0;
+		for (int i = 0; i < n; ++i) {
+			if (removed[i])
+				keyframe_graph_.RemoveLandmark(interest_points_[i]->id());
+			else
+				interest_points_[new_size++] = move(interest_points_[i]);
+		}
+		interest_points_.resize(new_size);
 	}
 
-	void AREngine::UpdateInterestPoints(const cv::Mat& scene) {
-		// Generate new keypoints.
-		std::vector<cv::KeyPoint> keypoints;
-		cv::Mat descriptors;
-		interest_points_tracker_.GenKeypointsDesc(scene, keypoints, descriptors);
+	void AREngine::UpdateInterestPoints(bool update_map) {
+		// Maintain before matching, so that the indices of the interest points stay valid
+		// for the rest of the frame.
+		if (update_map)
+			MaintainLandmarks();
+
+		// Generate new keypoints. The keypoint vector keeps its capacity across frames,
+		// and the descriptors live in the frame arena.
+		auto& keypoints = frame_keypoints_;
+		auto& descriptors = frame_descriptors_;
+		descriptors.allocator = frame_arena_.GetMatAllocator();
+		interest_points_tracker_.GenKeypointsDesc(frame_pyramid_, keypoints, descriptors);
+		// Tracking works on undistorted pixels. Only the keypoints are undistorted, not the frame.
+		if (camera_model_.HasDistortion())
+			for (auto& kp : keypoints)
+				kp.pt = camera_model_.UndistortPixel(kp.pt);
 
-		// Match the new keypoints to the stored keypoints.
-		cv::Mat stored_descriptors;
+		// Match the new keypoints to the stored keypoints. Interest points that have
+		// not been visible for a while have no descriptor and are left out.
+		int* stored_ids = frame_arena_.AllocateArray<int>(interest_points_.size());
+		int num_stored = 0;
 		for (int i = 0; i < interest_points_.size(); ++i)
-			vconcat(stored_descriptors, interest_points_[i]->average_desc_);
-		auto matches = interest_points_tracker_.MatchKeypoints(descriptors, stored_descriptors);
+			if (!interest_points_[i]->average_desc_.empty())
+				stored_ids[num_stored++] = i;
+		Mat stored_descriptors;
+		if (num_stored && !descriptors.empty()) {
+			stored_descriptors = frame_arena_.NewMat(num_stored, descriptors.cols, descriptors.type());
+			for (int i = 0; i < num_stored; ++i) {
+				interest_points_[stored_ids[i]]->average_desc_.copyTo(stored_descriptors.row(i));
+				interest_points_[stored_ids[i]]->CountSearch();
+			}
+		}
+		auto& matches = frame_matches_;
+		matches.clear();
+		if (!stored_descriptors.empty())
+			interest_points_tracker_.MatchKeypoints(descriptors, stored_descriptors, matches);
 
-		// Update the stored keypoints.
-		bool* matched_new = new bool[keypoints.size()];
-		bool* matched_stored = new bool[interest_points_.size()];
+		// Update the stored keypoints. Interest points not matched in this frame need
+		// no update, since they simply have no record of it.
+		frame_observed_.clear();
+		bool* matched_new = frame_arena_.AllocateArray<bool>(keypoints.size());
 		memset(matched_new, 0, sizeof(bool) * keypoints.size());
-		memset(matched_stored, 0, sizeof(bool) * interest_points_.size());
 		for (auto match : matches) {
 			matched_new[match.first] = true;
-			matched_stored[match.second] = true;
-			interest_points_[match.second]->AddObservation(
-				InterestPoint::Observation(keypoints[match.first], descriptors.row(match.first)));
+			if (!InterestPoint::PackedObservation::Representable(keypoints[match.first].pt))
+				continue;
+			interest_points_[stored_ids[match.second]]->AddObservation(
+				frame_id_, keypoints[match.first], update_map ? descriptors.row(match.first) : Mat());
+			frame_observed_.push_back({ stored_ids[match.second], match.first });
 		}
-		// These interest points are not ever visible in the previous frames.
+		if (!update_map)
+			return;
+		// These interest points are not ever visible in the previous frames. Keypoints
+		// undistorted too far out to be recorded are dropped.
 		for (int i = 0; i < keypoints.size(); ++i)
-			if (!matched_new[i])
+			if (!matched_new[i] && InterestPoint::PackedObservation::Representable(keypoints[i].pt)) {
+				frame_observed_.push_back({ int(interest_points_.size()), i });
 				interest_points_.push_back(shared_ptr<InterestPoint>(
-					new InterestPoint(frame_id_, keypoints[i], descriptors.row(i))));
-		// These interest points are not visible at this frame.
-		for (int i = 0; i < interest_points_.size(); ++i)
-			interest_points_[i]->AddObservation(InterestPoint::Observation());
-		delete[] matched_new;
-		delete[] matched_stored;
+					new InterestPoint(next_landmark_id_++, frame_id_, config_.max_observations, keypoints[i], descriptors.row(i))));
+			}
+	}
 
-		ReduceInterestPoints();
+	void AREngine::AddKeyframe(Keyframe kf) {
+		// The keyframe refers to its landmarks by IDs, which stay valid as the interest
+		// points are reduced, instead of holding the points.
+		kf.landmarks.clear();
+		kf.landmarks.reserve(frame_observed_.size());
+		for (auto& o : frame_observed_) {
+			auto& ip = interest_points_[o.first];
+			ip->PinKeyframe(frame_id_, descriptor_pool_, frame_descriptors_.row(o.second));
+			kf.landmarks.push_back(ip->id());
+		}
+		// Hand the landmarks to the plane detector. The world is the camera coordinate of
+		// the first keyframe, whose y axis points down.
+		vector<Vec3d> landmarks;
+		landmarks.reserve(interest_points_.size());
+		for (auto& ip : interest_points_)
+			if (ip->has_loc3d())
+				landmarks.push_back(Vec3d(ip->loc3d_));
+		plane_detector_.SubmitLandmarks(move(landmarks), Vec3d(0, 1, 0), -(kf.R.t() * kf.t));
+		vector<int> former_local_keyframes = local_keyframes_;
+		keyframe_graph_.LocalKeyframes(keyframe_graph_.Add(move(kf)), config_.max_keyframes, local_keyframes_);
+		// Keyframes leaving the local map give back the descriptors pinned at them, so that
+		// the memory of a point is bounded by the local map rather than the session.
+		for (int i : former_local_keyframes) {
+			if (find(local_keyframes_.begin(), local_keyframes_.end(), i) != local_keyframes_.end())
+				continue;
+			int frame_id = keyframe_graph_.Get(i).frame_id;
+			for (auto& ip : interest_points_)
+				ip->UnpinKeyframe(frame_id);
+		}
+		// The map is refined on each new keyframe.
+		ScheduleMapping();
 	}
 
-	Keyframe::Keyframe(int _frame_id,
-					   Mat _intrinsics,
-					   vector<shared_ptr<InterestPoint>> _interest_points,
-					   Mat _R,
-					   Mat _t,
-					   double _average_depth) :
-		frame_id(_frame_id), 
-		intrinsics(_intrinsics), 
-		interest_points(_interest_points),
-		R(_R), t(_t),
-		average_depth(_average_depth) {}
+	ERROR_CODE AREngine::FeedScene(const Mat& raw_scene) {
+		auto start_time = chrono::steady_clock::now();
+		last_raw_frame_ = raw_scene;
+		last_yuv_owner_.reset();
+		frame_pyramid_.Build(raw_scene);
+		return TrackFrame(start_time);
+	}
 
-	void AREngine::AddKeyframe(Keyframe& kf) {
-		keyframe(++keyframe_seq_tail_) = kf;
-		if (keyframe_seq_tail_ >= (MAX_KEYFRAMES << 1))
-			keyframe_seq_tail_ -= MAX_KEYFRAMES;
+	ERROR_CODE AREngine::FeedScene(const YUVFrame& raw_scene) {
+		if (!raw_scene.IsValid())
+			return AR_INVALID_INPUT;
+		auto start_time = chrono::steady_clock::now();
+		last_raw_frame_ = Mat();
+		last_yuv_owner_ = raw_scene.owner;
+		// The Y plane is the gray image, so the pyramid starts from it without a copy.
+		frame_pyramid_.Build(raw_scene.Luma());
+		return TrackFrame(start_time);
 	}
 
-	ERROR_CODE AREngine::FeedScene(const Mat& raw_scene) {
+	ERROR_CODE AREngine::TrackFrame(chrono::steady_clock::time_point start_time) {
+		last_frame_time_ = start_time;
+		last_frame_quality_ = FrameQuality();
+		if (config_.frame_gate && !keyframe_graph_.Empty())
+			last_frame_quality_ = frame_gate_.Evaluate(frame_pyramid_);
+		if (last_frame_quality_.decision == FRAME_REUSE_POSE) {
+			// The scene is the one tracked last, so the frame takes its ID and the objects
+			// keep their outlines in it. They still look at the new scene for occlusions.
+			pose_predictor_.AddPose(start_time, last_R_, last_t_);
+			FinishFrame(start_time);
+			return AR_SUCCESS;
+		}
+		// Blurry frames give poor keypoints, so they are tracked but kept out of the map.
+		bool update_map = last_frame_quality_.decision == FRAME_FULL;
+
 		++frame_id_;
+		// All the transient buffers of the last frame are released by now.
+		frame_descriptors_.release();
+		frame_arena_.Reset();
 
-		last_raw_frame_ = raw_scene;
-		cvtColor(last_raw_frame_, last_gray_frame_, COLOR_BGR2GRAY);
+		// The semi-direct tracker falls back to the features on the frames it cannot track
+		// and on keyframes, which need descriptors.
+		bool semi_direct = config_.tracker_type == TRACKER_SEMI_DIRECT;
+		bool tracked = semi_direct && TrackDirect(start_time);
+		if (!tracked)
+			tracked = TrackFeatures(update_map, start_time);
+		if (semi_direct && tracked) {
+			sparse_aligner_.SetReference(frame_pyramid_);
+			aligner_reference_frame_ = frame_id_;
+		}
+
+		FinishFrame(start_time);
+		return AR_SUCCESS;
+	}
 
-		UpdateInterestPoints(raw_scene);
+	bool AREngine::TrackFeatures(bool update_map, chrono::steady_clock::time_point start_time) {
+		UpdateInterestPoints(update_map);
 
-		if (keyframe_seq_tail_ == -1)
+		if (keyframe_graph_.Empty()) {
 			// Initial keyframe.
 			AddKeyframe(Keyframe(frame_id_,
-								 intrinsics_,
-								 interest_points_,
-								 Mat::eye(3, 3, CV_64F),
-								 Mat::zeros(3, 1, CV_64F),
+								 camera_model_.K(),
+								 Matx33d::eye(),
+								 Vec3d(0, 0, 0),
 								 0));
+			pose_predictor_.AddPose(start_time, Matx33d::eye(), Vec3d(0, 0, 0));
+			return true;
+		}
 		else {
-			auto& last_keyframe = keyframe(keyframe_seq_tail_);
-
-			// TODO: Estimate the fundamental matrix from the last keyframe.
-			Mat fundamental_matrix;
-
-			// Estimate the essential matrix.
-			Mat essential_matrix = intrinsics_.t() * fundamental_matrix * last_keyframe.intrinsics;
-
-			// Call RecoverRotAndTranslation to recover rotation and translation.
-			auto candidates = RecoverRotAndTranslation(essential_matrix);
-			Mat R, t;
-			Mat pts3d;
-			// Test for the only valid rotation and translation combination.
-			{
-				// Utilize at most 2 previous keyframes for bundled estimation.
-				// Find the interest points that are visible in these keyframes.
-				vector<int> utilized_interest_points;
-				utilized_interest_points.reserve(interest_points_.size());
-				for (int i = 0; i < interest_points_.size(); ++i) {
-					bool usable = true;
-					for (int j = 0; j <= max(1, keyframe_seq_tail_); ++j) {
-						int frame_id = keyframe(keyframe_seq_tail_ - j).frame_id;
-						if (!interest_points_[i]->observation(frame_id).visible) {
-							usable = false;
-							break;
-						}
+			// Utilize at most 2 keyframes of the local map for bundled estimation: the last
+			// keyframe, and the one sharing the most landmarks with it.
+			// Find the interest points that are visible in these keyframes and the current frame.
+			int num_keyframes = min(2, int(local_keyframes_.size()));
+			auto& last_keyframe = keyframe_graph_.Get(local_keyframes_[0]);
+			ArenaVector<int> utilized_interest_points(frame_arena_);
+			utilized_interest_points.reserve(interest_points_.size());
+			for (int i = 0; i < interest_points_.size(); ++i) {
+				bool usable = interest_points_[i]->observation(frame_id_).visible;
+				for (int j = 0; j < num_keyframes && usable; ++j)
+					usable = interest_points_[i]->observation(keyframe_graph_.Get(local_keyframes_[j]).frame_id).visible;
+				if (usable)
+					utilized_interest_points.push_back(i);
+			}
+
+			// At least 8 correspondences are needed for the fundamental matrix.
+			if (utilized_interest_points.size() >= 8) {
+				auto GetObservedPoints = [&](int frame_id) {
+					Mat pts = frame_arena_.NewMat(int(utilized_interest_points.size()), 2, CV_32F);
+					for (int k = 0; k < utilized_interest_points.size(); ++k) {
+						auto& loc = interest_points_[utilized_interest_points[k]]->observation(frame_id).pt;
+						pts.at<float>(k, 0) = loc.x;
+						pts.at<float>(k, 1) = loc.y;
 					}
-					if (usable)
-						utilized_interest_points.push_back(i);
+					return pts;
+				};
+				// Fill the data for 3D reconstruction from the previous keyframes, the last keyframe first.
+				ArenaVector<pair<Mat, Mat>> data(frame_arena_);
+				data.reserve(num_keyframes + 1);
+				for (int i = 0; i < num_keyframes; ++i) {
+					auto& kf = keyframe_graph_.Get(local_keyframes_[i]);
+					Mat camera_matrix = frame_arena_.NewMat(3, 4, CV_64F);
+					*camera_matrix.ptr<Matx34d>() = kf.intrinsics * SE3(kf.R, kf.t).Matrix();
+					data.push_back(make_pair(camera_matrix, GetObservedPoints(kf.frame_id)));
 				}
-				// Fill the data for 3D reconstruction from the previous keyframes.
-				vector<pair<Mat, Mat>> data;
-				for (int i = 0; i < max(1, keyframe_seq_tail_); ++i) {
-					auto& kf = keyframe(keyframe_seq_tail_ - i);
-					int frame_id = kf.frame_id;
-					Mat pts(utilized_interest_points.size(), 2, CV_32F);
-					for (auto ip_id : utilized_interest_points)
-						pts.row(ip_id) = Mat(interest_points_[ip_id]->observation(frame_id).pt.pt, false);
-					Mat extrinsics;
-					hconcat(kf.R, kf.t, extrinsics);
-					data.push_back(make_pair(kf.intrinsics * extrinsics, pts));
-				}
-				// Fill the data from the current frame.
-				Mat pts(utilized_interest_points.size(), 2, CV_32F);
-				for (auto ip_id : utilized_interest_points)
-					pts.row(ip_id) = Mat(interest_points_[ip_id]->observation(frame_id_).pt.pt, false);
-				data.push_back(make_pair(Mat(), pts));
-				// Try each candidate of extrinsics.
-				Mat bestM2;
-				double least_error = DBL_MAX;
-				for (int i = 0; i < interest_points_.size(); ++i)
-					if (interest_points_[i]->observation(frame_id_).visible &&
-						interest_points_[i]->observation(frame_id_ - 1).visible &&
-						interest_points_[i]->observation(frame_id_ - 2).visible)
-						for (auto& M2 : candidates) {
-							data.back().first = intrinsics_ * M2;
-							Mat estimated_pts3d;
-							double err;
-							triangulate(data, estimated_pts3d, &err);
-							// These 3D points are valid if they are in front of the camera in the previous keyframes.
-							bool valid = true;
-							for (int j = 0; j <= max(1, keyframe_seq_tail_) && valid; ++j) {
-								auto& kf = keyframe(keyframe_seq_tail_ - j);
-								Mat transformed_pts3d = kf.R * estimated_pts3d + kf.t;
-								for (int k = 0; k < transformed_pts3d.rows; ++k)
-									if (transformed_pts3d.at<float>(k, 3) < 0) {
-										valid = false;
-										break;
-									}
+				// Fill the data from the current frame. Its camera matrix is given by the pose disambiguator.
+				data.push_back(make_pair(frame_arena_.NewMat(3, 4, CV_64F), GetObservedPoints(frame_id_)));
+
+				// Estimate the fundamental matrix from the last keyframe.
+				Mat fundamental_matrix = findFundamentalMat(data.front().second, data.back().second,
+															FM_RANSAC, config_.ransac_thresh, 0.99);
+				if (fundamental_matrix.rows == 3) {
+					// Estimate the essential matrix.
+					Matx33d essential_matrix = camera_model_.K().t() * Matx33d(fundamental_matrix) * last_keyframe.intrinsics;
+
+					// Call RecoverRotAndTranslation to recover rotation and translation,
+					// and test for the only valid combination.
+					auto candidates = RecoverRotAndTranslation(essential_matrix);
+					PoseDisambiguator::Result pose;
+					auto keyframe_pair = make_pair(last_keyframe.frame_id,
+												   num_keyframes > 1 ? keyframe_graph_.Get(local_keyframes_[1]).frame_id : -1);
+					// The depths of the points already in the map fix the scale of the translation.
+					SE3 keyframe_pose(last_keyframe.R, last_keyframe.t);
+					double* map_depths = frame_arena_.AllocateArray<double>(utilized_interest_points.size());
+					for (int k = 0; k < utilized_interest_points.size(); ++k) {
+						auto& ip = interest_points_[utilized_interest_points[k]];
+						map_depths[k] = ip->has_loc3d() ? (keyframe_pose * Vec3d(ip->loc3d_))[2] : 0;
+					}
+					if (pose_disambiguator_.Disambiguate(candidates.data(), int(candidates.size()), camera_model_.K(),
+														 keyframe_pose, data.data(), int(data.size()), keyframe_pair,
+														 map_depths, last_keyframe.average_depth, pose) == AR_SUCCESS) {
+						// The first keyframe has no depth until a frame is triangulated with it.
+						if (last_keyframe.average_depth <= 0)
+							last_keyframe.average_depth = pose.ref_average_depth;
+						last_R_ = pose.R;
+						last_t_ = pose.t;
+						pose_predictor_.AddPose(start_time, pose.R, pose.t);
+
+						// Keep the triangulated locations, with their errors in the current frame.
+						if (update_map && pose.points3d.rows == utilized_interest_points.size()) {
+							Matx34d P = data.back().first;
+							for (int k = 0; k < utilized_interest_points.size(); ++k) {
+								const double* X = pose.points3d.ptr<double>(k);
+								Vec3d x = P * Vec4d(X[0], X[1], X[2], 1);
+								if (x[2] <= 0)
+									continue;
+								auto& ip = interest_points_[utilized_interest_points[k]];
+								Point2f obs = ip->observation(frame_id_).pt;
+								ip->loc3d_ = Point3d(X[0], X[1], X[2]);
+								ip->reproj_error_ = sqrt(pow(x[0] / x[2] - obs.x, 2) + pow(x[1] / x[2] - obs.y, 2));
 							}
-							if (valid)
-								if (err < least_error) {
-									least_error = err;
-									bestM2 = M2;
-									pts3d = estimated_pts3d;
-								}
 						}
-				R = bestM2.colRange(0, 2);
-				t = bestM2.col(3);
+
+						if (update_map && KeyframeDue(pose.R, pose.t))
+							AddKeyframe(Keyframe(frame_id_,
+												 camera_model_.K(),
+												 pose.R,
+												 pose.t,
+												 pose.average_depth));
+						return true;
+					}
+				}
 			}
+		}
+		return false;
+	}
+
+	bool AREngine::KeyframeDue(const Matx33d& R, const Vec3d& t) const {
+		auto& last_keyframe = keyframe_graph_.Get(local_keyframes_[0]);
+		Vec3d center = -(R.t() * t);
+		Vec3d keyframe_center = -(last_keyframe.R.t() * last_keyframe.t);
+		return cv::norm(center - keyframe_center) > last_keyframe.average_depth / 5;
+	}
 
-			// Estimate the average depth.
-			Mat transformed_pts3d = R * pts3d + t;
-			int average_depth = sum(transformed_pts3d.col(2))[0];
+	bool AREngine::TrackDirect(chrono::steady_clock::time_point start_time) {
+		// The reference is the last frame, however it was tracked.
+		if (keyframe_graph_.Empty() || aligner_reference_frame_ != frame_id_ - 1 || !camera_model_.IsValid())
+			return false;
+		const SparseAlignOptions& options = sparse_aligner_.GetOptions();
 
-			// If the translation from the last keyframe is greater than some proportion of the depth, update the keyframes.
-			double distance = cv::norm(t, cv::NormTypes::NORM_L2);
-			if (distance > last_keyframe.average_depth / 5)
-				AddKeyframe(Keyframe(frame_id_,
-									 intrinsics_,
-									 interest_points_,
-									 last_keyframe.R * R,
-									 last_keyframe.t + t,
-									 average_depth));
+		// The located landmarks seen in the last frame, the most accurate ones if there are too many.
+		auto& landmarks = direct_landmarks_;
+		landmarks.clear();
+		for (int i = 0; i < interest_points_.size(); ++i)
+			if (interest_points_[i]->has_loc3d() && interest_points_[i]->observation(frame_id_ - 1).visible)
+				landmarks.push_back(i);
+		if (int(landmarks.size()) > options.max_points) {
+			nth_element(landmarks.begin(), landmarks.begin() + options.max_points, landmarks.end(), [this](int a, int b) {
+				return interest_points_[a]->reproj_error_ < interest_points_[b]->reproj_error_;
+			});
+			landmarks.resize(options.max_points);
+		}
+		SE3 reference(last_R_, last_t_);
+		direct_points_.clear();
+		for (int i : landmarks) {
+			Vec3d x = reference * Vec3d(interest_points_[i]->loc3d_);
+			if (x[2] > 0) {
+				landmarks[direct_points_.size()] = i;
+				direct_points_.push_back(x);
+			}
+		}
+		landmarks.resize(direct_points_.size());
+		if (int(landmarks.size()) < options.min_points)
+			return false;
+
+		// Start from the motion the predictor expects since the last frame, if any.
+		SE3 motion;
+		Matx33d R;
+		Vec3d t;
+		if (pose_predictor_.Predict(start_time, R, t))
+			motion = SE3(R, t) * reference.Inverse();
+		if (sparse_aligner_.Align(frame_pyramid_, camera_model_, direct_points_, motion, direct_errors_) < options.min_points)
+			return false;
+		SE3 pose = motion * reference;
+
+		// Keyframes need descriptors, so the features take over when one is due.
+		if (KeyframeDue(pose.R, pose.t))
+			return false;
+
+		// The landmarks whose patches still match are observed where the pose projects them.
+		float size = float(SparseImageAligner::PATCH_SIZE * FramePyramid::Scale(options.min_level));
+		for (int k = 0; k < landmarks.size(); ++k) {
+			auto& ip = interest_points_[landmarks[k]];
+			ip->CountSearch();
+			if (direct_errors_[k] < 0 || direct_errors_[k] > options.max_patch_error)
+				continue;
+			Vec3d x = camera_model_.K() * (motion * direct_points_[k]);
+			Point2f pt(float(x[0] / x[2]), float(x[1] / x[2]));
+			if (InterestPoint::PackedObservation::Representable(pt))
+				ip->AddObservation(frame_id_, KeyPoint(pt, size), Mat());
+		}
+		last_R_ = pose.R;
+		last_t_ = pose.t;
+		pose_predictor_.AddPose(start_time, pose.R, pose.t);
+		return true;
+	}
+
+	void AREngine::FinishFrame(chrono::steady_clock::time_point start_time) {
+		{
+			lock_guard<mutex> lock(draw_mutex_);
+			RemoveExpiredVObjects();
+			ApplyInteractions();
+			// Before indexing, as an occluded object is not opaque. Under the lock, as the
+			// occlusion masks are read while drawing.
+			if (config_.occlusion)
+				for (auto& obj : virtual_objects_)
+					obj.second->ObserveScene(frame_pyramid_, frame_id_);
+			UpdateVObjectIndex();
+			// The content moves on with the tracked frames, not with the renders, so that
+			// predicted renders at the display rate do not play it faster.
+			for (auto& entry : vobject_index_->DrawList())
+				entry.obj->AdvanceContent();
+			// Only now that the index is rebuilt is no removed object referred to.
+			for (auto obj : retired_vobjects_)
+				delete obj;
+			retired_vobjects_.clear();
+		}
+
+		if (quality_controller_) {
+			double frame_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+			if (quality_controller_->Update(frame_ms, config_))
+				ApplyConfig();
 		}
-		return AR_SUCCESS;
 	}
 
 	ERROR_CODE AREngine::GetMixedScene(const Mat& raw_scene, Mat& mixed_scene) {
 		FeedScene(raw_scene);
 
-		// TODO: Accumulate the motion data.
-		accumulated_motion_data_.clear();
+		// Objects off the screen or covered by others are not in the draw list.
+		if (!vobject_index_ || vobject_index_->DrawList().empty()) {
+			mixed_scene = raw_scene;
+			return AR_SUCCESS;
+		}
+		raw_scene.copyTo(mixed_scene);
+		lock_guard<mutex> lock(draw_mutex_);
+		compositor_.Compose(mixed_scene, vobject_index_->DrawList());
 
-		mixed_scene = raw_scene;
-		for (auto vobj : virtual_objects_) {
-			switch (vobj.second->GetType()) {
-			case VObjType::TV:
-				// TODO: Draw the virtual television on the mixed_scene.
-				break;
-			default:
-				return AR_UNIMPLEMENTED;
-			}
+		return AR_SUCCESS;
+	}
+
+	ERROR_CODE AREngine::GetPredictedMixedScene(const Mat& newest_scene,
+												chrono::steady_clock::time_point display_time,
+												Mat& mixed_scene) {
+		if (newest_scene.empty())
+			return AR_INVALID_INPUT;
+		lock_guard<mutex> draw_lock(draw_mutex_);
+		shared_ptr<const VObjectIndex> index;
+		chrono::steady_clock::time_point index_time;
+		Matx33d K;
+		bool calibrated;
+		{
+			lock_guard<mutex> lock(vobject_index_mutex_);
+			index = vobject_index_;
+			index_time = vobject_index_time_;
+			calibrated = vobject_index_calibrated_;
+			K = vobject_index_K_;
+		}
+		if (!index || index->DrawList().empty()) {
+			mixed_scene = newest_scene;
+			return AR_SUCCESS;
 		}
 
+		// Without the 3D corners of the objects, the outlines are only moved by the rotation,
+		// which maps the image by K * R * K^-1. The rotation causes most of the lag anyway.
+		Matx33d reprojection = Matx33d::eye();
+		Matx33d rotation;
+		if (calibrated && pose_predictor_.PredictRotation(index_time, display_time, rotation))
+			reprojection = K * rotation * K.inv();
+		newest_scene.copyTo(mixed_scene);
+		compositor_.Compose(mixed_scene, index->DrawList(), reprojection);
+
+		return AR_SUCCESS;
+	}
+
+	ERROR_CODE AREngine::GetMixedScene(YUVFrame& scene) {
+		ERROR_CODE ret = FeedScene(scene);
+		if (ret != AR_SUCCESS)
+			return ret;
+
+		// Objects off the screen or covered by others are not in the draw list.
+		if (!vobject_index_ || vobject_index_->DrawList().empty())
+			return AR_SUCCESS;
+		lock_guard<mutex> lock(draw_mutex_);
+		compositor_.Compose(scene, vobject_index_->DrawList());
+
 		return AR_SUCCESS;
 	}
 
 	double InterestPoint::Observation::l2dist_sqr(const Observation& o) const {
-		return l2dist_sqr(o.pt.pt);
+		return l2dist_sqr(o.pt);
 	}
 
 	double InterestPoint::Observation::l2dist_sqr(const Point2f& p) const {
-		return pow(pt.pt.x - p.x, 2) + pow(pt.pt.y - p.y, 2);
+		return pow(pt.x - p.x, 2) + pow(pt.y - p.y, 2);
+	}
+
+	bool AREngine::ProjectCandidate(const ScreenCandidate& candidate, vector<Point2f>& quad) const {
+		return camera_model_.IsValid() && ProjectCorners(candidate.corners, last_R_, last_t_, camera_model_.K(), quad);
+	}
+
+	void AREngine::GetPlacementSuggestions(vector<vector<Point2f>>& quads) const {
+		quads.clear();
+		auto plane_map = plane_detector_.GetPlaneMap();
+		Rect2f frame(Point2f(0, 0), Size2f(frame_pyramid_.GetSize()));
+		vector<Point2f> quad;
+		for (auto& candidate : plane_map->candidates) {
+			if (!ProjectCandidate(candidate, quad))
+				continue;
+			bool inside = false;
+			for (auto& pt : quad) {
+				pt = camera_model_.DistortPixel(pt);
+				inside |= frame.contains(pt);
+			}
+			if (inside)
+				quads.push_back(quad);
+		}
 	}
 
-	ERROR_CODE AREngine::CreateTelevision(cv::Point location, FrameStream& content_stream) {
-		Canny(last_gray_frame_, last_canny_map_, 100, 200);
+	ERROR_CODE AREngine::CreateTelevision(cv::Point click, FrameStream& content_stream, int* created_id) {
+		lock_guard<mutex> lock(interaction_mutex_);
+		int id = rand();
+		while (vobject_ids_.count(id))
+			id = rand();
+		vobject_ids_.insert(id);
+		pending_televisions_.push_back({ id, click, &content_stream });
+		if (created_id)
+			*created_id = id;
+		return AR_SUCCESS;
+	}
+
+	void AREngine::PlaceTelevision(int id, Point click, FrameStream& content_stream) {
+		// The interest points are in undistorted pixels.
+		Point2f location = camera_model_.UndistortPixel(Point2f(click));
+
+		// A click inside a suggested placement takes it, which costs a scan of a bounded
+		// number of candidates instead of a search for a rectangle.
+		auto plane_map = plane_detector_.GetPlaneMap();
+		const ScreenCandidate* picked = NULL;
+		double picked_dist_sqr = DBL_MAX;
+		vector<Point2f> quad;
+		for (auto& candidate : plane_map->candidates) {
+			if (!ProjectCandidate(candidate, quad) || !InsideQuad(quad, location))
+				continue;
+			Point2f center = (quad[0] + quad[1] + quad[2] + quad[3]) * 0.25f;
+			double dist_sqr = (center - location).dot(center - location);
+			if (dist_sqr < picked_dist_sqr) {
+				picked = &candidate;
+				picked_dist_sqr = dist_sqr;
+			}
+		}
+		if (picked) {
+			auto corners = picked->corners;
+			ProjectCandidate(*picked, quad);
+			if ((quad[1] - quad[0]).cross(quad[3] - quad[0]) < 0) {
+				swap(corners[0], corners[1]);
+				swap(corners[2], corners[3]);
+			}
+			auto handle = new VTelevision(*this, id, content_stream);
+			handle->locate(corners);
+			virtual_objects_[id] = handle;
+			return;
+		}
+
+		// The edges are found at half resolution, which is enough to tell the borders of a television.
+		const int EDGE_LEVEL = 1;
+		const Mat& canny_map = frame_pyramid_.Edges(EDGE_LEVEL, 100, 200);
 		Mat dilated_canny;
-		dilate(last_canny_map_, dilated_canny, NULL);
+		dilate(canny_map, dilated_canny, Mat());
+		const float edge_scale = float(1 / FramePyramid::Scale(EDGE_LEVEL));
 
 		// Find the interest points that roughly form a rectangle in the real world that surrounds the given location.
-		vector<pair<double, shared_ptr<InterestPoint>>> left_uppers, left_lowers, right_uppers, right_lowers;
-		for (auto& ip : interest_points_) {
+		// The candidates are referred to by their indices in interest_points_. Television
+		// creation comes from the interaction path, so nothing here is taken from the frame arena.
+		vector<pair<double, int>> left_uppers, left_lowers, right_uppers, right_lowers;
+		double min_dist = min(frame_pyramid_.GetSize().height, frame_pyramid_.GetSize().width) * config_.mean_tv_size_rate;
+		for (int i = 0; i < interest_points_.size(); ++i) {
+			auto& ip = interest_points_[i];
 			double dist_sqr = ip->last_observation().l2dist_sqr(location);
-			if (dist_sqr > min(last_gray_frame_.rows, last_gray_frame_.cols) * VTelevision::MEAN_TV_SIZE_RATE) {
+			if (dist_sqr > min_dist * min_dist) {
 				if (ip->last_loc().x < location.x && ip->last_loc().y < location.y)
-					left_uppers.push_back({ dist_sqr, ip });
+					left_uppers.push_back({ dist_sqr, i });
 				else if (ip->last_loc().x > location.x && ip->last_loc().y < location.y)
-					right_uppers.push_back({ dist_sqr, ip });
+					right_uppers.push_back({ dist_sqr, i });
 				else if (ip->last_loc().x < location.x && ip->last_loc().y > location.y)
-					left_lowers.push_back({ dist_sqr, ip });
+					left_lowers.push_back({ dist_sqr, i });
 				else if (ip->last_loc().x > location.x && ip->last_loc().y > location.y)
-					right_lowers.push_back({ dist_sqr, ip });
+					right_lowers.push_back({ dist_sqr, i });
 			}
 		}
 		sort(left_uppers.begin(), left_uppers.end());
 		sort(right_uppers.begin(), right_uppers.end());
 		sort(left_lowers.begin(), left_lowers.end());
 		sort(right_lowers.begin(), right_lowers.end());
-		auto CountEdgeOnLine = [dilated_canny](const Point2f& start, const Point2f& end) {
-			double dx = end.x - start.x;
-			double dy = end.y - start.y;
-			double dist = sqrt(dx * dx + dy * dy);
-			dx /= dist;
-			dy /= dist;
-			double x = start.x + dx;
-			double y = start.y + dy;
+		auto CountEdgeOnLine = [this, &dilated_canny, edge_scale](const Point2f& start, const Point2f& end) {
+			double dist = norm(end - start) * edge_scale;
+			if (dist < 1)
+				return 0.0;
+			Rect bounds(0, 0, dilated_canny.cols, dilated_canny.rows);
 			int edge_cnt = 0;
-			for (int i = 1; i < dist; ++i)
-				if (dilated_canny.at<double>(y, x) > DBL_EPSILON)
+			for (int i = 1; i < dist; ++i) {
+				// The line is straight in undistorted pixels, while the edges are found in the frame.
+				Point2f q = camera_model_.DistortPixel(start + (end - start) * float(i / dist)) * edge_scale;
+				Point p(cvRound(q.x), cvRound(q.y));
+				if (bounds.contains(p) && dilated_canny.at<uchar>(p))
 					++edge_cnt;
+			}
 			return edge_cnt / dist;
 		};
 		shared_ptr<InterestPoint> lu_corner, ru_corner, ll_corner, rl_corner;
@@ -303,104 +766,505 @@ namespace ar {
 			for (auto& ru : right_uppers) {
 				if (found)
 					break;
-				if (CountEdgeOnLine(lu.second->last_loc(), ru.second->last_loc()) < 0.8)
+				if (CountEdgeOnLine(interest_points_[lu.second]->last_loc(), interest_points_[ru.second]->last_loc()) < 0.8)
 					break;
 				for (auto& ll : left_lowers) {
 					if (found)
 						break;
-					if (CountEdgeOnLine(lu.second->last_loc(), ll.second->last_loc()) < 0.8)
+					if (CountEdgeOnLine(interest_points_[lu.second]->last_loc(), interest_points_[ll.second]->last_loc()) < 0.8)
 						break;
 					for (auto& rl : right_lowers) {
-						if (CountEdgeOnLine(ru.second->last_loc(), rl.second->last_loc()) < 0.8)
+						if (CountEdgeOnLine(interest_points_[ru.second]->last_loc(), interest_points_[rl.second]->last_loc()) < 0.8)
 							break;
-						if (CountEdgeOnLine(ll.second->last_loc(), rl.second->last_loc()) < 0.8)
+						if (CountEdgeOnLine(interest_points_[ll.second]->last_loc(), interest_points_[rl.second]->last_loc()) < 0.8)
 							break;
 						found = true;
-						lu_corner = lu.second;
-						ru_corner = ru.second;
-						ll_corner = ll.second;
-						rl_corner = rl.second;
+						lu_corner = interest_points_[lu.second];
+						ru_corner = interest_points_[ru.second];
+						ll_corner = interest_points_[ll.second];
+						rl_corner = interest_points_[rl.second];
+						break;
 					}
 				}
 			}
 		}
 
 		// Create a virtual television, and locate it with respect to these interest points.
-		int id = rand();
-		while (virtual_objects_.count(id))
-			id = rand();
 		auto handle = new VTelevision(*this, id, content_stream);
 		handle->locate(lu_corner, ll_corner, ru_corner, rl_corner);
 		virtual_objects_[id] = handle;
-
-		return AR_SUCCESS;
 	}
 
 	int AREngine::GetTopVObj(int x, int y) const {
-		int highest_level = 0;
-		int top = -1;
-		for (auto vobj : virtual_objects_) {
-			if (vobj.second->IsSelected(Point2f(x, y), frame_id_)) {
-				if (vobj.second->layer_ind_ > highest_level) {
-					top = vobj.first;
-					highest_level = vobj.second->layer_ind_;
-				}
-			}
+		shared_ptr<const VObjectIndex> index;
+		{
+			lock_guard<mutex> lock(vobject_index_mutex_);
+			index = vobject_index_;
 		}
-		return top;
+		return index ? index->HitTest(camera_model_.UndistortPixel(Point2f(float(x), float(y)))) : -1;
+	}
+
+	void AREngine::UpdateVObjectIndex() {
+		// The spare index may still be used by a hit test that got it before the last swap.
+		if (!spare_vobject_index_ || spare_vobject_index_.use_count() > 1)
+			spare_vobject_index_ = make_shared<VObjectIndex>();
+		spare_vobject_index_->Build(virtual_objects_, frame_id_, frame_pyramid_.GetSize());
+		lock_guard<mutex> lock(vobject_index_mutex_);
+		swap(vobject_index_, spare_vobject_index_);
+		vobject_index_time_ = last_frame_time_;
+		vobject_index_calibrated_ = camera_model_.IsValid();
+		if (vobject_index_calibrated_)
+			vobject_index_K_ = camera_model_.K();
 	}
 
-	//!	Drag a virtual object to a location. The virtual object is stripped from the
-	//	real world by then, and its shape and size in the scene remain the same during
-	//	the dragging. Call FixVObj to fix the virtual object onto the real world again.
 	ERROR_CODE AREngine::DragVObj(int id, int x, int y) {
-		// TODO: This is only a fake function. Need real implementation.
+		if (id < 0)
+			return AR_INVALID_INPUT;
+		lock_guard<mutex> lock(interaction_mutex_);
+		pending_drag_id_ = id;
+		pending_drag_pt_ = Point2f(float(x), float(y));
 		return AR_SUCCESS;
 	}
 
-	//! Fix a virtual object that is floating to the real world. The orientation
-	//	and size might be adjusted to fit the new location.
 	ERROR_CODE AREngine::FixVObj(int id) {
-		// TODO: This is only a fake function. Need real implementation.
+		if (id < 0)
+			return AR_INVALID_INPUT;
+		lock_guard<mutex> lock(interaction_mutex_);
+		pending_fixes_.push_back(id);
 		return AR_SUCCESS;
 	}
 
-	InterestPoint::InterestPoint(int initial_frame_id): vis_cnt_(0), initial_frame_id_(initial_frame_id) {}
+	bool AREngine::IntersectPixelRay(const Point2f& pt, const Vec3d& normal, double d, Vec3d& x) const {
+		const Matx33d& K = camera_model_.K();
+		Vec3d ray = last_R_.t() * Vec3d((pt.x - K(0, 2)) / K(0, 0), (pt.y - K(1, 2)) / K(1, 1), 1);
+		Vec3d center = -(last_R_.t() * last_t_);
+		double denom = normal.dot(ray);
+		if (abs(denom) < 1e-12)
+			return false;
+		double s = -(normal.dot(center) + d) / denom;
+		if (s <= 0)
+			return false;
+		x = center + ray * s;
+		return true;
+	}
+
+	bool AREngine::StartDrag(int id, const Point2f& pt) {
+		drag_.id = -1;
+		auto it = virtual_objects_.find(id);
+		if (it == virtual_objects_.end())
+			return false;
+		VObject* obj = it->second;
+		auto& corners = drag_.start_corners;
+		if (obj->GetWorldCorners(corners)) {
+			Vec3d normal = (corners[1] - corners[0]).cross(corners[3] - corners[0]);
+			double length = norm(normal);
+			if (length < 1e-12)
+				return false;
+			drag_.normal = normal / length;
+			drag_.d = -drag_.normal.dot(corners[0]);
+		}
+		else {
+			// The object has no depth of its own, so it is laid on the nearest plane of
+			// the map behind it, or facing the camera at the median depth of the landmarks.
+			vector<Point2f> quad;
+			if (!obj->GetScreenQuad(frame_id_, quad))
+				return false;
+			Point2f center = (quad[0] + quad[1] + quad[2] + quad[3]) * 0.25f;
+			double nearest = DBL_MAX;
+			Vec3d eye = -(last_R_.t() * last_t_), hit;
+			for (auto& plane : plane_detector_.GetPlaneMap()->planes) {
+				if (IntersectPixelRay(center, plane.normal, plane.d, hit) && norm(hit - eye) < nearest) {
+					nearest = norm(hit - eye);
+					drag_.normal = plane.normal;
+					drag_.d = plane.d;
+				}
+			}
+			if (nearest == DBL_MAX) {
+				vector<double> depths;
+				for (auto& ip : interest_points_) {
+					if (!ip->has_loc3d())
+						continue;
+					double depth = (last_R_ * Vec3d(ip->loc3d_) + last_t_)[2];
+					if (depth > 0)
+						depths.push_back(depth);
+				}
+				if (depths.empty())
+					return false;
+				nth_element(depths.begin(), depths.begin() + depths.size() / 2, depths.end());
+				Vec3d axis(last_R_(2, 0), last_R_(2, 1), last_R_(2, 2));
+				drag_.normal = -axis;
+				drag_.d = axis.dot(eye + axis * depths[depths.size() / 2]);
+			}
+			for (int k = 0; k < 4; ++k)
+				if (!IntersectPixelRay(quad[k], drag_.normal, drag_.d, corners[k]))
+					return false;
+		}
+		if (!IntersectPixelRay(pt, drag_.normal, drag_.d, drag_.grab))
+			return false;
+		drag_.id = id;
+		return true;
+	}
+
+	void AREngine::ApplyInteractions() {
+		int drag_id;
+		Point2f drag_pt;
+		vector<int> fixes;
+		vector<TelevisionRequest> televisions;
+		vector<int> removals;
+		{
+			lock_guard<mutex> lock(interaction_mutex_);
+			drag_id = pending_drag_id_;
+			drag_pt = pending_drag_pt_;
+			pending_drag_id_ = -1;
+			fixes.swap(pending_fixes_);
+			televisions.swap(pending_televisions_);
+			removals.swap(pending_removals_);
+		}
+
+		// Objects are created and removed here, on the tracking thread, before the index
+		// is rebuilt from them.
+		for (auto& request : televisions)
+			PlaceTelevision(request.id, request.click, *request.content_stream);
+		for (int id : removals) {
+			auto it = virtual_objects_.find(id);
+			if (it != virtual_objects_.end())
+				RetireVObject(it);
+		}
+
+		if (drag_id >= 0 && camera_model_.IsValid()) {
+			Point2f pt = camera_model_.UndistortPixel(drag_pt);
+			Vec3d hit;
+			auto it = virtual_objects_.find(drag_id);
+			if (drag_.id != drag_id)
+				StartDrag(drag_id, pt);
+			else if (it == virtual_objects_.end())
+				drag_.id = -1;
+			else if (IntersectPixelRay(pt, drag_.normal, drag_.d, hit)) {
+				auto corners = drag_.start_corners;
+				for (auto& corner : corners)
+					corner += hit - drag_.grab;
+				it->second->MoveTo(corners);
+			}
+		}
+
+		for (int id : fixes) {
+			if (drag_.id == id)
+				drag_.id = -1;
+			auto it = virtual_objects_.find(id);
+			AnchorQuery query;
+			if (it == virtual_objects_.end() || !camera_model_.IsValid() || !it->second->GetWorldCorners(query.corners))
+				continue;
+			query.id = id;
+			query.R = last_R_;
+			query.t = last_t_;
+			query.K = camera_model_.K();
+			query.plane_map = plane_detector_.GetPlaneMap();
+			// The landmarks seen within half the size of the object around it.
+			vector<Point2f> quad;
+			if (it->second->GetScreenQuad(frame_id_, quad)) {
+				Rect2f bounds = boundingRect(quad);
+				bounds.x -= bounds.width / 2;
+				bounds.y -= bounds.height / 2;
+				bounds.width *= 2;
+				bounds.height *= 2;
+				for (auto& ip : interest_points_) {
+					if (!ip->has_loc3d())
+						continue;
+					auto obs = ip->observation(frame_id_);
+					if (obs.visible && bounds.contains(obs.pt))
+						query.landmarks.push_back(Vec3d(ip->loc3d_));
+				}
+			}
+			anchor_tasks_.Run([this, query] {
+				array<Vec3d, 4> corners;
+				if (FindAnchor(query, corners)) {
+					lock_guard<mutex> lock(anchor_mutex_);
+					found_anchors_.push_back(make_pair(query.id, corners));
+				}
+			});
+		}
+
+		vector<pair<int, array<Vec3d, 4>>> found;
+		{
+			lock_guard<mutex> lock(anchor_mutex_);
+			found.swap(found_anchors_);
+		}
+		for (auto& anchor : found) {
+			// An object picked up again before its anchor was found stays with the pointer.
+			if (anchor.first == drag_.id)
+				continue;
+			auto it = virtual_objects_.find(anchor.first);
+			if (it != virtual_objects_.end())
+				it->second->MoveTo(anchor.second);
+		}
+	}
+
+	bool AREngine::FindAnchor(const AnchorQuery& query, array<Vec3d, 4>& corners) {
+		const auto& dropped = query.corners;
+		double width = norm(dropped[1] - dropped[0]);
+		double height = norm(dropped[3] - dropped[0]);
+		Vec3d center = (dropped[0] + dropped[1] + dropped[2] + dropped[3]) * 0.25;
+		Vec3d eye = -(query.R.t() * query.t);
+		Vec3d ray = center - eye;
+		vector<Point2f> quad;
+		Vec3d x = query.K * (query.R * center + query.t);
+		if (x[2] <= 0)
+			return false;
+		Point2f drop(float(x[0] / x[2]), float(x[1] / x[2]));
+
+		// A suggested placement under the drop point is taken as it is.
+		const ScreenCandidate* picked = NULL;
+		double picked_dist = DBL_MAX;
+		for (auto& candidate : query.plane_map->candidates) {
+			if (!ProjectCorners(candidate.corners, query.R, query.t, query.K, quad) || !InsideQuad(quad, drop))
+				continue;
+			double dist = norm(candidate.center - center);
+			if (dist < picked_dist) {
+				picked = &candidate;
+				picked_dist = dist;
+			}
+		}
+		if (picked) {
+			corners = picked->corners;
+			ProjectCorners(corners, query.R, query.t, query.K, quad);
+			if ((quad[1] - quad[0]).cross(quad[3] - quad[0]) < 0) {
+				swap(corners[0], corners[1]);
+				swap(corners[2], corners[3]);
+			}
+			return true;
+		}
+
+		// Otherwise the object keeps its size, centered where the ray through the drop
+		// point meets the plane, level if the plane is not horizontal.
+		const double MIN_DEPTH_RATE = 0.25, MAX_DEPTH_RATE = 4;
+		auto Hit = [&](const Vec3d& normal, double d, double& s) {
+			double denom = normal.dot(ray);
+			if (abs(denom) < 1e-12)
+				return false;
+			s = -(normal.dot(eye) + d) / denom;
+			return s >= MIN_DEPTH_RATE && s <= MAX_DEPTH_RATE;
+		};
+		auto Place = [&](Vec3d normal, double d, double s) {
+			if (normal.dot(eye) + d < 0) {
+				normal = -normal;
+				d = -d;
+			}
+			Vec3d right = normal.cross(Vec3d(0, 1, 0));
+			if (norm(right) < 0.2) {
+				right = dropped[1] - dropped[0];
+				right -= normal * normal.dot(right);
+			}
+			right /= max(norm(right), 1e-12);
+			Vec3d down = right.cross(normal);
+			Vec3d hit = eye + ray * s;
+			Vec3d half_w = right * (width / 2), half_h = down * (height / 2);
+			corners = { hit - half_w - half_h, hit + half_w - half_h, hit + half_w + half_h, hit - half_w + half_h };
+		};
+
+		const int MIN_LOCAL_LANDMARKS = 12;
+		const double MAX_LOCAL_RMS_RATE = 0.05;
+		double s;
+		if (int(query.landmarks.size()) >= MIN_LOCAL_LANDMARKS) {
+			vector<int> indices(query.landmarks.size());
+			for (int i = 0; i < indices.size(); ++i)
+				indices[i] = i;
+			DetectedPlane plane;
+			if (PlaneDetector::FitPlane(query.landmarks, indices, plane)) {
+				double sqr_sum = 0;
+				for (auto& p : query.landmarks)
+					sqr_sum += pow(plane.normal.dot(p) + plane.d, 2);
+				if (sqrt(sqr_sum / indices.size()) < MAX_LOCAL_RMS_RATE * width && Hit(plane.normal, plane.d, s)) {
+					Place(plane.normal, plane.d, s);
+					return true;
+				}
+			}
+		}
+
+		const DetectedPlane* nearest = NULL;
+		double nearest_s = DBL_MAX;
+		for (auto& plane : query.plane_map->planes)
+			if (Hit(plane.normal, plane.d, s) && s < nearest_s) {
+				nearest = &plane;
+				nearest_s = s;
+			}
+		if (nearest) {
+			Place(nearest->normal, nearest->d, nearest_s);
+			return true;
+		}
+		return false;
+	}
+
+	InterestPoint::PackedObservation::PackedObservation(int frame_id, const KeyPoint& pt) :
+		x(uint16_t(cvRound((pt.pt.x + ORIGIN) * 8))),
+		y(uint16_t(cvRound((pt.pt.y + ORIGIN) * 8))),
+		octave(saturate_cast<uint8_t>(pt.octave)),
+		flags(VISIBLE),
+		frame_tag(uint16_t(frame_id)) {
+		CV_DbgAssert(Representable(pt.pt));
+	}
+
+	bool InterestPoint::PackedObservation::Representable(const Point2f& pt) {
+		const float limit = (USHRT_MAX - 4) / 8.f - ORIGIN;
+		return pt.x >= -ORIGIN && pt.y >= -ORIGIN && pt.x < limit && pt.y < limit;
+	}
+
+	InterestPoint::Observation InterestPoint::PackedObservation::Unpack() const {
+		Observation o;
+		o.visible = (flags & VISIBLE) != 0;
+		o.pt = Point2f(x * 0.125f - ORIGIN, y * 0.125f - ORIGIN);
+		o.octave = octave;
+		return o;
+	}
 
-	InterestPoint::InterestPoint(int initial_frame_id,
+	InterestPoint::InterestPoint(int id,
+								 int initial_frame_id,
+								 int max_observations,
 								 const KeyPoint& initial_loc,
-								 const cv::Mat& initial_desc): vis_cnt_(1), initial_frame_id_(initial_frame_id) {
-		observation(++observation_seq_tail_) = Observation(initial_loc, initial_desc);
-		average_desc_ = initial_desc;
-	}
-
-	void InterestPoint::AddObservation(const Observation& p) {
-		// Remove the information of the discarded observation.
-		if (observation_seq_tail_ + 1 >= MAX_OBSERVATIONS) {
-			auto& old = observation(observation_seq_tail_ + 1);
-			if (old.visible) {
-				if (--vis_cnt_)
-					average_desc_ = (average_desc_ * (vis_cnt_ + 1) - p.desc) / vis_cnt_;
-				else
-					average_desc_ = Mat();
+								 const cv::Mat& initial_desc) :
+		id_(id), last_frame_id_(initial_frame_id), vis_cnt_(1) {
+		int size = 2;
+		while (size < max_observations)
+			size <<= 1;
+		observation_seq_.resize(size);
+		mask_ = size - 1;
+		observation_seq_[initial_frame_id & mask_] = PackedObservation(initial_frame_id, initial_loc);
+		initial_desc.copyTo(average_desc_);
+		bit_votes_.resize(average_desc_.total() * 8);
+		VoteDescriptor(initial_desc);
+	}
+
+	InterestPoint::~InterestPoint() {
+		for (auto& kf_obs : keyframe_observations_)
+			desc_pool_->Release(kf_obs.desc_slot);
+	}
+
+	InterestPoint::Observation InterestPoint::observation(int frame_id) const {
+		auto& record = observation_seq_[frame_id & mask_];
+		if (frame_id <= last_frame_id_ && frame_id > last_frame_id_ - int(observation_seq_.size()) &&
+			record.frame_tag == uint16_t(frame_id))
+			return record.Unpack();
+		auto kf_obs = FindKeyframeObservation(frame_id);
+		return kf_obs ? kf_obs->obs.Unpack() : Observation();
+	}
+
+	void InterestPoint::AddObservation(int frame_id, const KeyPoint& pt, const Mat& desc) {
+		// Remove the records that leave the window. If the point is not observed for a
+		// long time, the whole queue is cleared at once.
+		for (int f = max(min(last_frame_id_ + 1, frame_id), frame_id - mask_); f <= frame_id; ++f) {
+			auto& old = observation_seq_[f & mask_];
+			if (old.flags & PackedObservation::VISIBLE) {
+				old.flags = 0;
+				--vis_cnt_;
 			}
 		}
-		// Add the information of the new observation.
-		if (p.visible) {
-			if (average_desc_.empty())
-				average_desc_ = p.desc;
-			else
-				average_desc_ = (average_desc_ * vis_cnt_ + p.desc) / (vis_cnt_ + 1);
-			++vis_cnt_;
+		// Add the information of the new observation. The descriptor is not kept, only its
+		// votes on the bits of the descriptor of the point.
+		observation_seq_[frame_id & mask_] = PackedObservation(frame_id, pt);
+		last_frame_id_ = frame_id;
+		++vis_cnt_;
+		++found_cnt_;
+		if (!desc.empty())
+			VoteDescriptor(desc);
+	}
+
+	void InterestPoint::VoteDescriptor(const Mat& desc) {
+		CV_Assert(desc.depth() == CV_8U && desc.total() == average_desc_.total());
+		if (desc_votes_ == UCHAR_MAX) {
+			for (auto& votes : bit_votes_)
+				votes >>= 1;
+			desc_votes_ >>= 1;
+		}
+		++desc_votes_;
+		// A tie takes the bit of the new descriptor.
+		uchar* avg = average_desc_.ptr();
+		const uchar* d = desc.ptr();
+		for (int i = 0; i < average_desc_.total(); ++i) {
+			uchar* votes = &bit_votes_[i * 8];
+			int byte = 0;
+			for (int k = 0; k < 8; ++k) {
+				int bit = (d[i] >> k) & 1;
+				votes[k] += uchar(bit);
+				if (2 * votes[k] > desc_votes_ || (2 * votes[k] == desc_votes_ && bit))
+					byte |= 1 << k;
+			}
+			avg[i] = uchar(byte);
+		}
+	}
+
+	void InterestPoint::PinKeyframe(int frame_id, const shared_ptr<DescriptorPool>& pool, const Mat& desc) {
+		auto obs = observation_seq_[frame_id & mask_];
+		if (obs.frame_tag != uint16_t(frame_id) || !(obs.flags & PackedObservation::VISIBLE))
+			return;
+		desc_pool_ = pool;
+		// Keyframes are pinned in order, so appending keeps the observations sorted.
+		if (keyframe_observations_.empty() || keyframe_observations_.back().frame_id < frame_id)
+			keyframe_observations_.push_back({ frame_id, obs, pool->Add(desc) });
+	}
+
+	void InterestPoint::UnpinKeyframe(int frame_id) {
+		auto kf_obs = FindKeyframeObservation(frame_id);
+		if (!kf_obs)
+			return;
+		desc_pool_->Release(kf_obs->desc_slot);
+		keyframe_observations_.erase(keyframe_observations_.begin() + (kf_obs - keyframe_observations_.data()));
+	}
+
+	const InterestPoint::KeyframeObservation* InterestPoint::FindKeyframeObservation(int frame_id) const {
+		auto it = lower_bound(keyframe_observations_.begin(), keyframe_observations_.end(), frame_id,
+							  [](const KeyframeObservation& kf_obs, int id) { return kf_obs.frame_id < id; });
+		return it != keyframe_observations_.end() && it->frame_id == frame_id ? &*it : NULL;
+	}
+
+	size_t InterestPoint::MemoryUsage() const {
+		return sizeof(InterestPoint) +
+			observation_seq_.capacity() * sizeof(PackedObservation) +
+			keyframe_observations_.capacity() * sizeof(KeyframeObservation) +
+			average_desc_.total() * average_desc_.elemSize() +
+			bit_votes_.capacity();
+	}
+
+	void InterestPoint::MergeKeyframeObservations(InterestPoint& duplicate) {
+		if (duplicate.keyframe_observations_.empty())
+			return;
+		vector<KeyframeObservation> merged;
+		merged.reserve(keyframe_observations_.size() + duplicate.keyframe_observations_.size());
+		auto a = keyframe_observations_.begin(), a_end = keyframe_observations_.end();
+		auto b = duplicate.keyframe_observations_.begin(), b_end = duplicate.keyframe_observations_.end();
+		while (a != a_end || b != b_end) {
+			if (b == b_end || (a != a_end && a->frame_id < b->frame_id))
+				merged.push_back(*a++);
+			else if (a == a_end || b->frame_id < a->frame_id)
+				merged.push_back(*b++);
+			else {
+				// Both are observed at the keyframe. Keep the own observation.
+				duplicate.desc_pool_->Release(b->desc_slot);
+				merged.push_back(*a++);
+				++b;
+			}
 		}
-		observation(++observation_seq_tail_) = p;
-		if (observation_seq_tail_ >= (MAX_OBSERVATIONS << 1))
-			observation_seq_tail_ -= MAX_OBSERVATIONS;
+		keyframe_observations_.swap(merged);
+		if (!desc_pool_)
+			desc_pool_ = duplicate.desc_pool_;
+		duplicate.keyframe_observations_.clear();
+	}
+
+	double InterestPoint::FoundRatio() const {
+		// A few searches found half of the time are assumed, so the first frames after
+		// the point appears neither condemn nor promote it.
+		const int PRIOR_SEARCHES = 4;
+		return (found_cnt_ + PRIOR_SEARCHES * 0.5) / (search_cnt_ + PRIOR_SEARCHES);
 	}
 
-	InterestPoint::Observation::Observation(): visible(false) {}
+	double InterestPoint::Quality(double error_scale) const {
+		// Tracks longer than this are not any more useful.
+		const int FULL_TRACK_LENGTH = 8;
+		double track = min(1.0, (found_cnt_ + 1) / double(FULL_TRACK_LENGTH));
+		double error = has_loc3d() ? reproj_error_ / error_scale : 1;
+		return min(1.0, FoundRatio()) * track / (1 + error * error);
+	}
 
-	InterestPoint::Observation::Observation(const cv::KeyPoint& _pt,
-											const cv::Mat& _desc):
-		pt(_pt), desc(_desc), visible(true) {}
+	Mat InterestPoint::keyframe_desc(int frame_id) const {
+		auto kf_obs = FindKeyframeObservation(frame_id);
+		return kf_obs ? desc_pool_->Get(kf_obs->desc_slot) : Mat();
+	}
 }
\ No newline at end of file
@@ -6,13 +6,32 @@
 ///////////////////////////////////////////////////////////
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <queue>
 #include <thread>
 #include <mutex>
 #include <common/ARUtils.h>
+#include <common/CameraModel.h>
 #include <common/CVUtils.h>
+#include <common/FrameArena.h>
+#include <common/FramePyramid.h>
+#include <common/FrameQualityGate.h>
+#include <common/PlaneDetector.h>
+#include <common/DescriptorPool.h>
+#include <common/PoseDisambiguator.h>
+#include <common/PosePredictor.h>
+#include <common/SparseImageAligner.h>
+#include <common/SpatialHash.h>
+#include <common/WorkerPool.h>
+#include <common/YUVFrame.h>
+#include <ar_engine/AREngineConfig.h>
+#include <ar_engine/KeyframeGraph.h>
+#include <ar_engine/VObjectIndex.h>
+#include <ar_engine/TileCompositor.h>
 
 #ifdef _WIN32
 #ifdef ARENGINE_EXPORTS
@@ -33,56 +52,119 @@ namespace ar {
 	//	estimated 3D location of it in the real world.
 	class ARENGINE_API InterestPoint {
 	public:
-		static const int MAX_OBSERVATIONS = 100;
+		//! An observation of the interest point in a frame.
 		struct Observation {
-			bool visible;
-			KeyPoint pt;
-			Mat desc;
-			Observation();
-			Observation(const KeyPoint& _pt,
-						const Mat& _desc);
+			bool visible = false;
+			Point2f pt;
+			int octave = 0;
 			double l2dist_sqr(const Observation& o) const;
 			double l2dist_sqr(const Point2f& p) const;
 		};
-		inline auto& observation(int frame_id) { return observation_seq_[(frame_id - initial_frame_id_) % MAX_OBSERVATIONS]; }
-		inline auto& observation(int frame_id) const { return observation_seq_[(frame_id - initial_frame_id_) % MAX_OBSERVATIONS]; }
-		inline auto& last_observation() { return observation_seq_[observation_seq_tail_ % MAX_OBSERVATIONS]; }
-		inline auto& last_loc() { return last_observation().pt.pt; }
-		InterestPoint(int initial_frame_id);
-		InterestPoint(int initial_frame_id,
+		//! The 8-byte form in which observations are stored. Locations are quantized to
+		//	1/8 pixel from an origin left of and above the image, since undistorted
+		//	locations may be negative. The tag holds the lower bits of the frame ID,
+		//	telling whether a record in the looped queue belongs to the frame asked for.
+		struct PackedObservation {
+			static const uint8_t VISIBLE = 1;
+			//! Distance in pixels of the origin from the top-left corner of the image.
+			static const int ORIGIN = 2048;
+			uint16_t x = 0;
+			uint16_t y = 0;
+			uint8_t octave = 0;
+			uint8_t flags = 0;
+			uint16_t frame_tag = 0;
+			PackedObservation() {}
+			PackedObservation(int frame_id, const KeyPoint& pt);
+			Observation Unpack() const;
+			//! Whether a location is within the range of the packed form. Locations out
+			//	of it are not to be recorded.
+			static bool Representable(const Point2f& pt);
+		};
+
+		InterestPoint(int id,
+					  int initial_frame_id,
+					  int max_observations,
 					  const KeyPoint& initial_loc,
 					  const Mat& initial_desc);
-		void AddObservation(const Observation& p);
-		inline bool ToDiscard() const { return vis_cnt_; }
-		//! The weighted average feature for the interest point.
+		~InterestPoint();
+		//! ID of the point as a landmark of the keyframe graph. Unique within an engine.
+		inline int id() const { return id_; }
+		//! Observation in a frame within the window, or at a pinned keyframe.
+		Observation observation(int frame_id) const;
+		inline Observation last_observation() const { return observation(last_frame_id_); }
+		inline Point2f last_loc() const { return last_observation().pt; }
+		//! Record that the point is visible in a frame. Frames in which the point is not
+		//	observed need no record. The descriptor votes on each bit of that of the point,
+		//	unless it is empty.
+		void AddObservation(int frame_id, const KeyPoint& pt, const Mat& desc);
+		//! Keep the observation at a keyframe with its descriptor, even after the frame
+		//	leaves the window. The descriptor is stored in the shared pool.
+		void PinKeyframe(int frame_id, const shared_ptr<DescriptorPool>& pool, const Mat& desc);
+		//! Release the observation at a keyframe that left the local map. Nothing happens if
+		//	the keyframe is not pinned.
+		void UnpinKeyframe(int frame_id);
+		//! The descriptor observed at a pinned keyframe. Empty if the keyframe is not pinned.
+		Mat keyframe_desc(int frame_id) const;
+		//! Bytes held by this point, not counting the descriptors in the shared pool.
+		size_t MemoryUsage() const;
+		//! Bytes of the descriptors this point keeps in the shared pool.
+		inline size_t KeyframeDescriptorBytes() const {
+			return keyframe_observations_.size() * average_desc_.total() * average_desc_.elemSize();
+		}
+		//! Move the observations at the keyframes the point is not pinned at from a
+		//	duplicate of it. The duplicate is left with none.
+		void MergeKeyframeObservations(InterestPoint& duplicate);
+		//! Whether the point is not visible in any frame of the window ending at a frame.
+		inline bool ToDiscard(int frame_id) const { return frame_id - last_frame_id_ >= int(observation_seq_.size()); }
+		//! Record that the point was looked for in a frame, found or not.
+		inline void CountSearch() { ++search_cnt_; }
+		//! Ratio of the frames the point was found in to those it was looked for in.
+		//	Points not looked for a few times yet are given an even ratio.
+		double FoundRatio() const;
+		inline int found_cnt() const { return found_cnt_; }
+		inline int search_cnt() const { return search_cnt_; }
+		//! Usefulness of the point for tracking, in [0, 1]. It rises with the found ratio
+		//	and the track length, and falls with the reprojection error. Points without
+		//	a 3D location are scored as if their error were the error scale.
+		//	@param error_scale The reprojection error at which the score halves.
+		double Quality(double error_scale) const;
+		inline bool has_loc3d() const { return reproj_error_ >= 0; }
+		//! The descriptor of the point, each bit of which is the majority of the descriptors
+		//	observed, so that it stays a binary descriptor in the Hamming space.
 		Mat average_desc_;
 		//! The estimated 3D location of the point.
 		Point3d loc3d_;
+		//! Reprojection error of loc3d_ in the frame it was estimated in. -1 if loc3d_
+		//	is not estimated.
+		double reproj_error_ = -1;
 	private:
-		int initial_frame_id_;
-		//! Looped queue of observations (2D locations and descriptors) in the frames.
-		Observation observation_seq_[MAX_OBSERVATIONS];
-		int observation_seq_tail_ = -1;
-		//! Count the number of frames in which this point is visible.
+		int id_;
+		//! Number of frames in which the point was looked for, and found.
+		int search_cnt_ = 0;
+		int found_cnt_ = 0;
+		struct KeyframeObservation {
+			int frame_id;
+			PackedObservation obs;
+			int desc_slot;
+		};
+		//! The last frame in which the point is visible.
+		int last_frame_id_;
+		//! Looped queue of observations in the recent frames. The size is a power of two,
+		//	and a frame ID masked by mask_ is its index in the queue.
+		vector<PackedObservation> observation_seq_;
+		int mask_;
+		//! Observations at the pinned keyframes, in ascending order of frame IDs.
+		vector<KeyframeObservation> keyframe_observations_;
+		const KeyframeObservation* FindKeyframeObservation(int frame_id) const;
+		shared_ptr<DescriptorPool> desc_pool_;
+		//! Count the number of frames in the window in which this point is visible.
 		int vis_cnt_;
-	};
-
-	struct Keyframe {
-		int frame_id = 0;
-		Mat intrinsics;
-		vector<shared_ptr<InterestPoint>> interest_points;
-		//! Rotation relative to the world coordinate.
-		Mat R;
-		//! Translation relative to the world coordinate.
-		Mat t;
-		double average_depth = 0;
-		Keyframe(int frame_id, 
-				 Mat intrinsics,
-				 vector<shared_ptr<InterestPoint>> interest_points,
-				 Mat R,
-				 Mat t,
-				 double average_depth);
-		Keyframe() {}
+		//! Number of the descriptors observed with each bit set, and of all the descriptors
+		//	observed. Both are halved when the latter saturates, so that the recent
+		//	descriptors weigh more.
+		vector<uchar> bit_votes_;
+		int desc_votes_ = 0;
+		void VoteDescriptor(const Mat& desc);
 	};
 
 	class VObject;
@@ -91,84 +173,312 @@ namespace ar {
 	//	be fed into the engine, and the engine computes the mixed-reality scene with
 	//	holograms projected into the real world.
 	class ARENGINE_API AREngine {
-		bool to_terminate_ = false;
-		int thread_cnt_ = 0;
+		//! The pool of the engine, if it was not given one.
+		unique_ptr<WorkerPool> own_pool_;
+		//! The pool running all the tasks of the engine.
+		WorkerPool* pool_;
+		//! The mapping tasks, cancelled when the engine is destroyed.
+		TaskGroup mapping_tasks_;
+		//! The anchor searches of dropped objects, cancelled likewise.
+		TaskGroup anchor_tasks_;
+		atomic<bool> mapping_scheduled_;
+		//! Queue a mapping task on the pool, unless one is queued already.
+		void ScheduleMapping();
 
-		static const int MAX_INTEREST_POINTS = 100;
-		static const int MAX_KEYFRAMES = 5;
+		AREngineConfig config_;
+		//! Adjusts config_ according to the measured frame time. Null if disabled.
+		unique_ptr<AdaptiveQualityController> quality_controller_;
+		void ApplyConfig();
 
 		//! For objects in this engine, they should automatically disappear if not viewed
 		//	for this long period (in milliseconds). This period might be dynamically
 		//	adjusted according to the number of objects there are in the engine.
-		int max_idle_period_;
+		int max_idle_period_ = 30000;
 		//!	Virtual objects are labeled with random positive integers in the AR engine.
-		//	The virtual_objects_ is a map from IDs to virtual object pointers.
+		//	The virtual_objects_ is a map from IDs to virtual object pointers. It is only
+		//	changed on the tracking thread, as the index is built from it.
 		unordered_map<int, VObject*> virtual_objects_;
-		vector<MotionData> accumulated_motion_data_;
+		//! Objects taken out of virtual_objects_, deleted once the index no longer refers to them.
+		vector<VObject*> retired_vobjects_;
+		//! Take an object out of the engine, to be deleted after the index is rebuilt.
+		void RetireVObject(unordered_map<int, VObject*>::iterator it);
+		//! Screen-space index of the virtual objects in the last frame. It is rebuilt into
+		//	the spare one and swapped in, so hit tests from other threads see a whole index.
+		shared_ptr<VObjectIndex> vobject_index_;
+		shared_ptr<VObjectIndex> spare_vobject_index_;
+		mutable mutex vobject_index_mutex_;
+		//! Time of the frame the index was built for.
+		chrono::steady_clock::time_point vobject_index_time_;
+		//! Intrinsics of the frame the index was built for, so that the display thread
+		//	does not read the camera model, and whether the camera was calibrated.
+		Matx33d vobject_index_K_;
+		bool vobject_index_calibrated_ = false;
+		void UpdateVObjectIndex();
+		TileCompositor compositor_;
+		//! Held while composing, and while objects are deleted and the index is rebuilt,
+		//	so a display thread never draws a deleted object.
+		mutex draw_mutex_;
 		Mat intrinsics_;
+		CameraModel camera_model_;
 
 		Mat last_raw_frame_;
-		Mat last_gray_frame_;
-		Mat last_canny_map_;
+		//! Owner of the buffers of the last YUV frame, which level 0 of the pyramid refers to.
+		shared_ptr<void> last_yuv_owner_;
+		//! Gray pyramid of the last frame, shared by all the vision stages.
+		FramePyramid frame_pyramid_;
 		//! Rotation of the camera at the last frame with respect to the world coordinate.
-		Mat last_R_;
+		Matx33d last_R_ = Matx33d::eye();
 		//! Translation of the camera at the last frame with respect to the world coordinate.
-		Mat last_t_;
+		Vec3d last_t_ = Vec3d(0, 0, 0);
+		//! Time the last frame was fed, taken as the time it was shot.
+		chrono::steady_clock::time_point last_frame_time_;
+		//! Extrapolates the estimated poses to the time a scene is displayed.
+		PosePredictor pose_predictor_;
+
+		//! Bump allocator for the transient buffers of the tracking path. It is reset at
+		//	the start of each frame, so nothing allocated from it may outlive the frame.
+		FrameArena frame_arena_;
+		//! Keypoints and matches of the current frame, kept as members to reuse their capacity.
+		vector<KeyPoint> frame_keypoints_;
+		vector<pair<int, int>> frame_matches_;
+		//! Descriptors of the current frame, and the pairs of interest point index and
+		//	keypoint index of the interest points observed in it.
+		Mat frame_descriptors_;
+		vector<pair<int, int>> frame_observed_;
+		//! Descriptors of the interest points at the keyframes.
+		shared_ptr<DescriptorPool> descriptor_pool_;
 
 		//! The interest points in recent frames. The observation sequence.
 		vector<shared_ptr<InterestPoint>> interest_points_;
 		InterestPointsTracker interest_points_tracker_;
-		void UpdateInterestPoints(const Mat& scene);
-		//! If we have stored too many interest points, we remove the oldest location record
-		//	of the interest points, and remove the interest points that are determined not visible anymore.
-		void ReduceInterestPoints();
+		//! Detect the keypoints of the frame pyramid and match them to the interest points.
+		//	@param update_map If false, no interest point is added, and the descriptors of
+		//	the matched ones are left as they are.
+		void UpdateInterestPoints(bool update_map);
+		//! Remove the interest points not visible anymore or rarely found when looked for,
+		//	fuse the duplicates of the same 3D location, and discard the least useful points
+		//	until both the number and the memory of the points are within the budget.
+		void MaintainLandmarks();
+		//! Reused by MaintainLandmarks to find the points in the same 3D cell.
+		SpatialHash landmark_hash_;
 		
 		//! Estimate the 3D location of the interest points with the latest keyframe asynchronously.
-		void EstimateMap();
-		void MapEstimationLoop();
-		static void CallMapEstimationLoop(AREngine* engine);
+		//	@return False if there was nothing new to do.
+		bool EstimateMap();
+		//! Finds the planes of the map and the screen placements on them, on the mapping side.
+		PlaneDetector plane_detector_;
+		//! Project a screen candidate into the last frame, in undistorted pixels.
+		//	@return False if any corner is behind the camera.
+		bool ProjectCandidate(const ScreenCandidate& candidate, vector<Point2f>& quad) const;
+
+		//! Pointer input from the GUI thread. Drags are coalesced into the latest position,
+		//	and all are applied on the next frame, so the GUI never waits for tracking.
+		mutex interaction_mutex_;
+		int pending_drag_id_ = -1;
+		Point2f pending_drag_pt_;
+		vector<int> pending_fixes_;
+		struct TelevisionRequest {
+			int id;
+			Point click;
+			FrameStream* content_stream;
+		};
+		vector<TelevisionRequest> pending_televisions_;
+		vector<int> pending_removals_;
+		//! IDs of the objects and of those to be created, so that IDs can be given out
+		//	on the GUI thread.
+		unordered_set<int> vobject_ids_;
+		//! Create a television requested at a location in the last frame.
+		void PlaceTelevision(int id, Point click, FrameStream& content_stream);
+		//! The object being dragged. It slides on a plane cached when the drag started,
+		//	so that following the pointer costs a ray-plane intersection per frame.
+		struct DragState {
+			int id = -1;
+			Vec3d normal;
+			double d = 0;
+			std::array<Vec3d, 4> start_corners;
+			//! Where the pointer first hit the plane.
+			Vec3d grab;
+		};
+		DragState drag_;
+		//! What the anchor search of a dropped object starts from, copied on the tracking thread.
+		struct AnchorQuery {
+			int id = -1;
+			std::array<Vec3d, 4> corners;
+			Matx33d R;
+			Vec3d t;
+			Matx33d K;
+			shared_ptr<const PlaneMap> plane_map;
+			//! The landmarks seen around the object.
+			vector<Vec3d> landmarks;
+		};
+		//! Anchors found for dropped objects, swapped in on the next frame.
+		mutex anchor_mutex_;
+		vector<pair<int, std::array<Vec3d, 4>>> found_anchors_;
+		//! Apply the pointer input and the anchors found since the last frame.
+		void ApplyInteractions();
+		//! Start dragging an object from a pointer location, in undistorted pixels.
+		bool StartDrag(int id, const Point2f& pt);
+		//! Intersect the ray through an undistorted pixel of the last frame with a plane
+		//	n . x + d = 0.
+		//	@return False if the plane is not in front of the camera along the ray.
+		bool IntersectPixelRay(const Point2f& pt, const Vec3d& normal, double d, Vec3d& x) const;
+		//! Find where a dropped object rests: a suggested placement under it, a plane fit
+		//	to the landmarks around it, or a plane of the map, in that order.
+		//	@return False if none is found, and the object stays where it was dropped.
+		static bool FindAnchor(const AnchorQuery& query, std::array<Vec3d, 4>& corners);
 
 		int frame_id_ = -1;
-		Keyframe recent_keyframes_[MAX_KEYFRAMES];
-		int keyframe_seq_tail_ = -1;
-		void AddKeyframe(Keyframe& keyframe);
-		inline auto& keyframe(int ind) { return recent_keyframes_[keyframe_seq_tail_ % MAX_KEYFRAMES]; }
-		thread mapping_thread_;
+		//! Decides how much of the tracking each frame gets.
+		FrameQualityGate frame_gate_;
+		FrameQuality last_frame_quality_;
+		//! Track a frame whose pyramid is built.
+		ERROR_CODE TrackFrame(chrono::steady_clock::time_point start_time);
+		//! Detect and match the keypoints of the frame, estimate its pose from the local
+		//	keyframes, and add it as a keyframe if it moved far enough.
+		//	@return True if the pose of the frame is estimated.
+		bool TrackFeatures(bool update_map, chrono::steady_clock::time_point start_time);
+		//! Whether the camera at a pose moved from the last keyframe by more than a fifth of
+		//	the average depth of the keyframe, both in the units of the map.
+		bool KeyframeDue(const Matx33d& R, const Vec3d& t) const;
+		//! Align the patches of the located landmarks from the last frame to this one.
+		//	@return False if the alignment fails or a keyframe is due, and the features are
+		//	to be tracked instead.
+		bool TrackDirect(chrono::steady_clock::time_point start_time);
+		//! Aligner of the semi-direct tracker, holding the last frame tracked as its reference.
+		SparseImageAligner sparse_aligner_;
+		int aligner_reference_frame_ = -1;
+		//! The landmarks aligned on the current frame, in the camera coordinate of the
+		//	reference, and their patch errors. Kept as members to reuse their capacity.
+		vector<int> direct_landmarks_;
+		vector<Vec3d> direct_points_;
+		vector<float> direct_errors_;
+		//! Update the virtual objects with the frame, and adapt the quality to its time.
+		void FinishFrame(chrono::steady_clock::time_point start_time);
+		//! Picks the pose of the current frame among the candidates from the essential matrix.
+		PoseDisambiguator pose_disambiguator_;
+		//! All the keyframes of the session, connected by the landmarks they share.
+		KeyframeGraph keyframe_graph_;
+		//! Keyframes around the last keyframe, the last keyframe first.
+		vector<int> local_keyframes_;
+		int next_landmark_id_ = 0;
+		//! Add the current frame as a keyframe, with the landmarks observed in it.
+		void AddKeyframe(Keyframe keyframe);
 	public:
 		///////////////////////////////// General methods /////////////////////////////////
-		AREngine();
+		//! @param pool The pool to run the tasks of the engine on, shared with other
+		//	engines. The engine creates a pool of its own if none is given. The pool must
+		//	outlive the engine.
+		AREngine(const AREngineConfig& config = AREngineConfig(), WorkerPool* pool = NULL);
+		//! Cancel the mapping and anchoring tasks not started yet and wait for the running ones.
 		~AREngine();
-		void RemoveVObject(int id) { virtual_objects_.erase(id); }
+		inline WorkerPool* GetWorkerPool() const { return pool_; }
+
+		//! Bytes held by the engine, for accounting the memory of a session.
+		struct MemoryUsage {
+			size_t frame_arena = 0;
+			size_t descriptors = 0;
+			size_t interest_points = 0;
+			size_t keyframes = 0;
+			int num_interest_points = 0;
+			int num_keyframes = 0;
+			inline size_t Total() const { return frame_arena + descriptors + interest_points + keyframes; }
+		};
+		MemoryUsage GetMemoryUsage() const;
+		inline const AREngineConfig& GetConfig() const { return config_; }
+		//! Change the parameters of the engine. The observation window only applies to
+		//	new interest points.
+		void SetConfig(const AREngineConfig& config);
+		//! Lower the processing quality automatically when the time spent on a frame
+		//	goes over the target. Pass 0 to disable.
+		void EnableAdaptiveQuality(double target_frame_ms);
+		//! Remove an object on the next frame. May be called from the GUI thread.
+		void RemoveVObject(int id);
+		//! Remove the virtual objects not viewed for longer than the max idle period.
+		void RemoveExpiredVObjects();
 		inline int GetMaxIdlePeriod() const { return max_idle_period_; }
+		//! Set the camera matrix of the input scenes, taken by a camera without distortion.
+		inline void SetIntrinsics(const Mat& intrinsics) { SetCameraModel(CameraModel(Matx33d(intrinsics), Size())); }
+		inline const Mat& GetIntrinsics() const { return intrinsics_; }
+		//! Set the model of the camera taking the input scenes. With lens distortion, the
+		//	keypoints are undistorted for tracking, and the virtual objects are distorted
+		//	back on being drawn, while the scenes themselves are never remapped.
+		inline void SetCameraModel(const CameraModel& camera) {
+			camera_model_ = camera;
+			intrinsics_ = Mat(camera.K(), true);
+		}
+		inline const CameraModel& GetCameraModel() const { return camera_model_; }
 
 		//! Get the ID of the top virtual object at location (x, y) in the last scene.
 		//	@return ID of the top virtual object. -1 for no object at the location.
 		int GetTopVObj(int x, int y) const;
 
-		//!	Drag a virtual object to a location. The virtual object is stripped from the
-		//	real world by then, and its shape and size in the scene remain the same during
-		//	the dragging. Call FixVObj to fix the virtual object onto the real world again.
+		//!	Drag a virtual object to a location. The object slides with the pointer on the
+		//	plane it was on when the drag started, keeping its size in the world. Call FixVObj
+		//	to fix the virtual object onto the real world again.
+		//	Only the latest location is kept until the next frame, so this can be called on
+		//	every mouse move from the GUI thread without waiting for tracking.
 		ERROR_CODE DragVObj(int id, int x, int y);
 
 		//! Fix a virtual object that is floating to the real world. The orientation
-		//	and size might be adjusted to fit the new location.
+		//	and size might be adjusted to fit the new location. The new anchor is searched
+		//	for on the worker pool, and the object stays where it was dropped until it
+		//	is found.
 		ERROR_CODE FixVObj(int id);
 
 		//! Feed a scene but do not get mixed scene. Should at least call this once before calling
 		//	the GetMixedScene.
 		ERROR_CODE FeedScene(const Mat& raw_scene);
+		//! Feed a YUV scene. Tracking runs on the Y plane, so the scene is not converted.
+		//	The buffers are referred to until the next scene is fed, so they must stay valid
+		//	until then, unless the frame has an owner.
+		ERROR_CODE FeedScene(const YUVFrame& raw_scene);
 		//! Return a mixed scene with both fixed and floating virtual objects overlaid to
 		//	the raw scene.
 		ERROR_CODE GetMixedScene(const Mat& raw_scene, Mat& mixed_scene);
+		//! Feed a YUV scene and overlay the virtual objects onto it in place. Only the
+		//	pixels covered by the objects are written, in all the planes.
+		ERROR_CODE GetMixedScene(YUVFrame& scene);
+		//! Overlay the virtual objects onto the newest scene without tracking it, as they
+		//	are predicted to be seen at the display time. The outlines from the last tracked
+		//	frame are moved by the camera rotation predicted since then, from the recent
+		//	poses and the motion data. This lets the overlay be drawn at the display rate
+		//	while FeedScene or GetMixedScene runs at a lower rate on another thread: the
+		//	index is taken with the intrinsics of its frame, and drawing holds the draw lock.
+		ERROR_CODE GetPredictedMixedScene(const Mat& newest_scene,
+										  chrono::steady_clock::time_point display_time,
+										  Mat& mixed_scene);
+		//! Predict the pose of the camera at a time from the recent poses and the motion data.
+		//	@return False if no pose has been estimated.
+		inline bool PredictPose(chrono::steady_clock::time_point time, Matx33d& R, Vec3d& t) const {
+			return pose_predictor_.Predict(time, R, t);
+		}
+		//! The metrics of the last frame fed and how much of the tracking it got.
+		inline const FrameQuality& GetLastFrameQuality() const { return last_frame_quality_; }
+		//! The pose of the camera at the last frame tracked.
+		inline void GetLastPose(Matx33d& R, Vec3d& t) const {
+			R = last_R_;
+			t = last_t_;
+		}
 
 		//! Feed the motion data collected by the motion sensors at the moment.
-		//	The data will be accumulated and used on computing the next mixed scene,
-		//	so whenever the motion data of a moment is ready, immediately input it into
-		//	the AR engine with this function.
-		inline void FeedMotionData(const MotionData& data) { accumulated_motion_data_.push_back(data); }
+		//	The pose predictor uses them to predict the poses of the coming frames and
+		//	displays, so whenever the motion data of a moment is ready, immediately input
+		//	it into the AR engine with this function. May be called from a sensor thread.
+		inline void FeedMotionData(const MotionData& data) {
+			pose_predictor_.AddMotionData(data);
+		}
 
 		///////////////////////// Special object creating methods /////////////////////////
 		//!	Create a screen displaying the content at the location in the last input scene.
-		ERROR_CODE CreateTelevision(Point location, FrameStream& content_stream);
+		//	It is created on the next frame, so that the GUI thread never waits for tracking.
+		//	@param id If not NULL, set to the ID of the television to be created.
+		ERROR_CODE CreateTelevision(Point location, FrameStream& content_stream, int* id = NULL);
+		//! The planes found in the map and the screen placements suggested on them. They
+		//	are updated in the background as the map grows.
+		inline shared_ptr<const PlaneMap> GetPlaneMap() const { return plane_detector_.GetPlaneMap(); }
+		//! Get the suggested screen placements visible in the last frame, as quads in the
+		//	frame in the order of left-upper, right-upper, right-lower and left-lower, so that
+		//	they can be highlighted. A click inside one creates the television there.
+		void GetPlacementSuggestions(vector<vector<Point2f>>& quads) const;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,192 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/flann.hpp>
+
+#include <ar_engine/AREngineConfig.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	AREngineConfig AREngineConfig::LowLatency() {
+		AREngineConfig config;
+		config.max_features = 300;
+		config.pyramid_levels = 4;
+		config.max_interest_points = 60;
+		config.max_landmark_bytes = 2 << 20;
+		config.max_keyframes = 3;
+		config.max_observations = 16;
+		config.matcher_type = FLANN_LSH;
+		config.nn_match_ratio = 0.75;
+		config.compositor_quality = COMPOSITOR_FAST;
+		return config;
+	}
+
+	AREngineConfig AREngineConfig::Balanced() {
+		return AREngineConfig();
+	}
+
+	AREngineConfig AREngineConfig::Accuracy() {
+		AREngineConfig config;
+		config.max_features = 1000;
+		config.max_interest_points = 300;
+		config.max_landmark_bytes = 32 << 20;
+		config.max_keyframes = 8;
+		config.max_observations = 64;
+		config.ransac_thresh = 1.5;
+		config.compositor_quality = COMPOSITOR_HIGH;
+		return config;
+	}
+
+	ERROR_CODE AREngineConfig::FromPreset(const string& name, AREngineConfig& config) {
+		if (name == "low-latency")
+			config = LowLatency();
+		else if (name == "balanced")
+			config = Balanced();
+		else if (name == "accuracy")
+			config = Accuracy();
+		else
+			return AR_INVALID_INPUT;
+		return AR_SUCCESS;
+	}
+
+	void AREngineConfig::Write(FileStorage& fs) const {
+		fs << "max_features" << max_features;
+		fs << "pyramid_levels" << pyramid_levels;
+		fs << "detector_type" << int(detector_type);
+		fs << "tracker_type" << int(tracker_type);
+		fs << "max_interest_points" << max_interest_points;
+		fs << "max_landmark_bytes" << double(max_landmark_bytes);
+		fs << "min_found_ratio" << min_found_ratio;
+		fs << "fusion_cell_rate" << fusion_cell_rate;
+		fs << "fusion_max_hamming" << fusion_max_hamming;
+		fs << "max_keyframes" << max_keyframes;
+		fs << "max_observations" << max_observations;
+		fs << "matcher_type" << int(matcher_type);
+		fs << "nn_match_ratio" << nn_match_ratio;
+		fs << "ransac_thresh" << ransac_thresh;
+		fs << "mean_tv_size_rate" << mean_tv_size_rate;
+		fs << "compositor_quality" << int(compositor_quality);
+		fs << "occlusion" << int(occlusion);
+		fs << "frame_gate" << int(frame_gate);
+	}
+
+	void AREngineConfig::Read(const FileNode& node) {
+		auto ReadInt = [&node](const char* name, int& value) {
+			if (!node[name].empty())
+				value = int(node[name]);
+		};
+		auto ReadDouble = [&node](const char* name, double& value) {
+			if (!node[name].empty())
+				value = double(node[name]);
+		};
+		ReadInt("max_features", max_features);
+		ReadInt("pyramid_levels", pyramid_levels);
+		int detector = detector_type;
+		ReadInt("detector_type", detector);
+		detector_type = DetectorType(detector);
+		int tracker = tracker_type;
+		ReadInt("tracker_type", tracker);
+		tracker_type = TrackerType(tracker);
+		ReadInt("max_interest_points", max_interest_points);
+		double landmark_bytes = double(max_landmark_bytes);
+		ReadDouble("max_landmark_bytes", landmark_bytes);
+		max_landmark_bytes = size_t(landmark_bytes);
+		ReadDouble("min_found_ratio", min_found_ratio);
+		ReadDouble("fusion_cell_rate", fusion_cell_rate);
+		ReadInt("fusion_max_hamming", fusion_max_hamming);
+		ReadInt("max_keyframes", max_keyframes);
+		ReadInt("max_observations", max_observations);
+		int matcher = matcher_type;
+		ReadInt("matcher_type", matcher);
+		matcher_type = MatcherType(matcher);
+		ReadDouble("nn_match_ratio", nn_match_ratio);
+		ReadDouble("ransac_thresh", ransac_thresh);
+		ReadDouble("mean_tv_size_rate", mean_tv_size_rate);
+		int quality = compositor_quality;
+		ReadInt("compositor_quality", quality);
+		compositor_quality = CompositorQuality(quality);
+		int occluding = occlusion;
+		ReadInt("occlusion", occluding);
+		occlusion = occluding != 0;
+		int gating = frame_gate;
+		ReadInt("frame_gate", gating);
+		frame_gate = gating != 0;
+	}
+
+	Ptr<Feature2D> AREngineConfig::CreateDetector() const {
+		return ORB::create(max_features, 1.2f, pyramid_levels);
+	}
+
+	OrbOptions AREngineConfig::GetOrbOptions() const {
+		OrbOptions options;
+		options.max_features = max_features;
+		options.num_levels = pyramid_levels;
+		options.scale_factor = 1.2f;
+		return options;
+	}
+
+	Ptr<DescriptorMatcher> AREngineConfig::CreateMatcher() const {
+		switch (matcher_type) {
+		case FLANN_LSH:
+			return makePtr<FlannBasedMatcher>(makePtr<flann::LshIndexParams>(12, 20, 2));
+		case BRUTE_FORCE_HAMMING:
+		default:
+			return DescriptorMatcher::create("BruteForce-Hamming");
+		}
+	}
+
+	int AREngineConfig::CompositorInterpolation() const {
+		switch (compositor_quality) {
+		case COMPOSITOR_FAST:
+			return INTER_NEAREST;
+		case COMPOSITOR_HIGH:
+			return INTER_CUBIC;
+		case COMPOSITOR_BALANCED:
+		default:
+			return INTER_LINEAR;
+		}
+	}
+
+	AdaptiveQualityController::AdaptiveQualityController(const AREngineConfig& base, double target_frame_ms) :
+		base_(base), target_frame_ms_(target_frame_ms) {}
+
+	AREngineConfig AdaptiveQualityController::Degrade(const AREngineConfig& base, int level) {
+		AREngineConfig config = base;
+		for (int i = 0; i < level; ++i) {
+			config.max_features = max(100, config.max_features * 3 / 4);
+			config.pyramid_levels = max(2, config.pyramid_levels - 1);
+			config.compositor_quality = CompositorQuality(max(int(COMPOSITOR_FAST), config.compositor_quality - 1));
+		}
+		return config;
+	}
+
+	bool AdaptiveQualityController::Update(double frame_ms, AREngineConfig& config) {
+		// Exponential moving average over roughly the last ten frames.
+		if (smoothed_frame_ms_ <= 0)
+			smoothed_frame_ms_ = frame_ms;
+		else
+			smoothed_frame_ms_ += (frame_ms - smoothed_frame_ms_) * 0.1;
+		if (++frames_since_change_ < SETTLE_FRAMES)
+			return false;
+
+		int old_level = level_;
+		if (smoothed_frame_ms_ > target_frame_ms_ && level_ < MAX_LEVEL)
+			++level_;
+		// Leave a margin before raising the quality again, or it would oscillate.
+		else if (smoothed_frame_ms_ < target_frame_ms_ * 0.7 && level_ > 0)
+			--level_;
+		if (level_ == old_level)
+			return false;
+
+		config = Degrade(base_, level_);
+		frames_since_change_ = 0;
+		return true;
+	}
+}
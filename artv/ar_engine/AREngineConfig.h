@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#include <string>
+#include <opencv2/features2d.hpp>
+
+#include <common/ErrorCodes.h>
+#include <common/OrbExtractor.h>
+
+#ifdef _WIN32
+#ifdef ARENGINE_EXPORTS
+#define ARENGINE_API __declspec(dllexport)
+#else
+#define ARENGINE_API __declspec(dllimport)
+#endif
+#else
+#define ARENGINE_API
+#endif
+
+namespace ar {
+	enum MatcherType {
+		//! Exact matching. Cheapest when only a few hundred points are stored.
+		BRUTE_FORCE_HAMMING,
+		//! Approximate matching with locality sensitive hashing. Scales better to large maps.
+		FLANN_LSH
+	};
+
+	enum DetectorType {
+		//! cv::ORB on the gray frame, one level after another.
+		DETECTOR_OPENCV_ORB,
+		//! OrbExtractor on the frame pyramid, with the levels in parallel.
+		DETECTOR_PARALLEL_ORB
+	};
+
+	enum TrackerType {
+		//! Keypoints detected and matched on every frame.
+		TRACKER_FEATURES,
+		//! Patches of the landmarks aligned on the pyramid between keyframes, with the
+		//	keypoints detected and matched only on keyframes and where the alignment fails.
+		TRACKER_SEMI_DIRECT
+	};
+
+	enum CompositorQuality {
+		COMPOSITOR_FAST,
+		COMPOSITOR_BALANCED,
+		COMPOSITOR_HIGH
+	};
+
+	//! The struct AREngineConfig collects the tunable parameters of the AR engine.
+	//	The default values are those of the "balanced" preset.
+	struct ARENGINE_API AREngineConfig {
+		//! Maximum number of keypoints detected in each frame.
+		int max_features = 500;
+		//! Number of pyramid levels for keypoint detection.
+		int pyramid_levels = 8;
+		DetectorType detector_type = DETECTOR_PARALLEL_ORB;
+		TrackerType tracker_type = TRACKER_FEATURES;
+		//! Number of interest points stored before the least useful ones are discarded.
+		int max_interest_points = 100;
+		//! Memory budget of the interest points in bytes, including their descriptors at
+		//	keyframes. The least useful ones are discarded beyond it.
+		size_t max_landmark_bytes = 8 << 20;
+		//! Interest points looked for in at least 8 frames, and found in less than this
+		//	ratio of them, are discarded.
+		double min_found_ratio = 0.25;
+		//! Interest points in the same cube of this size relative to the average depth of
+		//	the scene, with descriptors within the Hamming distance, are fused. Pass 0 to
+		//	disable fusion.
+		double fusion_cell_rate = 0.01;
+		int fusion_max_hamming = 40;
+		//! Number of keyframes in the local map around the current keyframe. All the
+		//	keyframes are kept, but only the local map is visited on a frame.
+		int max_keyframes = 5;
+		//! Number of recent frames in which the observations of an interest point are kept,
+		//	rounded up to a power of two. Observations at keyframes are kept regardless.
+		//	Only takes effect on interest points created afterwards.
+		int max_observations = 32;
+		MatcherType matcher_type = BRUTE_FORCE_HAMMING;
+		//! Nearest-neighbour matching ratio.
+		double nn_match_ratio = 0.8;
+		//! RANSAC inlier threshold in pixels.
+		double ransac_thresh = 2.5;
+		//! The minimum distance of a television corner from the clicked location,
+		//	relative to the shorter side of the frame.
+		double mean_tv_size_rate = 0.1;
+		CompositorQuality compositor_quality = COMPOSITOR_BALANCED;
+		//! Whether real objects in front of a television, such as a hand, are kept in front
+		//	of it. The cost per television is bounded by the grid of its occlusion model.
+		bool occlusion = true;
+		//! Whether duplicate frames keep the last pose and blurry frames are kept out of
+		//	the map, as decided by a FrameQualityGate.
+		bool frame_gate = true;
+
+		static AREngineConfig LowLatency();
+		static AREngineConfig Balanced();
+		static AREngineConfig Accuracy();
+		//! Get a named preset: "low-latency", "balanced" or "accuracy".
+		static ERROR_CODE FromPreset(const std::string& name, AREngineConfig& config);
+
+		//! Write the parameters to a file storage, and read them back. Parameters missing
+		//	from the node keep their values.
+		void Write(cv::FileStorage& fs) const;
+		void Read(const cv::FileNode& node);
+
+		cv::Ptr<cv::Feature2D> CreateDetector() const;
+		OrbOptions GetOrbOptions() const;
+		cv::Ptr<cv::DescriptorMatcher> CreateMatcher() const;
+		//! The OpenCV interpolation flag used for drawing virtual objects.
+		int CompositorInterpolation() const;
+	};
+
+	//! The class AdaptiveQualityController lowers the quality of the per-frame processing
+	//	step by step when the measured frame time goes over the target budget, and restores
+	//	it when there is enough headroom again. Only the parameters that can be changed
+	//	between frames are touched; the keyframe and observation windows stay as they are.
+	class ARENGINE_API AdaptiveQualityController {
+		static const int MAX_LEVEL = 6;
+		//! Number of frames to wait after a change before judging the frame time again.
+		static const int SETTLE_FRAMES = 15;
+		AREngineConfig base_;
+		double target_frame_ms_;
+		double smoothed_frame_ms_ = 0;
+		int frames_since_change_ = 0;
+		int level_ = 0;
+	public:
+		AdaptiveQualityController(const AREngineConfig& base, double target_frame_ms);
+		//! Feed the time spent on the last frame.
+		//	@return True if the config is changed.
+		bool Update(double frame_ms, AREngineConfig& config);
+		inline int GetLevel() const { return level_; }
+		inline const AREngineConfig& GetBase() const { return base_; }
+		inline double GetTargetFrameTime() const { return target_frame_ms_; }
+		inline double GetSmoothedFrameTime() const { return smoothed_frame_ms_; }
+		//! The base config degraded by the given number of steps.
+		static AREngineConfig Degrade(const AREngineConfig& base, int level);
+	};
+}
@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <vector>
+
+#include <ar_engine/EngineHost.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	EngineHost::EngineHost(const EngineHostOptions& options) :
+		options_(options),
+		pool_(options.num_threads) {
+		if (options_.single_threaded_opencv) {
+			former_opencv_threads_ = getNumThreads();
+			setNumThreads(0);
+		}
+	}
+
+	EngineHost::~EngineHost() {
+		vector<int> ids;
+		{
+			lock_guard<mutex> lock(sessions_mutex_);
+			for (auto& session : sessions_)
+				ids.push_back(session.first);
+		}
+		for (int id : ids)
+			CloseSession(id);
+		if (former_opencv_threads_ >= 0)
+			setNumThreads(former_opencv_threads_);
+	}
+
+	int EngineHost::CreateSession(const AREngineConfig& config) {
+		auto session = make_shared<Session>();
+		session->engine.reset(new AREngine(config, &pool_));
+		lock_guard<mutex> lock(sessions_mutex_);
+		int id = next_session_id_++;
+		sessions_[id] = session;
+		return id;
+	}
+
+	ERROR_CODE EngineHost::CloseSession(int id) {
+		shared_ptr<Session> session;
+		{
+			lock_guard<mutex> lock(sessions_mutex_);
+			auto it = sessions_.find(id);
+			if (it == sessions_.end())
+				return AR_INVALID_INPUT;
+			session = it->second;
+			sessions_.erase(it);
+		}
+		unique_lock<mutex> lock(session->mutex);
+		session->closed = true;
+		session->idle_cond.wait(lock, [&] { return !session->scheduled; });
+		lock.unlock();
+		// The engine waits for its mapping tasks on the pool.
+		session->engine.reset();
+		return AR_SUCCESS;
+	}
+
+	shared_ptr<EngineHost::Session> EngineHost::FindSession(int id) const {
+		lock_guard<mutex> lock(sessions_mutex_);
+		auto it = sessions_.find(id);
+		return it == sessions_.end() ? nullptr : it->second;
+	}
+
+	ERROR_CODE EngineHost::SubmitFrame(int id, const Mat& raw_scene, FrameCallback callback) {
+		Job job;
+		job.is_frame = true;
+		job.raw_scene = raw_scene;
+		job.callback = move(callback);
+		job.submit_time = chrono::steady_clock::now();
+		return Enqueue(id, move(job));
+	}
+
+	ERROR_CODE EngineHost::RunInSession(int id, Operation operation) {
+		Job job;
+		job.operation = move(operation);
+		job.submit_time = chrono::steady_clock::now();
+		return Enqueue(id, move(job));
+	}
+
+	ERROR_CODE EngineHost::Enqueue(int id, Job&& job) {
+		auto session = FindSession(id);
+		if (!session)
+			return AR_INVALID_INPUT;
+		Job dropped;
+		bool to_schedule = false;
+		{
+			lock_guard<mutex> lock(session->mutex);
+			if (session->closed)
+				return AR_INVALID_INPUT;
+			// Drop the oldest waiting frame, so that the latency stays bounded under load.
+			if (job.is_frame && session->pending_frames >= max(1, options_.max_pending_frames))
+				for (auto it = session->jobs.begin(); it != session->jobs.end(); ++it)
+					if (it->is_frame) {
+						dropped = move(*it);
+						session->jobs.erase(it);
+						--session->pending_frames;
+						++session->stats.frames_dropped;
+						break;
+					}
+			if (job.is_frame)
+				++session->pending_frames;
+			session->jobs.push_back(move(job));
+			if (!session->scheduled)
+				to_schedule = session->scheduled = true;
+		}
+		if (dropped.callback)
+			dropped.callback(AR_FRAME_DROPPED, Mat());
+		if (to_schedule)
+			pool_.Post([this, session] { RunSession(session); });
+		return AR_SUCCESS;
+	}
+
+	void EngineHost::RunSession(const shared_ptr<Session>& session) {
+		Job job;
+		{
+			lock_guard<mutex> lock(session->mutex);
+			job = move(session->jobs.front());
+			session->jobs.pop_front();
+			if (job.is_frame)
+				--session->pending_frames;
+		}
+
+		if (job.is_frame) {
+			auto start_time = chrono::steady_clock::now();
+			Mat mixed_scene;
+			ERROR_CODE ret;
+			// An exception of one session should not bring down the others.
+			try {
+				ret = session->engine->GetMixedScene(job.raw_scene, mixed_scene);
+			}
+			catch (...) {
+				ret = AR_INVALID_INPUT;
+			}
+			auto end_time = chrono::steady_clock::now();
+			auto memory = session->engine->GetMemoryUsage();
+			{
+				lock_guard<mutex> lock(session->mutex);
+				auto& stats = session->stats;
+				double latency_ms = chrono::duration<double, milli>(end_time - job.submit_time).count();
+				double processing_ms = chrono::duration<double, milli>(end_time - start_time).count();
+				++stats.frames_processed;
+				stats.last_latency_ms = latency_ms;
+				stats.mean_latency_ms += (latency_ms - stats.mean_latency_ms) / stats.frames_processed;
+				stats.max_latency_ms = max(stats.max_latency_ms, latency_ms);
+				stats.mean_processing_ms += (processing_ms - stats.mean_processing_ms) / stats.frames_processed;
+				stats.memory = memory;
+			}
+			if (job.callback) {
+				try {
+					job.callback(ret, mixed_scene);
+				}
+				catch (...) {}
+			}
+		}
+		else {
+			bool failed = false;
+			try {
+				job.operation(*session->engine);
+			}
+			catch (...) {
+				failed = true;
+			}
+			if (failed) {
+				lock_guard<mutex> lock(session->mutex);
+				++session->stats.operations_failed;
+			}
+		}
+
+		bool more;
+		{
+			lock_guard<mutex> lock(session->mutex);
+			more = !session->jobs.empty();
+			session->scheduled = more;
+			if (!more)
+				session->idle_cond.notify_all();
+		}
+		// Go to the end of the shared queue, so that the other sessions take their turns.
+		if (more)
+			pool_.Post([this, session] { RunSession(session); });
+	}
+
+	ERROR_CODE EngineHost::GetSessionStats(int id, SessionStats& stats) const {
+		auto session = FindSession(id);
+		if (!session)
+			return AR_INVALID_INPUT;
+		lock_guard<mutex> lock(session->mutex);
+		stats = session->stats;
+		return AR_SUCCESS;
+	}
+
+	int EngineHost::NumSessions() const {
+		lock_guard<mutex> lock(sessions_mutex_);
+		return int(sessions_.size());
+	}
+
+	FrameStream* EngineHost::GetSharedContent(const string& video_path) {
+		lock_guard<mutex> lock(content_mutex_);
+		auto it = contents_.find(video_path);
+		if (it != contents_.end())
+			return it->second.get();
+		auto stream = make_shared<RealtimeLocalVideoStream>();
+		if (stream->Open(video_path.c_str()) != AR_SUCCESS)
+			return NULL;
+		auto content = new SharedFrameStream(stream, options_.content_fps);
+		contents_[video_path].reset(content);
+		return content;
+	}
+
+	void EngineHost::WaitIdle() {
+		pool_.WaitIdle();
+	}
+}
@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef ENGINEHOST_H
+#define ENGINEHOST_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <common/CVUtils.h>
+#include <common/WorkerPool.h>
+#include <ar_engine/AREngine.h>
+
+namespace ar {
+	struct EngineHostOptions {
+		//! Number of worker threads shared by all the sessions. Zero for one per hardware thread.
+		int num_threads = 0;
+		//! Frames a session may have waiting. The oldest waiting frame is dropped beyond it.
+		int max_pending_frames = 2;
+		//! Make OpenCV run its functions single-threaded while the host exists, as the
+		//	sessions already keep the workers busy. Note that this applies to the whole
+		//	process. The former number of threads is restored when the host is destroyed.
+		bool single_threaded_opencv = false;
+		//! Rate at which shared content streams are decoded.
+		double content_fps = 30;
+	};
+
+	//! Latency and memory of a session.
+	struct SessionStats {
+		int frames_processed = 0;
+		int frames_dropped = 0;
+		//! Operations that threw an exception. The session goes on with its next job.
+		int operations_failed = 0;
+		//! Time from the submission of a frame to the end of its processing, in milliseconds.
+		double last_latency_ms = 0;
+		double mean_latency_ms = 0;
+		double max_latency_ms = 0;
+		//! Time spent processing the frames on a worker, in milliseconds.
+		double mean_processing_ms = 0;
+		//! Memory of the engine after its last frame.
+		AREngine::MemoryUsage memory;
+	};
+
+	//!	The class EngineHost runs many independent AR sessions on one shared worker pool.
+	//	A session is an AREngine with a queue of frames and operations. At most one task
+	//	of a session is queued or running at a time, and it goes back to the end of the
+	//	shared queue after each frame, so the sessions take turns on the workers however
+	//	many frames each of them has waiting.
+	class ARENGINE_API EngineHost {
+	public:
+		typedef std::function<void(ERROR_CODE, const cv::Mat&)> FrameCallback;
+		typedef std::function<void(AREngine&)> Operation;
+
+		EngineHost(const EngineHostOptions& options = EngineHostOptions());
+		//! Close all the sessions.
+		~EngineHost();
+		EngineHost(const EngineHost&) = delete;
+		EngineHost& operator=(const EngineHost&) = delete;
+
+		//! @return ID of the new session.
+		int CreateSession(const AREngineConfig& config = AREngineConfig());
+		//! Wait for the queued work of the session, then destroy its engine.
+		//	Must not be called on a worker of the host.
+		ERROR_CODE CloseSession(int id);
+
+		//! Queue a frame of a session. The mixed scene is given to the callback on a
+		//	worker, or AR_FRAME_DROPPED if the frame is dropped. The frame is not copied,
+		//	so its buffer must not be written until the callback.
+		ERROR_CODE SubmitFrame(int id, const cv::Mat& raw_scene, FrameCallback callback = FrameCallback());
+		//! Queue an operation on the engine of a session, such as creating or dragging a
+		//	virtual object. It runs in order with the frames, and is never dropped.
+		ERROR_CODE RunInSession(int id, Operation operation);
+
+		ERROR_CODE GetSessionStats(int id, SessionStats& stats) const;
+		int NumSessions() const;
+
+		//! A stream of a video file whose decoding is shared by all the sessions.
+		//	@return Null if the file cannot be opened.
+		FrameStream* GetSharedContent(const std::string& video_path);
+
+		//! Wait until all the sessions have nothing queued.
+		void WaitIdle();
+		inline WorkerPool& GetPool() { return pool_; }
+
+	private:
+		struct Job {
+			bool is_frame = false;
+			cv::Mat raw_scene;
+			FrameCallback callback;
+			std::chrono::steady_clock::time_point submit_time;
+			Operation operation;
+		};
+		struct Session {
+			std::unique_ptr<AREngine> engine;
+			std::mutex mutex;
+			std::condition_variable idle_cond;
+			std::deque<Job> jobs;
+			int pending_frames = 0;
+			//! Whether a task of the session is queued or running on the pool.
+			bool scheduled = false;
+			bool closed = false;
+			SessionStats stats;
+		};
+
+		EngineHostOptions options_;
+		//! Number of OpenCV threads before the host made it single-threaded, or -1.
+		int former_opencv_threads_ = -1;
+		WorkerPool pool_;
+		mutable std::mutex sessions_mutex_;
+		std::unordered_map<int, std::shared_ptr<Session>> sessions_;
+		int next_session_id_ = 0;
+		std::mutex content_mutex_;
+		std::unordered_map<std::string, std::unique_ptr<SharedFrameStream>> contents_;
+
+		std::shared_ptr<Session> FindSession(int id) const;
+		ERROR_CODE Enqueue(int id, Job&& job);
+		void RunSession(const std::shared_ptr<Session>& session);
+	};
+}
+
+#endif // !ENGINEHOST_H
@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+
+#include <ar_engine/KeyframeGraph.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	Keyframe::Keyframe(int _frame_id,
+					   const Matx33d& _intrinsics,
+					   const Matx33d& _R,
+					   const Vec3d& _t,
+					   double _average_depth) :
+		frame_id(_frame_id),
+		intrinsics(_intrinsics),
+		R(_R), t(_t),
+		average_depth(_average_depth) {}
+
+	void KeyframeGraph::Connect(int a, int b, int weight) {
+		auto& neighbors = keyframes_[a].neighbors;
+		auto edge = make_pair(b, weight);
+		neighbors.insert(upper_bound(neighbors.begin(), neighbors.end(), edge,
+									 [](const pair<int, int>& x, const pair<int, int>& y) { return x.second > y.second; }),
+						 edge);
+	}
+
+	int KeyframeGraph::Add(Keyframe keyframe) {
+		int ind = int(keyframes_.size());
+		sort(keyframe.landmarks.begin(), keyframe.landmarks.end());
+		keyframe.landmarks.erase(unique(keyframe.landmarks.begin(), keyframe.landmarks.end()), keyframe.landmarks.end());
+		keyframe.neighbors.clear();
+		keyframes_.push_back(move(keyframe));
+		shared_count_.resize(keyframes_.size(), 0);
+		visit_stamp_.resize(keyframes_.size(), 0);
+
+		// Count the landmarks shared with each keyframe through the observers of the landmarks.
+		touched_.clear();
+		for (int landmark : keyframes_[ind].landmarks) {
+			auto& observers = observers_[landmark];
+			for (int kf : observers)
+				if (!shared_count_[kf]++)
+					touched_.push_back(kf);
+			observers.push_back(ind);
+		}
+		int best = -1;
+		for (int kf : touched_) {
+			if (best < 0 || shared_count_[kf] > shared_count_[best])
+				best = kf;
+			if (shared_count_[kf] >= MIN_SHARED_LANDMARKS) {
+				Connect(ind, kf, shared_count_[kf]);
+				Connect(kf, ind, shared_count_[kf]);
+			}
+		}
+		// Keep the graph connected even through a poorly shared keyframe.
+		if (best >= 0 && shared_count_[best] < MIN_SHARED_LANDMARKS) {
+			Connect(ind, best, shared_count_[best]);
+			Connect(best, ind, shared_count_[best]);
+		}
+		for (int kf : touched_)
+			shared_count_[kf] = 0;
+		return ind;
+	}
+
+	void KeyframeGraph::RemoveLandmark(int landmark_id) {
+		auto it = observers_.find(landmark_id);
+		if (it == observers_.end())
+			return;
+		for (int kf : it->second) {
+			auto& landmarks = keyframes_[kf].landmarks;
+			auto pos = lower_bound(landmarks.begin(), landmarks.end(), landmark_id);
+			if (pos != landmarks.end() && *pos == landmark_id)
+				landmarks.erase(pos);
+		}
+		observers_.erase(it);
+	}
+
+	void KeyframeGraph::ReplaceLandmark(int from_id, int to_id) {
+		auto it = observers_.find(from_id);
+		if (it == observers_.end())
+			return;
+		vector<int> from_observers = move(it->second);
+		observers_.erase(it);
+		auto& to_observers = observers_[to_id];
+		for (int kf : from_observers) {
+			auto& landmarks = keyframes_[kf].landmarks;
+			auto pos = lower_bound(landmarks.begin(), landmarks.end(), from_id);
+			if (pos != landmarks.end() && *pos == from_id)
+				landmarks.erase(pos);
+			pos = lower_bound(landmarks.begin(), landmarks.end(), to_id);
+			if (pos == landmarks.end() || *pos != to_id) {
+				landmarks.insert(pos, to_id);
+				to_observers.insert(lower_bound(to_observers.begin(), to_observers.end(), kf), kf);
+			}
+		}
+	}
+
+	void KeyframeGraph::LocalKeyframes(int keyframe, int max_keyframes, vector<int>& local) const {
+		local.clear();
+		if (keyframe < 0 || keyframe >= keyframes_.size() || max_keyframes <= 0)
+			return;
+		++stamp_;
+		local.push_back(keyframe);
+		visit_stamp_[keyframe] = stamp_;
+		// Breadth first, so the neighbors of the keyframe come before the farther ones.
+		for (int i = 0; i < local.size() && local.size() < max_keyframes; ++i)
+			for (auto& edge : keyframes_[local[i]].neighbors) {
+				if (local.size() >= max_keyframes)
+					break;
+				if (visit_stamp_[edge.first] != stamp_) {
+					visit_stamp_[edge.first] = stamp_;
+					local.push_back(edge.first);
+				}
+			}
+	}
+
+	void KeyframeGraph::LocalLandmarks(const vector<int>& keyframes, vector<int>& landmarks) const {
+		landmarks.clear();
+		for (int kf : keyframes)
+			landmarks.insert(landmarks.end(), keyframes_[kf].landmarks.begin(), keyframes_[kf].landmarks.end());
+		sort(landmarks.begin(), landmarks.end());
+		landmarks.erase(unique(landmarks.begin(), landmarks.end()), landmarks.end());
+	}
+
+	size_t KeyframeGraph::Bytes() const {
+		size_t bytes = keyframes_.capacity() * sizeof(Keyframe);
+		for (auto& kf : keyframes_)
+			bytes += kf.landmarks.capacity() * sizeof(int) + kf.neighbors.capacity() * sizeof(pair<int, int>);
+		for (auto& observers : observers_)
+			bytes += sizeof(observers) + observers.second.capacity() * sizeof(int);
+		return bytes;
+	}
+}
@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef KEYFRAMEGRAPH_H
+#define KEYFRAMEGRAPH_H
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace ar {
+	struct Keyframe {
+		int frame_id = 0;
+		cv::Matx33d intrinsics;
+		//! Rotation relative to the world coordinate.
+		cv::Matx33d R;
+		//! Translation relative to the world coordinate.
+		cv::Vec3d t;
+		double average_depth = 0;
+		//! IDs of the landmarks observed in the keyframe, in ascending order.
+		std::vector<int> landmarks;
+		//! Covisible keyframes and the numbers of landmarks shared with them, from the
+		//	most shared down.
+		std::vector<std::pair<int, int>> neighbors;
+		Keyframe(int frame_id,
+				 const cv::Matx33d& intrinsics,
+				 const cv::Matx33d& R,
+				 const cv::Vec3d& t,
+				 double average_depth);
+		Keyframe() {}
+	};
+
+	//! The class KeyframeGraph keeps all the keyframes of a session, connected by the
+	//	landmarks they share. Keyframes are referred to by their indices in the order
+	//	added. Work around the current keyframe only visits its local map, the keyframes
+	//	sharing the most landmarks with it, so it does not grow with the map.
+	class KeyframeGraph {
+	public:
+		//! Keyframes sharing at least this many landmarks are connected.
+		static const int MIN_SHARED_LANDMARKS = 8;
+
+		//! Add a keyframe and connect it to the keyframes it shares landmarks with.
+		//	If none shares enough, it is connected to the one sharing the most.
+		//	@return Index of the keyframe.
+		int Add(Keyframe keyframe);
+		//! Forget a landmark that is no longer tracked. Edge weights are not lowered.
+		void RemoveLandmark(int landmark_id);
+		//! Refer to a landmark by the ID of another one it is fused into. Edge weights are
+		//	not changed.
+		void ReplaceLandmark(int from_id, int to_id);
+		//! Select the local map of a keyframe: the keyframe, its neighbors, and the
+		//	neighbors of those if there is still room, each from the most shared down.
+		void LocalKeyframes(int keyframe, int max_keyframes, std::vector<int>& local) const;
+		//! Collect the landmarks observed in some keyframes, without duplicates.
+		void LocalLandmarks(const std::vector<int>& keyframes, std::vector<int>& landmarks) const;
+
+		inline bool Empty() const { return keyframes_.empty(); }
+		inline int Size() const { return int(keyframes_.size()); }
+		inline int Last() const { return int(keyframes_.size()) - 1; }
+		inline const Keyframe& Get(int keyframe) const { return keyframes_[keyframe]; }
+		inline Keyframe& Get(int keyframe) { return keyframes_[keyframe]; }
+		size_t Bytes() const;
+
+	private:
+		std::vector<Keyframe> keyframes_;
+		//! Keyframes in which each landmark is observed, in ascending order.
+		std::unordered_map<int, std::vector<int>> observers_;
+		//! Scratch buffers, stamped with the query number instead of being cleared.
+		mutable std::vector<int> shared_count_;
+		mutable std::vector<int> visit_stamp_;
+		mutable int stamp_ = 0;
+		mutable std::vector<int> touched_;
+
+		void Connect(int a, int b, int weight);
+	};
+}
+
+#endif // !KEYFRAMEGRAPH_H
@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+
+#include <ar_engine/OcclusionModel.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	OcclusionModel::OcclusionModel(const OcclusionOptions& options) : options_(options) {
+		Reset();
+	}
+
+	void OcclusionModel::Reset() {
+		frames_ = 0;
+		active_ = false;
+		mean_ = Mat::zeros(options_.grid_height, options_.grid_width, CV_32F);
+		var_ = Mat::zeros(options_.grid_height, options_.grid_width, CV_32F);
+		mask_ = Mat::zeros(options_.grid_height, options_.grid_width, CV_32F);
+	}
+
+	void OcclusionModel::Update(const FramePyramid& pyramid, const CameraModel& camera, const vector<Point2f>& quad) {
+		int gw = options_.grid_width, gh = options_.grid_height;
+		if (quad.size() != 4 || pyramid.NumLevels() == 0)
+			return;
+		vector<Point2f> grid = { Point2f(0, 0), Point2f(float(gw), 0), Point2f(float(gw), float(gh)), Point2f(0, float(gh)) };
+		Matx33d G = getPerspectiveTransform(grid, quad);
+
+		// Sample the coarsest level where a cell still spans a pixel. The pyramid has
+		// already low-passed it, so the samples do not alias.
+		double span = max(max(norm(quad[1] - quad[0]), norm(quad[2] - quad[3])) / gw,
+						  max(norm(quad[3] - quad[0]), norm(quad[2] - quad[1])) / gh);
+		int level = 0;
+		while (level + 1 < pyramid.NumLevels() && span >= FramePyramid::Scale(level + 1))
+			++level;
+		const Mat& image = pyramid.Level(level);
+		float scale = float(1 / FramePyramid::Scale(level));
+
+		// Cells outside the frame are marked negative and left out.
+		sample_.create(gh, gw, CV_32F);
+		for (int y = 0; y < gh; ++y) {
+			float* row = sample_.ptr<float>(y);
+			for (int x = 0; x < gw; ++x) {
+				Vec3d p = G * Vec3d(x + 0.5, y + 0.5, 1);
+				row[x] = -1;
+				if (p[2] <= 0)
+					continue;
+				Point2f q = camera.DistortPixel(Point2f(float(p[0] / p[2]), float(p[1] / p[2])));
+				// Pixel i of a level covers pixels i * s to (i + 1) * s - 1 of level 0.
+				float qx = (q.x + 0.5f) * scale - 0.5f, qy = (q.y + 0.5f) * scale - 0.5f;
+				if (qx < 0 || qy < 0 || qx > image.cols - 1 || qy > image.rows - 1)
+					continue;
+				int x0 = min(int(qx), image.cols - 2), y0 = min(int(qy), image.rows - 2);
+				if (x0 < 0 || y0 < 0)
+					continue;
+				float fx = qx - x0, fy = qy - y0;
+				const uchar* r0 = image.ptr<uchar>(y0) + x0;
+				const uchar* r1 = image.ptr<uchar>(y0 + 1) + x0;
+				row[x] = (r0[0] * (1 - fx) + r0[1] * fx) * (1 - fy) + (r1[0] * (1 - fx) + r1[1] * fx) * fy;
+			}
+		}
+
+		if (frames_ < options_.warmup_frames) {
+			// Average the first frames into the background.
+			float n = float(frames_ + 1);
+			for (int y = 0; y < gh; ++y) {
+				const float* s = sample_.ptr<float>(y);
+				float* m = mean_.ptr<float>(y);
+				float* v = var_.ptr<float>(y);
+				for (int x = 0; x < gw; ++x) {
+					if (s[x] < 0)
+						continue;
+					float d = s[x] - m[x];
+					m[x] += d / n;
+					v[x] += (d * (s[x] - m[x]) - v[x]) / n;
+				}
+			}
+			++frames_;
+			return;
+		}
+
+		// Changes of the exposure shift all the cells alike, which the median deviation takes out.
+		deviations_.clear();
+		for (int y = 0; y < gh; ++y) {
+			const float* s = sample_.ptr<float>(y);
+			const float* m = mean_.ptr<float>(y);
+			for (int x = 0; x < gw; ++x)
+				if (s[x] >= 0)
+					deviations_.push_back(s[x] - m[x]);
+		}
+		if (deviations_.empty())
+			return;
+		nth_element(deviations_.begin(), deviations_.begin() + deviations_.size() / 2, deviations_.end());
+		float offset = deviations_[deviations_.size() / 2];
+
+		raw_mask_.create(gh, gw, CV_32F);
+		float thresh = float(options_.deviation_thresh);
+		float min_var = float(options_.min_sigma * options_.min_sigma);
+		float rate = float(options_.learning_rate);
+		for (int y = 0; y < gh; ++y) {
+			const float* s = sample_.ptr<float>(y);
+			const float* mk = mask_.ptr<float>(y);
+			float* m = mean_.ptr<float>(y);
+			float* v = var_.ptr<float>(y);
+			float* r = raw_mask_.ptr<float>(y);
+			for (int x = 0; x < gw; ++x) {
+				if (s[x] < 0) {
+					r[x] = mk[x];
+					continue;
+				}
+				float d = s[x] - m[x] - offset;
+				float z = abs(d) / sqrt(max(v[x], min_var));
+				float occluded = min(max((z - thresh + 1) / 2, 0.f), 1.f);
+				r[x] = occluded;
+				// Occluded cells still follow slowly, so that a lasting change of the real
+				// scene is taken into the background.
+				float cell_rate = rate * (1 - 0.95f * occluded);
+				m[x] += cell_rate * d;
+				v[x] += cell_rate * (d * d - v[x]);
+			}
+		}
+		blur(raw_mask_, raw_mask_, Size(3, 3));
+		addWeighted(mask_, options_.mask_inertia, raw_mask_, 1 - options_.mask_inertia, 0, mask_);
+		double max_occlusion;
+		minMaxLoc(mask_, NULL, &max_occlusion);
+		active_ = max_occlusion > options_.min_occlusion;
+		++frames_;
+	}
+}
@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef OCCLUSIONMODEL_H
+#define OCCLUSIONMODEL_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <common/CameraModel.h>
+#include <common/FramePyramid.h>
+
+namespace ar {
+	struct OcclusionOptions {
+		//! Resolution of the model over the screen. It bounds the cost of an update,
+		//	however large the screen appears.
+		int grid_width = 64;
+		int grid_height = 36;
+		//! Frames averaged into the background before anything is taken as occluding.
+		int warmup_frames = 5;
+		//! Rate at which the background follows the cells seen as background.
+		double learning_rate = 0.05;
+		//! Cells deviating from the background by about this many standard deviations
+		//	are occluded. The mask ramps up within one deviation around it.
+		double deviation_thresh = 3;
+		//! Least standard deviation of a cell in gray levels, for the noise of the camera.
+		double min_sigma = 6;
+		//! Weight of the last mask in the new one, so that the mask does not flicker.
+		double mask_inertia = 0.6;
+		//! The mask is taken as empty if no cell is occluded by more than this.
+		double min_occlusion = 0.05;
+	};
+
+	//! The class OcclusionModel tells where real objects, such as a hand, are in front
+	//	of a screen. It keeps a running Gaussian background of the real scene behind the
+	//	screen on a low-resolution grid over the screen quad, so the grid moves with the
+	//	screen. The cells deviating from the background form a soft mask, which is
+	//	smoothed over time and upsampled when the screen is drawn.
+	class OcclusionModel {
+	public:
+		OcclusionModel(const OcclusionOptions& options = OcclusionOptions());
+
+		//! Sample the real scene inside the quad of the screen, and update the background
+		//	and the mask with it.
+		//	@param pyramid Gray pyramid of the raw frame. The level matching the grid is sampled.
+		//	@param quad Corners of the screen in undistorted pixels, in the order of
+		//	left-upper, right-upper, right-lower and left-lower.
+		void Update(const FramePyramid& pyramid, const CameraModel& camera, const std::vector<cv::Point2f>& quad);
+		//! Forget the background, such as when the screen is moved.
+		void Reset();
+		//! Whether any part of the screen is occluded.
+		inline bool Active() const { return active_; }
+		//! Occlusion of the grid cells from 0 to 1, as a CV_32F matrix of the grid size.
+		inline const cv::Mat& GetMask() const { return mask_; }
+		inline cv::Size GetGridSize() const { return cv::Size(options_.grid_width, options_.grid_height); }
+
+	private:
+		OcclusionOptions options_;
+		int frames_ = 0;
+		bool active_ = false;
+		cv::Mat mean_;
+		cv::Mat var_;
+		cv::Mat mask_;
+		//! Reused for each update.
+		cv::Mat sample_;
+		cv::Mat raw_mask_;
+		std::vector<float> deviations_;
+	};
+}
+
+#endif // !OCCLUSIONMODEL_H
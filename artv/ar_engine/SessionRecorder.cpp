@@ -0,0 +1,293 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <cstring>
+#include <opencv2/imgcodecs.hpp>
+
+#include <ar_engine/SessionRecorder.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	const char SessionRecorder::MAGIC[8] = { 'A', 'R', 'T', 'V', 'S', 'E', 'S', 'S' };
+
+	namespace {
+		template<class T>
+		void Put(vector<uchar>& buf, const T& value) {
+			size_t pos = buf.size();
+			buf.resize(pos + sizeof(T));
+			memcpy(&buf[pos], &value, sizeof(T));
+		}
+
+		//! Reads values from a payload, failing instead of reading past its end.
+		class PayloadReader {
+			const uchar* p_;
+			const uchar* end_;
+		public:
+			PayloadReader(const vector<uchar>& buf) : p_(buf.data()), end_(buf.data() + buf.size()) {}
+			template<class T>
+			bool Get(T& value) {
+				if (size_t(end_ - p_) < sizeof(T))
+					return false;
+				memcpy(&value, p_, sizeof(T));
+				p_ += sizeof(T);
+				return true;
+			}
+			inline const uchar* Rest() const { return p_; }
+			inline size_t RestSize() const { return size_t(end_ - p_); }
+		};
+
+		void EncodeFrame(const Mat& frame, FrameEncoding encoding, vector<uchar>& payload) {
+			// Only 8-bit images of 1 or 3 channels can be compressed.
+			if (frame.depth() != CV_8U || (frame.channels() != 1 && frame.channels() != 3))
+				encoding = FRAME_RAW;
+			Put(payload, uint8_t(encoding));
+			Put(payload, int32_t(frame.rows));
+			Put(payload, int32_t(frame.cols));
+			Put(payload, int32_t(frame.type()));
+			if (encoding == FRAME_RAW) {
+				size_t row_bytes = frame.cols * frame.elemSize();
+				size_t pos = payload.size();
+				payload.resize(pos + row_bytes * frame.rows);
+				for (int y = 0; y < frame.rows; ++y)
+					memcpy(&payload[pos + row_bytes * y], frame.ptr(y), row_bytes);
+				return;
+			}
+			vector<uchar> encoded;
+			imencode(encoding == FRAME_PNG ? ".png" : ".jpg", frame, encoded);
+			payload.insert(payload.end(), encoded.begin(), encoded.end());
+		}
+
+		bool DecodeFrame(const vector<uchar>& payload, Mat& frame) {
+			PayloadReader reader(payload);
+			uint8_t encoding;
+			int32_t rows, cols, type;
+			if (!reader.Get(encoding) || !reader.Get(rows) || !reader.Get(cols) || !reader.Get(type))
+				return false;
+			if (encoding == FRAME_RAW) {
+				frame.create(rows, cols, type);
+				if (reader.RestSize() != frame.total() * frame.elemSize())
+					return false;
+				memcpy(frame.data, reader.Rest(), reader.RestSize());
+				return true;
+			}
+			frame = imdecode(Mat(1, int(reader.RestSize()), CV_8U, const_cast<uchar*>(reader.Rest())),
+							 CV_MAT_CN(type) == 1 ? IMREAD_GRAYSCALE : IMREAD_COLOR);
+			return frame.rows == rows && frame.cols == cols;
+		}
+
+		string ReadText(const vector<uchar>& payload) {
+			return string(payload.begin(), payload.end());
+		}
+	}
+
+	SessionRecorder::~SessionRecorder() {
+		Close();
+	}
+
+	ERROR_CODE SessionRecorder::Open(const string& path, FrameEncoding encoding, size_t max_buffered_bytes) {
+		Close();
+		out_.open(path, ios::binary | ios::trunc);
+		if (!out_.is_open())
+			return AR_FILE_NOT_FOUND;
+		out_.write(MAGIC, sizeof(MAGIC));
+		uint32_t version = VERSION;
+		out_.write((const char*)&version, sizeof(version));
+		encoding_ = encoding;
+		max_buffered_bytes_ = max_buffered_bytes;
+		start_time_ = chrono::steady_clock::now();
+		closing_ = false;
+		bytes_written_ = sizeof(MAGIC) + sizeof(version);
+		writer_ = thread(&SessionRecorder::WriterLoop, this);
+		return AR_SUCCESS;
+	}
+
+	void SessionRecorder::Close() {
+		if (!IsOpen())
+			return;
+		{
+			lock_guard<mutex> lock(mutex_);
+			closing_ = true;
+		}
+		not_empty_.notify_all();
+		writer_.join();
+		out_.close();
+	}
+
+	int64_t SessionRecorder::Now() const {
+		return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start_time_).count();
+	}
+
+	void SessionRecorder::Push(Pending&& record) {
+		if (!IsOpen())
+			return;
+		unique_lock<mutex> lock(mutex_);
+		// A record larger than the whole budget still goes through once the queue is empty.
+		not_full_.wait(lock, [this] { return buffered_bytes_ < max_buffered_bytes_ || queue_.empty(); });
+		buffered_bytes_ += record.Bytes();
+		queue_.push_back(move(record));
+		lock.unlock();
+		not_empty_.notify_one();
+	}
+
+	void SessionRecorder::WriterLoop() {
+		unique_lock<mutex> lock(mutex_);
+		while (true) {
+			not_empty_.wait(lock, [this] { return closing_ || !queue_.empty(); });
+			if (queue_.empty())
+				break;
+			Pending record = move(queue_.front());
+			queue_.pop_front();
+			size_t bytes = record.Bytes();
+			lock.unlock();
+
+			if (!record.frame.empty())
+				EncodeFrame(record.frame, encoding_, record.payload);
+			uint8_t type = uint8_t(record.type);
+			uint32_t size = uint32_t(record.payload.size());
+			out_.write((const char*)&type, sizeof(type));
+			out_.write((const char*)&size, sizeof(size));
+			out_.write((const char*)&record.time_us, sizeof(record.time_us));
+			out_.write((const char*)record.payload.data(), size);
+			bytes_written_ += sizeof(type) + sizeof(size) + sizeof(record.time_us) + size;
+
+			lock.lock();
+			buffered_bytes_ -= bytes;
+			not_full_.notify_all();
+		}
+		out_.flush();
+	}
+
+	void SessionRecorder::RecordConfig(const AREngineConfig& config) {
+		FileStorage fs(".yml", FileStorage::WRITE | FileStorage::MEMORY);
+		config.Write(fs);
+		string text = fs.releaseAndGetString();
+		Push({ RECORD_CONFIG, Now(), vector<uchar>(text.begin(), text.end()), Mat() });
+	}
+
+	void SessionRecorder::RecordCamera(const CameraModel& camera) {
+		FileStorage fs(".yml", FileStorage::WRITE | FileStorage::MEMORY);
+		camera.Write(fs);
+		string text = fs.releaseAndGetString();
+		Push({ RECORD_CAMERA, Now(), vector<uchar>(text.begin(), text.end()), Mat() });
+	}
+
+	void SessionRecorder::RecordFrame(const Mat& frame) {
+		if (frame.empty())
+			return;
+		Push({ RECORD_FRAME, Now(), vector<uchar>(), frame.clone() });
+	}
+
+	void SessionRecorder::RecordMotion(const MotionData& data) {
+		Pending record{ RECORD_MOTION, Now(), vector<uchar>(), Mat() };
+		Put(record.payload, int64_t(chrono::duration_cast<chrono::microseconds>(data.shot_time - start_time_).count()));
+		for (int i = 0; i < 3; ++i)
+			Put(record.payload, data.angular_velocity[i]);
+		for (int i = 0; i < 3; ++i)
+			Put(record.payload, data.acceleration[i]);
+		Push(move(record));
+	}
+
+	void SessionRecorder::RecordCreateTelevision(Point location, int id) {
+		Pending record{ RECORD_CREATE_TV, Now(), vector<uchar>(), Mat() };
+		Put(record.payload, int32_t(id));
+		Put(record.payload, int32_t(location.x));
+		Put(record.payload, int32_t(location.y));
+		Push(move(record));
+	}
+
+	void SessionRecorder::RecordDrag(int id, int x, int y) {
+		Pending record{ RECORD_DRAG, Now(), vector<uchar>(), Mat() };
+		Put(record.payload, int32_t(id));
+		Put(record.payload, int32_t(x));
+		Put(record.payload, int32_t(y));
+		Push(move(record));
+	}
+
+	void SessionRecorder::RecordFix(int id) {
+		Pending record{ RECORD_FIX, Now(), vector<uchar>(), Mat() };
+		Put(record.payload, int32_t(id));
+		Push(move(record));
+	}
+
+	void SessionRecorder::RecordRemove(int id) {
+		Pending record{ RECORD_REMOVE, Now(), vector<uchar>(), Mat() };
+		Put(record.payload, int32_t(id));
+		Push(move(record));
+	}
+
+	ERROR_CODE SessionReader::Open(const string& path) {
+		in_.close();
+		in_.open(path, ios::binary);
+		if (!in_.is_open())
+			return AR_FILE_NOT_FOUND;
+		char magic[sizeof(SessionRecorder::MAGIC)];
+		uint32_t version = 0;
+		in_.read(magic, sizeof(magic));
+		in_.read((char*)&version, sizeof(version));
+		if (!in_ || memcmp(magic, SessionRecorder::MAGIC, sizeof(magic)) || version > SessionRecorder::VERSION)
+			return AR_INVALID_INPUT;
+		return AR_SUCCESS;
+	}
+
+	ERROR_CODE SessionReader::Next(SessionRecord& record) {
+		uint8_t type;
+		uint32_t size;
+		if (!in_.read((char*)&type, sizeof(type)))
+			return AR_NO_MORE_FRAMES;
+		in_.read((char*)&size, sizeof(size));
+		in_.read((char*)&record.time_us, sizeof(record.time_us));
+		payload_.resize(size);
+		in_.read((char*)payload_.data(), size);
+		if (!in_)
+			return AR_INVALID_INPUT;
+
+		record.type = SessionRecordType(type);
+		PayloadReader reader(payload_);
+		int32_t values[3];
+		switch (record.type) {
+		case RECORD_CONFIG: {
+			FileStorage fs(ReadText(payload_), FileStorage::READ | FileStorage::MEMORY);
+			record.config = AREngineConfig();
+			record.config.Read(fs.root());
+			return AR_SUCCESS;
+		}
+		case RECORD_CAMERA: {
+			FileStorage fs(ReadText(payload_), FileStorage::READ | FileStorage::MEMORY);
+			return CameraModel::Read(fs.root(), record.camera);
+		}
+		case RECORD_FRAME:
+			return DecodeFrame(payload_, record.frame) ? AR_SUCCESS : AR_INVALID_INPUT;
+		case RECORD_MOTION: {
+			int64_t shot_us;
+			bool ok = reader.Get(shot_us);
+			for (int i = 0; i < 3; ++i)
+				ok = ok && reader.Get(record.motion.angular_velocity[i]);
+			for (int i = 0; i < 3; ++i)
+				ok = ok && reader.Get(record.motion.acceleration[i]);
+			record.motion.shot_time = chrono::steady_clock::time_point(chrono::microseconds(shot_us));
+			return ok ? AR_SUCCESS : AR_INVALID_INPUT;
+		}
+		case RECORD_CREATE_TV:
+		case RECORD_DRAG:
+			if (!reader.Get(values[0]) || !reader.Get(values[1]) || !reader.Get(values[2]))
+				return AR_INVALID_INPUT;
+			record.id = values[0];
+			record.location = Point(values[1], values[2]);
+			return AR_SUCCESS;
+		case RECORD_FIX:
+		case RECORD_REMOVE:
+			if (!reader.Get(values[0]))
+				return AR_INVALID_INPUT;
+			record.id = values[0];
+			return AR_SUCCESS;
+		default:
+			// Records of later versions are skipped.
+			return Next(record);
+		}
+	}
+}
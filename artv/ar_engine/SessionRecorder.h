@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <common/ARUtils.h>
+#include <common/CameraModel.h>
+#include <common/ErrorCodes.h>
+#include <ar_engine/AREngineConfig.h>
+
+#ifdef _WIN32
+#ifdef ARENGINE_EXPORTS
+#define ARENGINE_API __declspec(dllexport)
+#else
+#define ARENGINE_API __declspec(dllimport)
+#endif
+#else
+#define ARENGINE_API
+#endif
+
+namespace ar {
+	//! A session file starts with the magic bytes and the version, followed by records of
+	//	a 1-byte type, a 4-byte payload size, an 8-byte time in microseconds since the
+	//	start of the recording and the payload. Numbers are little-endian.
+	enum SessionRecordType {
+		RECORD_CONFIG = 1,
+		RECORD_CAMERA,
+		RECORD_FRAME,
+		RECORD_MOTION,
+		RECORD_CREATE_TV,
+		RECORD_DRAG,
+		RECORD_FIX,
+		RECORD_REMOVE
+	};
+
+	enum FrameEncoding {
+		FRAME_RAW,
+		//! Lossless, so a replay sees the very pixels recorded.
+		FRAME_PNG,
+		//! Lossy but much smaller. Replays are deterministic, though not identical to the
+		//	live session.
+		FRAME_JPEG
+	};
+
+	//! A record of a session. Only the fields of the type are meaningful.
+	struct SessionRecord {
+		SessionRecordType type;
+		int64_t time_us = 0;
+		AREngineConfig config;
+		CameraModel camera;
+		cv::Mat frame;
+		//! The shot time is relative to the start of the recording.
+		MotionData motion;
+		//! ID of the object acted on, as given in the live session.
+		int id = -1;
+		cv::Point location;
+	};
+
+	//! The class SessionRecorder logs the inputs of an AR engine to a file: frames, motion
+	//	data, user actions and the config, so that a session can be replayed later. Records
+	//	are queued and written by a background thread. Frames are encoded by that thread
+	//	too. The queue is bounded in bytes, and recording blocks while it is full, so that
+	//	no input is lost.
+	class ARENGINE_API SessionRecorder {
+	public:
+		static const char MAGIC[8];
+		static const uint32_t VERSION = 1;
+
+		SessionRecorder() {}
+		~SessionRecorder();
+		SessionRecorder(const SessionRecorder&) = delete;
+		SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+		ERROR_CODE Open(const std::string& path,
+						FrameEncoding encoding = FRAME_PNG,
+						size_t max_buffered_bytes = 64 << 20);
+		//! Write the queued records and close the file.
+		void Close();
+		inline bool IsOpen() const { return writer_.joinable(); }
+
+		void RecordConfig(const AREngineConfig& config);
+		void RecordCamera(const CameraModel& camera);
+		//! The frame is copied, so the buffer can be reused right away.
+		void RecordFrame(const cv::Mat& frame);
+		void RecordMotion(const MotionData& data);
+		//! @param id ID of the television created.
+		void RecordCreateTelevision(cv::Point location, int id);
+		void RecordDrag(int id, int x, int y);
+		void RecordFix(int id);
+		void RecordRemove(int id);
+
+		//! Bytes written to the file so far.
+		inline uint64_t BytesWritten() const { return bytes_written_; }
+
+	private:
+		struct Pending {
+			SessionRecordType type;
+			int64_t time_us;
+			std::vector<uchar> payload;
+			//! Frames are encoded into the payload by the writer thread.
+			cv::Mat frame;
+			inline size_t Bytes() const { return payload.size() + frame.total() * frame.elemSize(); }
+		};
+
+		std::ofstream out_;
+		FrameEncoding encoding_ = FRAME_PNG;
+		size_t max_buffered_bytes_ = 0;
+		std::chrono::steady_clock::time_point start_time_;
+
+		std::mutex mutex_;
+		std::condition_variable not_empty_;
+		std::condition_variable not_full_;
+		std::deque<Pending> queue_;
+		size_t buffered_bytes_ = 0;
+		bool closing_ = false;
+		std::thread writer_;
+		std::atomic<uint64_t> bytes_written_{ 0 };
+
+		int64_t Now() const;
+		void Push(Pending&& record);
+		void WriterLoop();
+	};
+
+	//! The class SessionReader reads the records of a session file in order.
+	class ARENGINE_API SessionReader {
+	public:
+		ERROR_CODE Open(const std::string& path);
+		//! @return AR_NO_MORE_FRAMES at the end of the file. AR_INVALID_INPUT if the file is
+		//	corrupted.
+		ERROR_CODE Next(SessionRecord& record);
+
+	private:
+		std::ifstream in_;
+		std::vector<uchar> payload_;
+	};
+}
+
+#endif // !SESSIONRECORDER_H
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <thread>
+
+#include <ar_engine/SessionReplayer.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	ERROR_CODE SessionReplayer::Open(const string& path) {
+		id_map_.clear();
+		return reader_.Open(path);
+	}
+
+	int SessionReplayer::MapID(int recorded_id) const {
+		auto it = id_map_.find(recorded_id);
+		return it == id_map_.end() ? -1 : it->second;
+	}
+
+	ERROR_CODE SessionReplayer::Replay(AREngine& engine,
+									   FrameStream& content_stream,
+									   ReplayMode mode,
+									   FrameCallback callback,
+									   ReplayStats* stats) {
+		ReplayStats local_stats;
+		if (!stats)
+			stats = &local_stats;
+		*stats = ReplayStats();
+
+		// Sessions recorded without a config run on the config of the engine, filtered the same.
+		if (config_filter_) {
+			AREngineConfig config = engine.GetConfig();
+			config_filter_(config);
+			engine.SetConfig(config);
+		}
+
+		auto start_time = chrono::steady_clock::now();
+		SessionRecord record;
+		Mat mixed_scene;
+		ERROR_CODE ret;
+		while ((ret = reader_.Next(record)) == AR_SUCCESS) {
+			if (mode == REPLAY_REAL_TIME)
+				this_thread::sleep_until(start_time + chrono::microseconds(record.time_us));
+
+			switch (record.type) {
+			case RECORD_CONFIG:
+				if (config_filter_)
+					config_filter_(record.config);
+				engine.SetConfig(record.config);
+				break;
+			case RECORD_CAMERA:
+				engine.SetCameraModel(record.camera);
+				break;
+			case RECORD_FRAME: {
+				auto frame_start = chrono::steady_clock::now();
+				ret = engine.GetMixedScene(record.frame, mixed_scene);
+				double frame_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - frame_start).count();
+				if (ret < 0)
+					return ret;
+				stats->total_frame_ms += frame_ms;
+				stats->max_frame_ms = max(stats->max_frame_ms, frame_ms);
+				if (callback)
+					callback(stats->frames, mixed_scene);
+				++stats->frames;
+				break;
+			}
+			case RECORD_MOTION:
+				record.motion.shot_time = start_time + record.motion.shot_time.time_since_epoch();
+				engine.FeedMotionData(record.motion);
+				break;
+			case RECORD_CREATE_TV: {
+				int id = -1;
+				engine.CreateTelevision(record.location, content_stream, &id);
+				id_map_[record.id] = id;
+				++stats->actions;
+				break;
+			}
+			case RECORD_DRAG:
+				engine.DragVObj(MapID(record.id), record.location.x, record.location.y);
+				++stats->actions;
+				break;
+			case RECORD_FIX:
+				engine.FixVObj(MapID(record.id));
+				++stats->actions;
+				break;
+			case RECORD_REMOVE:
+				engine.RemoveVObject(MapID(record.id));
+				id_map_.erase(record.id);
+				++stats->actions;
+				break;
+			default:
+				break;
+			}
+		}
+		stats->wall_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+		return ret == AR_NO_MORE_FRAMES ? AR_SUCCESS : ret;
+	}
+}
@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef SESSIONREPLAYER_H
+#define SESSIONREPLAYER_H
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include <ar_engine/AREngine.h>
+#include <ar_engine/SessionRecorder.h>
+
+namespace ar {
+	enum ReplayMode {
+		//! Feed the records at the pace they were recorded.
+		REPLAY_REAL_TIME,
+		//! Feed the records as fast as the engine takes them.
+		REPLAY_FAST
+	};
+
+	struct ReplayStats {
+		int frames = 0;
+		int actions = 0;
+		//! Time spent in the engine on the frames, in milliseconds.
+		double total_frame_ms = 0;
+		double max_frame_ms = 0;
+		//! Time the whole replay took, in milliseconds.
+		double wall_ms = 0;
+	};
+
+	//! The class SessionReplayer feeds a recorded session into an AR engine. The records are
+	//	applied in the order they were recorded, on the calling thread, so a replay does the
+	//	same work each time and can be used to reproduce bugs and to compare performance.
+	//	The motion data are fed with their shot times moved to the start of the replay.
+	class ARENGINE_API SessionReplayer {
+	public:
+		typedef std::function<void(int frame_index, const cv::Mat& mixed_scene)> FrameCallback;
+		typedef std::function<void(AREngineConfig& config)> ConfigFilter;
+
+		ERROR_CODE Open(const std::string& path);
+		//! Change the recorded configs before they are applied, such as to replay a session
+		//	with another tracker and compare the two.
+		inline void SetConfigFilter(ConfigFilter filter) { config_filter_ = filter; }
+		//! Replay the session. The content of the televisions is not recorded, so the
+		//	televisions created show the given stream.
+		//	@return AR_SUCCESS at the end of the session. AR_INVALID_INPUT if the file is corrupted.
+		ERROR_CODE Replay(AREngine& engine,
+						  FrameStream& content_stream,
+						  ReplayMode mode = REPLAY_FAST,
+						  FrameCallback callback = FrameCallback(),
+						  ReplayStats* stats = NULL);
+
+	private:
+		SessionReader reader_;
+		//! IDs of the objects in the recording to those in the engine.
+		std::unordered_map<int, int> id_map_;
+		ConfigFilter config_filter_;
+
+		int MapID(int recorded_id) const;
+	};
+}
+
+#endif // !SESSIONREPLAYER_H
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <opencv2/imgproc.hpp>
+
+#include <ar_engine/VObject.h>
+#include <ar_engine/TileCompositor.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	void TileCompositor::Compose(Mat& scene, const vector<VObjectIndex::Entry>& draw_list, const Matx33d& reprojection) {
+		if (!Bin(scene.size(), draw_list, reprojection, false))
+			return;
+		DrawTiles(draw_list, [&](VObject& obj, const Rect& region) { obj.DrawRegion(scene, region); });
+	}
+
+	void TileCompositor::Compose(YUVFrame& scene, const vector<VObjectIndex::Entry>& draw_list) {
+		if (!Bin(Size(scene.width, scene.height), draw_list, Matx33d::eye(), true))
+			return;
+		for (int i : prepared_)
+			draw_list[i].obj->PrepareYUV(scene.format);
+		// The tiles start at even coordinates, so the regions cut from the widened bounds do.
+		DrawTiles(draw_list, [&](VObject& obj, const Rect& region) { obj.DrawRegion(scene, region); });
+	}
+
+	bool TileCompositor::Bin(Size scene_size, const vector<VObjectIndex::Entry>& draw_list,
+							 const Matx33d& reprojection, bool even) {
+		Rect screen(Point(0, 0), scene_size);
+		screen_ = screen;
+		bool identity = reprojection == Matx33d::eye();
+		// Objects get ready for the frame one at a time, as their content streams are
+		// not meant to be read from several threads.
+		prepared_.clear();
+		bounds_.resize(draw_list.size());
+		for (int i = 0; i < draw_list.size(); ++i) {
+			auto& entry = draw_list[i];
+			quad_buf_.assign(entry.quad, entry.quad + 4);
+			if (!identity) {
+				bool in_front = true;
+				for (auto& pt : quad_buf_) {
+					Vec3d p = reprojection * Vec3d(pt.x, pt.y, 1);
+					// A corner mapped behind the camera has no place on the screen.
+					in_front &= p[2] > 0;
+					if (!in_front)
+						break;
+					pt = Point2f(float(p[0] / p[2]), float(p[1] / p[2]));
+				}
+				if (!in_front || (boundingRect(quad_buf_) & screen).area() == 0)
+					continue;
+			}
+			if (entry.obj->PrepareDraw(quad_buf_, bounds_[i])) {
+				Rect& bounds = bounds_[i];
+				if (even) {
+					bounds.width += bounds.x & 1;
+					bounds.height += bounds.y & 1;
+					bounds.x &= ~1;
+					bounds.y &= ~1;
+				}
+				bounds &= screen;
+				if (bounds.area())
+					prepared_.push_back(i);
+			}
+		}
+		if (prepared_.empty())
+			return false;
+
+		int cols = (scene_size.width + TILE_SIZE - 1) / TILE_SIZE;
+		int rows = (scene_size.height + TILE_SIZE - 1) / TILE_SIZE;
+		cols_ = cols;
+		auto ForEachTile = [&](const Rect& bounds, int obj_ind, bool fill) {
+			Rect clipped = bounds & screen;
+			if (clipped.area() == 0)
+				return;
+			int col_end = (clipped.x + clipped.width - 1) / TILE_SIZE;
+			int row_end = (clipped.y + clipped.height - 1) / TILE_SIZE;
+			for (int row = clipped.y / TILE_SIZE; row <= row_end; ++row)
+				for (int col = clipped.x / TILE_SIZE; col <= col_end; ++col) {
+					int tile = row * cols + col;
+					if (fill)
+						tile_items_[cursor_[busy_ind_[tile]]++] = obj_ind;
+					else
+						++busy_ind_[tile];
+				}
+		};
+
+		// Count the objects of each tile, then number the busy tiles.
+		busy_ind_.assign(cols * rows, 0);
+		for (int i : prepared_)
+			ForEachTile(bounds_[i], i, false);
+		busy_tiles_.clear();
+		tile_start_.assign(1, 0);
+		for (int tile = 0; tile < cols * rows; ++tile) {
+			if (busy_ind_[tile]) {
+				tile_start_.push_back(tile_start_.back() + busy_ind_[tile]);
+				busy_ind_[tile] = int(busy_tiles_.size());
+				busy_tiles_.push_back(tile);
+			}
+			else
+				busy_ind_[tile] = -1;
+		}
+		// Bin the objects, keeping them from the bottom layer up in each tile.
+		tile_items_.resize(tile_start_.back());
+		cursor_.assign(tile_start_.begin(), tile_start_.end() - 1);
+		for (int i : prepared_)
+			ForEachTile(bounds_[i], i, true);
+		return true;
+	}
+
+	void TileCompositor::DrawTiles(const vector<VObjectIndex::Entry>& draw_list,
+								   const function<void(VObject& obj, const Rect& region)>& draw) {
+		ParallelFor(pool_, 0, int(busy_tiles_.size()), [&](int begin, int end) {
+			for (int b = begin; b < end; ++b) {
+				int tile_ind = busy_tiles_[b];
+				Rect tile = Rect((tile_ind % cols_) * TILE_SIZE, (tile_ind / cols_) * TILE_SIZE, TILE_SIZE, TILE_SIZE) & screen_;
+				for (int k = tile_start_[b]; k < tile_start_[b + 1]; ++k) {
+					int i = tile_items_[k];
+					Rect region = bounds_[i] & tile;
+					if (region.area())
+						draw(*draw_list[i].obj, region);
+				}
+			}
+		}, TASK_COMPOSITING);
+	}
+}
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef TILECOMPOSITOR_H
+#define TILECOMPOSITOR_H
+
+#include <functional>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <common/WorkerPool.h>
+#include <common/YUVFrame.h>
+#include <ar_engine/VObjectIndex.h>
+
+namespace ar {
+	//! The class TileCompositor overlays virtual objects onto a scene tile by tile.
+	//	Objects are binned into the tiles their bounds overlap, and the tiles are drawn
+	//	in parallel, each with its objects from the bottom layer up. Tiles no object
+	//	covers are not touched, so the cost follows the covered area.
+	class TileCompositor {
+	public:
+		static const int TILE_SIZE = 128;
+
+		//! Draw the tiles on a pool, as compositing tasks, instead of with cv::parallel_for_.
+		inline void SetWorkerPool(WorkerPool* pool) { pool_ = pool; }
+
+		//! Draw the objects of a draw list onto the scene.
+		inline void Compose(cv::Mat& scene, const std::vector<VObjectIndex::Entry>& draw_list) {
+			Compose(scene, draw_list, cv::Matx33d::eye());
+		}
+		//! Draw the objects of a draw list onto the scene, with their outlines mapped by
+		//	a homography, such as from the frame they were indexed in to a later view.
+		void Compose(cv::Mat& scene, const std::vector<VObjectIndex::Entry>& draw_list, const cv::Matx33d& reprojection);
+		//! Draw the objects of a draw list onto a YUV scene in place. The regions start at
+		//	even coordinates, so that they cover whole chroma samples.
+		void Compose(YUVFrame& scene, const std::vector<VObjectIndex::Entry>& draw_list);
+
+	private:
+		WorkerPool* pool_ = NULL;
+		cv::Rect screen_;
+		//! Number of tile columns of the scene.
+		int cols_ = 0;
+		//! Indices into the draw list of the objects prepared for the frame.
+		std::vector<int> prepared_;
+		//! Bounds of the objects in the scene, by their indices in the draw list.
+		std::vector<cv::Rect> bounds_;
+		std::vector<cv::Point2f> quad_buf_;
+		//! Index among the busy tiles of each tile, or -1 if no object covers it.
+		std::vector<int> busy_ind_;
+		//! Tiles covered by some object. The objects of busy tile i are
+		//	tile_items_[tile_start_[i]] to tile_items_[tile_start_[i + 1] - 1].
+		std::vector<int> busy_tiles_;
+		std::vector<int> tile_start_;
+		std::vector<int> tile_items_;
+		std::vector<int> cursor_;
+
+		//! Prepare the objects for a scene and bin them into its tiles.
+		//	@param even Whether to widen the bounds of the objects to even coordinates.
+		//	@return False if there is nothing to draw.
+		bool Bin(cv::Size scene_size, const std::vector<VObjectIndex::Entry>& draw_list,
+				 const cv::Matx33d& reprojection, bool even);
+		//! Draw the busy tiles in parallel, each object by the region it covers of a tile.
+		void DrawTiles(const std::vector<VObjectIndex::Entry>& draw_list,
+					   const std::function<void(VObject& obj, const cv::Rect& region)>& draw);
+	};
+}
+
+#endif // !TILECOMPOSITOR_H
@@ -5,42 +5,19 @@
 // Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
 ///////////////////////////////////////////////////////////
 #pragma once
+#include <array>
 #include <chrono>
-#include <thread>
-#include <mutex>
 
 #include <ar_engine/AREngine.h>
 
 namespace ar {
 	//! Base class for any virtual objects in the AR engine.
 	class VObject {
-		class TimerKiller {
-		public:
-			//! @returns False if killed.
-			template<class R, class P>
-			inline bool WaitFor(std::chrono::duration<R, P> const& time) {
-				std::unique_lock<std::mutex> lock(mutex_);
-				return !cond_var_.wait_for(lock, time, [&] {return terminate_; });
-			}
-			inline void Kill() {
-				std::unique_lock<std::mutex> lock(mutex_);
-				terminate_ = true;
-				cond_var_.notify_all();
-			}
-		private:
-			std::condition_variable cond_var_;
-			std::mutex mutex_;
-			bool terminate_ = false;
-		};
-
-		AREngine& engine_;
 		int id_;
-		bool alive_ = true;
+		// The engine removes the object on a frame after it has been idle for some time.
 		std::chrono::steady_clock::time_point last_viewed_time_;
-		// The object will tell the engine to remove itself after being idle for sometime.
-		std::thread monitor_thread_;
-		TimerKiller monitor_killer_;
-		static void Monitor(VObject* obj);
+	protected:
+		AREngine& engine_;
 	public:
 		//! Layer index for dealing with virtual objects' overlapping.
 		//	INT_MAX means the object is not overlappable.
@@ -48,9 +25,45 @@ namespace ar {
 		VObject(AREngine& engine, int id, int layer_ind);
 		virtual ~VObject();
 		inline void UpdateViewedTime() { last_viewed_time_ = std::chrono::steady_clock::now(); }
+		inline std::chrono::steady_clock::time_point GetLastViewedTime() const { return last_viewed_time_; }
+		inline int GetID() const { return id_; }
+		//! Remove the object from the engine.
 		void Disappear();
 		virtual bool IsSelected(cv::Point2f pt2d, int frame_id) = 0;
-		virtual void Draw(cv::Mat& scene, const cv::Mat& camera_matrix) = 0;
+		//! Get the outline of the object in a frame, as a convex quadrangle.
+		//	@return False if the object is not visible in the frame.
+		virtual bool GetScreenQuad(int frame_id, std::vector<cv::Point2f>& quad) const = 0;
+		//! Get the corners of the object in the world, if it is anchored to known 3D points,
+		//	in the order of left-upper, right-upper, right-lower and left-lower.
+		virtual bool GetWorldCorners(std::array<cv::Vec3d, 4>& corners) const { return false; }
+		//! Anchor the object to corners in the world, such as while it is dragged.
+		//	@return False if the object cannot be moved.
+		virtual bool MoveTo(const std::array<cv::Vec3d, 4>& corners) { return false; }
+		//! Whether the object hides everything behind it.
+		virtual bool IsOpaque() const { return true; }
+		//! Look at the raw scene of a frame before the object is drawn onto it, such as to
+		//	find what is in front of the object.
+		virtual void ObserveScene(const FramePyramid& pyramid, int frame_id) {}
+		//! Move on to the next frame of the content, if any. Called once per tracked frame
+		//	while the object is drawn, so that drawing a frame again reuses its content.
+		virtual void AdvanceContent() {}
+		virtual void Draw(cv::Mat& scene, const cv::Mat& camera_matrix, int frame_id) = 0;
+		//! Get ready to draw the object onto an outline region by region, such as by mapping
+		//	the content onto it. The outline is the one in the frame, or one reprojected to a later pose,
+		//	in undistorted pixels.
+		//	@param bounds Set to the bounds of the pixels to draw in the scene, which differ
+		//	from those of the outline under lens distortion.
+		//	@return False if there is nothing to draw.
+		virtual bool PrepareDraw(const std::vector<cv::Point2f>& quad, cv::Rect& bounds) = 0;
+		//! Draw the part of the object inside a region of the scene, after PrepareDraw.
+		//	Disjoint regions may be drawn in parallel.
+		virtual void DrawRegion(cv::Mat& scene, const cv::Rect& region) = 0;
+		//! Get what PrepareDraw got ready in the form of YUV scenes of a format.
+		virtual void PrepareYUV(YUVFormat format) {}
+		//! Draw the part of the object inside a region of a YUV scene in place, after
+		//	PrepareDraw and PrepareYUV. The region starts at even coordinates, so that it
+		//	covers whole chroma samples. Disjoint regions may be drawn in parallel.
+		virtual void DrawRegion(YUVFrame& scene, const cv::Rect& region) = 0;
 		virtual VObjType GetType() = 0;
 	};
 }
\ No newline at end of file
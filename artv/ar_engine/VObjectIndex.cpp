@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <functional>
+#include <opencv2/imgproc.hpp>
+
+#include <ar_engine/VObject.h>
+#include <ar_engine/VObjectIndex.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	bool VObjectIndex::Contains(const Point2f* quad, const Point2f& pt) {
+		// Inside a convex polygon, the point is on the same side of every edge.
+		bool has_pos = false, has_neg = false;
+		for (int i = 0; i < 4; ++i) {
+			float cross = (quad[(i + 1) % 4] - quad[i]).cross(pt - quad[i]);
+			has_pos |= cross > 0;
+			has_neg |= cross < 0;
+		}
+		return !(has_pos && has_neg);
+	}
+
+	int VObjectIndex::CellOf(const Point2f& pt) const {
+		int col = int(floor(pt.x / CELL_SIZE));
+		int row = int(floor(pt.y / CELL_SIZE));
+		if (col < 0 || col >= cols_ || row < 0 || row >= rows_)
+			return -1;
+		return row * cols_ + col;
+	}
+
+	void VObjectIndex::Build(const unordered_map<int, VObject*>& objects, int frame_id, Size frame_size) {
+		entries_.clear();
+		draw_list_.clear();
+		Rect screen(Point(0, 0), frame_size);
+		for (auto& obj : objects) {
+			if (!obj.second->GetScreenQuad(frame_id, quad_buf_) || quad_buf_.size() != 4)
+				continue;
+			Entry entry;
+			entry.id = obj.first;
+			entry.obj = obj.second;
+			entry.layer = obj.second->layer_ind_;
+			copy(quad_buf_.begin(), quad_buf_.end(), entry.quad);
+			entry.bounds = boundingRect(quad_buf_) & screen;
+			// Off the screen.
+			if (entry.bounds.area() == 0)
+				continue;
+			entries_.push_back(entry);
+		}
+		sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+			return a.layer != b.layer ? a.layer > b.layer : a.id > b.id;
+		});
+
+		// Bucket the objects into the cells they overlap, keeping the order of entries_.
+		cols_ = (frame_size.width + CELL_SIZE - 1) / CELL_SIZE;
+		rows_ = (frame_size.height + CELL_SIZE - 1) / CELL_SIZE;
+		cell_start_.assign(cols_ * rows_ + 1, 0);
+		auto ForEachCell = [this](const Rect& bounds, const function<void(int)>& f) {
+			int col_end = (bounds.x + bounds.width - 1) / CELL_SIZE;
+			int row_end = (bounds.y + bounds.height - 1) / CELL_SIZE;
+			for (int row = bounds.y / CELL_SIZE; row <= row_end; ++row)
+				for (int col = bounds.x / CELL_SIZE; col <= col_end; ++col)
+					f(row * cols_ + col);
+		};
+		for (auto& entry : entries_)
+			ForEachCell(entry.bounds, [this](int cell) { ++cell_start_[cell + 1]; });
+		for (int i = 0; i < cols_ * rows_; ++i)
+			cell_start_[i + 1] += cell_start_[i];
+		cell_items_.resize(cell_start_.back());
+		cursor_buf_.assign(cell_start_.begin(), cell_start_.end() - 1);
+		for (int i = 0; i < entries_.size(); ++i)
+			ForEachCell(entries_[i].bounds, [this, i](int cell) { cell_items_[cursor_buf_[cell]++] = i; });
+
+		// Cull the objects covered by an opaque object above. Such an object covers the
+		// first corner too, so it is listed in the cell of that corner.
+		for (int i = int(entries_.size()) - 1; i >= 0; --i) {
+			auto& entry = entries_[i];
+			bool covered = false;
+			int cell = CellOf(entry.quad[0]);
+			if (cell >= 0)
+				for (int k = cell_start_[cell]; k < cell_start_[cell + 1] && !covered; ++k) {
+					int j = cell_items_[k];
+					if (j >= i)
+						break;
+					auto& above = entries_[j];
+					if (!above.obj->IsOpaque())
+						continue;
+					covered = true;
+					for (auto& corner : entry.quad)
+						if (!Contains(above.quad, corner)) {
+							covered = false;
+							break;
+						}
+				}
+			if (!covered)
+				draw_list_.push_back(entry);
+		}
+	}
+
+	int VObjectIndex::HitTest(const Point2f& pt) const {
+		int cell = CellOf(pt);
+		if (cell < 0)
+			return -1;
+		for (int k = cell_start_[cell]; k < cell_start_[cell + 1]; ++k) {
+			auto& entry = entries_[cell_items_[k]];
+			if (Contains(entry.quad, pt))
+				return entry.id;
+		}
+		return -1;
+	}
+}
@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef VOBJECTINDEX_H
+#define VOBJECTINDEX_H
+
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace ar {
+	class VObject;
+
+	//! The class VObjectIndex is a screen-space uniform grid over the virtual objects
+	//	in a frame. Each cell lists the objects whose bounding boxes overlap it, from the
+	//	top layer down, so a hit test only visits the objects around the point. Objects
+	//	off the screen, or covered by an opaque object above them, are left out of the
+	//	draw list.
+	class VObjectIndex {
+	public:
+		static const int CELL_SIZE = 64;
+
+		struct Entry {
+			int id;
+			VObject* obj;
+			int layer;
+			cv::Point2f quad[4];
+			cv::Rect bounds;
+		};
+
+		//! Index the objects by their outlines in a frame.
+		void Build(const std::unordered_map<int, VObject*>& objects, int frame_id, cv::Size frame_size);
+		//! @return ID of the top object at a point. -1 for no object at the point.
+		int HitTest(const cv::Point2f& pt) const;
+		//! The objects to draw, from the bottom layer up.
+		inline const std::vector<Entry>& DrawList() const { return draw_list_; }
+
+	private:
+		int cols_ = 0;
+		int rows_ = 0;
+		//! Objects on the screen, from the top layer down.
+		std::vector<Entry> entries_;
+		//! Items of cell i are cell_items_[cell_start_[i]] to cell_items_[cell_start_[i + 1] - 1],
+		//	as indices into entries_ in ascending order.
+		std::vector<int> cell_start_;
+		std::vector<int> cell_items_;
+		std::vector<Entry> draw_list_;
+		//! Buffers kept to save allocations on rebuilding.
+		std::vector<cv::Point2f> quad_buf_;
+		std::vector<int> cursor_buf_;
+
+		int CellOf(const cv::Point2f& pt) const;
+		static bool Contains(const cv::Point2f* quad, const cv::Point2f& pt);
+	};
+}
+
+#endif // !VOBJECTINDEX_H
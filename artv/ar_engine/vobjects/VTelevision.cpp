@@ -11,8 +11,6 @@ using namespace cv;
 
 namespace ar
 {
-	const double VTelevision::MEAN_TV_SIZE_RATE = 0.1;
-
 	VTelevision::VTelevision(AREngine& engine,
 							 int id,
 							 FrameStream& content_stream) :
@@ -21,11 +19,47 @@ namespace ar
 	{
 	}
 
+	bool VTelevision::GetScreenQuad(int frame_id, vector<Point2f>& quad) const {
+		if (frame_id != quad_frame_id_) {
+			quad_frame_id_ = frame_id;
+			quad_visible_ = true;
+			quad_.clear();
+			if (anchored_to_world_) {
+				Matx33d R;
+				Vec3d t;
+				engine_.GetLastPose(R, t);
+				const Matx33d& K = engine_.GetCameraModel().K();
+				for (auto& corner : world_corners_) {
+					Vec3d x = K * (R * corner + t);
+					if (x[2] <= 0) {
+						quad_visible_ = false;
+						break;
+					}
+					quad_.push_back(Point2f(float(x[0] / x[2]), float(x[1] / x[2])));
+				}
+			}
+			else
+				for (auto& corner : { left_upper_, right_upper_, right_lower_, left_lower_ }) {
+					auto obs = corner ? corner->observation(frame_id) : InterestPoint::Observation();
+					if (!obs.visible) {
+						quad_visible_ = false;
+						break;
+					}
+					quad_.push_back(obs.pt);
+				}
+		}
+		quad = quad_;
+		return quad_visible_;
+	}
+
 	bool VTelevision::IsSelected(Point2f pt2d, int frame_id) {
-		Point2f lu = left_upper_->observation(frame_id).pt.pt;
-		Point2f ll = left_lower_->observation(frame_id).pt.pt;
-		Point2f ru = right_upper_->observation(frame_id).pt.pt;
-		Point2f rl = right_lower_->observation(frame_id).pt.pt;
+		vector<Point2f> quad;
+		if (!GetScreenQuad(frame_id, quad))
+			return false;
+		Point2f lu = quad[0];
+		Point2f ru = quad[1];
+		Point2f rl = quad[2];
+		Point2f ll = quad[3];
 
 		return (ru - lu).cross(pt2d - lu) > 0
 			&& (rl - ru).cross(pt2d - ru) > 0
@@ -41,10 +75,190 @@ namespace ar
 		left_lower_ = left_lower;
 		right_upper_ = right_upper;
 		right_lower_ = right_lower;
+		anchored_to_world_ = false;
+		quad_frame_id_ = -1;
+		occlusion_.Reset();
+	}
+
+	void VTelevision::locate(const array<Vec3d, 4>& corners) {
+		world_corners_ = corners;
+		anchored_to_world_ = true;
+		quad_frame_id_ = -1;
+		occlusion_.Reset();
+	}
+
+	bool VTelevision::GetWorldCorners(array<Vec3d, 4>& corners) const {
+		if (anchored_to_world_) {
+			corners = world_corners_;
+			return true;
+		}
+		int k = 0;
+		for (auto& corner : { left_upper_, right_upper_, right_lower_, left_lower_ }) {
+			if (!corner || !corner->has_loc3d())
+				return false;
+			corners[k++] = Vec3d(corner->loc3d_);
+		}
+		return true;
+	}
+
+	bool VTelevision::MoveTo(const array<Vec3d, 4>& corners) {
+		locate(corners);
+		return true;
+	}
+
+	bool VTelevision::IsOccluded() const {
+		return engine_.GetConfig().occlusion && occlusion_.Active();
+	}
+
+	bool VTelevision::IsOpaque() const {
+		return !IsOccluded();
+	}
+
+	void VTelevision::ObserveScene(const FramePyramid& pyramid, int frame_id) {
+		vector<Point2f> quad;
+		if (GetScreenQuad(frame_id, quad))
+			occlusion_.Update(pyramid, engine_.GetCameraModel(), quad);
 	}
 
-	void VTelevision::Draw(cv::Mat& scene, const cv::Mat& camera_matrix) {
-		// TODO: Need implementation. Use the camera matrix to project the television and the
-		// video content on the scene.
+	void VTelevision::Draw(cv::Mat& scene, const cv::Mat& camera_matrix, int frame_id) {
+		vector<Point2f> quad;
+		Rect bounds;
+		if (!GetScreenQuad(frame_id, quad) || !PrepareDraw(quad, bounds))
+			return;
+		Rect roi = prepared_bounds_ & Rect(Point(0, 0), scene.size());
+		if (roi.area())
+			DrawRegion(scene, roi);
+	}
+
+	void VTelevision::AdvanceContent() {
+		if (content_stream_.NextFrame(content_) < 0)
+			content_.release();
+		yuv_format_ = -1;
+	}
+
+	bool VTelevision::PrepareDraw(const vector<Point2f>& quad, Rect& bounds) {
+		if (content_.empty())
+			return false;
+		vector<Point2f> src = { Point2f(0, 0),
+								Point2f(float(content_.cols), 0),
+								Point2f(float(content_.cols), float(content_.rows)),
+								Point2f(0, float(content_.rows)) };
+		prepared_homography_ = getPerspectiveTransform(src, quad);
+		prepared_inverse_ = prepared_homography_.inv();
+		prepared_bounds_ = engine_.GetCameraModel().DistortedBounds(quad);
+		bounds = prepared_bounds_;
+		UpdateViewedTime();
+		return true;
+	}
+
+	void VTelevision::WarpToRegion(const Mat& src, const Matx33d& to_content, const Rect& region,
+								   int interpolation, int border, Mat& dst, const Matx33d& to_scene) const {
+		auto& camera = engine_.GetCameraModel();
+		if (!camera.HasDistortion()) {
+			Matx33d to_region(1, 0, -region.x, 0, 1, -region.y, 0, 0, 1);
+			warpPerspective(src, dst, to_region * to_scene.inv() * prepared_homography_ * to_content, region.size(),
+							interpolation, border);
+			return;
+		}
+		// Under lens distortion, each pixel of the region is undistorted through the lookup
+		// table and mapped back onto the source. Only the region is remapped.
+		Matx33d inverse = to_content.inv() * prepared_inverse_;
+		Mat map(region.size(), CV_32FC2);
+		for (int y = 0; y < region.height; ++y) {
+			auto row = map.ptr<Vec2f>(y);
+			for (int x = 0; x < region.width; ++x) {
+				Vec3d s = to_scene * Vec3d(region.x + x, region.y + y, 1);
+				Point2f u = camera.UndistortPixel(Point2f(float(s[0] / s[2]), float(s[1] / s[2])));
+				Vec3d c = inverse * Vec3d(u.x, u.y, 1);
+				row[x] = c[2] > 0 ? Vec2f(float(c[0] / c[2]), float(c[1] / c[2])) : Vec2f(-1, -1);
+			}
+		}
+		remap(src, dst, map, noArray(), interpolation, border);
+	}
+
+	void VTelevision::DrawPlane(const Mat& src, const Matx33d& to_content, const Rect& region,
+								Mat& canvas, const Matx33d& to_scene) const {
+		// Only warp the content into the region. Pixels outside the television are left
+		// untouched by the transparent border.
+		int interpolation = engine_.GetConfig().CompositorInterpolation();
+		if (!IsOccluded()) {
+			WarpToRegion(src, to_content, region, interpolation, BORDER_TRANSPARENT, canvas, to_scene);
+			return;
+		}
+		// Real objects in front of the television show through by the occlusion mask,
+		// upsampled from its grid, which blends the drawn pixels back to the scene.
+		Mat drawn = canvas.clone();
+		WarpToRegion(src, to_content, region, interpolation, BORDER_TRANSPARENT, drawn, to_scene);
+		Size grid = occlusion_.GetGridSize();
+		Matx33d grid_to_content(double(content_.cols) / grid.width, 0, 0,
+								0, double(content_.rows) / grid.height, 0,
+								0, 0, 1);
+		// Grid cells are sampled at their centers.
+		Matx33d centered(1, 0, 0.5, 0, 1, 0.5, 0, 0, 1);
+		Mat mask;
+		WarpToRegion(occlusion_.GetMask(), grid_to_content * centered, region, INTER_LINEAR, BORDER_REPLICATE, mask, to_scene);
+		int cn = canvas.channels();
+		for (int y = 0; y < region.height; ++y) {
+			const float* m = mask.ptr<float>(y);
+			const uchar* d = drawn.ptr<uchar>(y);
+			uchar* c = canvas.ptr<uchar>(y);
+			for (int x = 0; x < region.width; ++x)
+				for (int k = 0; k < cn; ++k) {
+					int i = x * cn + k;
+					c[i] = saturate_cast<uchar>(d[i] + (c[i] - d[i]) * m[x]);
+				}
+		}
+	}
+
+	void VTelevision::DrawRegion(cv::Mat& scene, const cv::Rect& region) {
+		Mat canvas = scene(region);
+		DrawPlane(content_, Matx33d::eye(), region, canvas);
+	}
+
+	void VTelevision::PrepareYUV(YUVFormat format) {
+		if (yuv_format_ == format)
+			return;
+		yuv_format_ = format;
+		// Only the content is converted, which is usually much smaller than the scene.
+		// I420 needs even sizes, so an odd last row or column is left out.
+		Mat content = content_(Rect(0, 0, content_.cols & ~1, content_.rows & ~1));
+		int cw = content.cols, ch = content.rows;
+		if (content.empty()) {
+			content_y_.release();
+			return;
+		}
+		cvtColor(content, content_yuv_, COLOR_BGR2YUV_I420);
+		content_y_ = content_yuv_.rowRange(0, ch);
+		content_u_ = Mat(ch / 2, cw / 2, CV_8UC1, content_yuv_.ptr(ch));
+		content_v_ = Mat(ch / 2, cw / 2, CV_8UC1, content_yuv_.ptr(ch) + (ch / 2) * (cw / 2));
+		if (format == YUV_NV12)
+			merge(vector<Mat>{ content_u_, content_v_ }, content_uv_);
+		else if (format == YUV_NV21)
+			merge(vector<Mat>{ content_v_, content_u_ }, content_uv_);
+	}
+
+	void VTelevision::DrawRegion(YUVFrame& scene, const Rect& region) {
+		if (content_y_.empty())
+			return;
+		// The planes are drawn as BGR scenes are, following the lens distortion and the
+		// occlusion mask.
+		Mat luma = scene.Luma()(region);
+		DrawPlane(content_y_, Matx33d::eye(), region, luma);
+
+		// The chroma sample (x, y) sits at (2x + 0.5, 2y + 0.5) of the luma plane, in the
+		// content as in the scene.
+		Matx33d chroma2luma(2, 0, 0.5, 0, 2, 0.5, 0, 0, 1);
+		Rect chroma_region = Rect(region.x / 2, region.y / 2, (region.width + 1) / 2, (region.height + 1) / 2) &
+			Rect(0, 0, scene.ChromaWidth(), scene.ChromaHeight());
+		if (scene.format == YUV_I420) {
+			Mat u = scene.PlaneU()(chroma_region);
+			Mat v = scene.PlaneV()(chroma_region);
+			DrawPlane(content_u_, chroma2luma, chroma_region, u, chroma2luma);
+			DrawPlane(content_v_, chroma2luma, chroma_region, v, chroma2luma);
+		}
+		else {
+			Mat uv = scene.InterleavedChroma()(chroma_region);
+			DrawPlane(content_uv_, chroma2luma, chroma_region, uv, chroma2luma);
+		}
 	}
-}
\ No newline at end of file
+}
@@ -9,9 +9,11 @@
 #ifndef VTELEVISION_H
 #define VTELEVISION_H
 
+#include <array>
 #include <opencv2/opencv.hpp>
 
 #include <common/CVUtils.h>
+#include <ar_engine/OcclusionModel.h>
 #include <ar_engine/VObject.h>
 
 namespace ar
@@ -24,9 +26,42 @@ namespace ar
 		shared_ptr<const InterestPoint> left_lower_;
 		shared_ptr<const InterestPoint> right_upper_;
 		shared_ptr<const InterestPoint> right_lower_;
-	public:
-		static const double MEAN_TV_SIZE_RATE;
+		//! Corners in the world, used instead of the interest points if anchored to a plane.
+		bool anchored_to_world_ = false;
+		std::array<cv::Vec3d, 4> world_corners_;
 
+		//! The quad of the last frame asked for, as it is needed by both indexing and drawing.
+		mutable int quad_frame_id_ = -1;
+		mutable bool quad_visible_ = false;
+		mutable std::vector<cv::Point2f> quad_;
+		//! The content frame of the last tracked frame.
+		cv::Mat content_;
+		//! Mapping of the content onto the scene, prepared for drawing a frame.
+		cv::Matx33d prepared_homography_;
+		cv::Matx33d prepared_inverse_;
+		cv::Rect prepared_bounds_;
+		//! Planes of the content converted for YUV scenes, of the format yuv_format_, or
+		//	-1 if not converted since the content changed. Chroma is interleaved in
+		//	content_uv_ for NV12 and NV21, and split for I420.
+		int yuv_format_ = -1;
+		cv::Mat content_yuv_;
+		cv::Mat content_y_, content_u_, content_v_, content_uv_;
+		//! Finds the real objects in front of the television.
+		OcclusionModel occlusion_;
+		bool IsOccluded() const;
+		//! Warp an image over the television into a region of a plane of the scene.
+		//	@param to_content Maps the pixels of the image to those of the content.
+		//	@param to_scene Maps the pixels of the plane to those of the scene, for planes
+		//	of a lower resolution, such as chroma.
+		void WarpToRegion(const cv::Mat& src, const cv::Matx33d& to_content, const cv::Rect& region,
+						  int interpolation, int border, cv::Mat& dst,
+						  const cv::Matx33d& to_scene = cv::Matx33d::eye()) const;
+		//! Draw an image over the television into a region of a plane of the scene, with
+		//	the real objects in front of it showing through if occluded. The parameters
+		//	are those of WarpToRegion.
+		void DrawPlane(const cv::Mat& src, const cv::Matx33d& to_content, const cv::Rect& region,
+					   cv::Mat& canvas, const cv::Matx33d& to_scene = cv::Matx33d::eye()) const;
+	public:
 		VTelevision(AREngine& engine,
 					int id,
 					FrameStream& content_stream);
@@ -35,10 +70,29 @@ namespace ar
 					const std::shared_ptr<const InterestPoint>& left_lower,
 					const std::shared_ptr<const InterestPoint>& right_upper,
 					const std::shared_ptr<const InterestPoint>& right_lower);
+		//! Anchor the television to corners in the world, in the order of left-upper,
+		//	right-upper, right-lower and left-lower. They are projected with the pose of the
+		//	camera, so the television stays even where no interest point is tracked.
+		void locate(const std::array<cv::Vec3d, 4>& corners);
+		//! The world corners, or the 3D locations of the corner interest points if all are known.
+		bool GetWorldCorners(std::array<cv::Vec3d, 4>& corners) const;
+		bool MoveTo(const std::array<cv::Vec3d, 4>& corners);
 
 		inline VObjType GetType() { return TV; }
 		bool IsSelected(cv::Point2f pt2d, int frame_id);
-		void Draw(cv::Mat& scene, const cv::Mat& camera_matrix);
+		//! Not opaque while a real object is in front of it.
+		bool IsOpaque() const;
+		void ObserveScene(const FramePyramid& pyramid, int frame_id);
+		void AdvanceContent();
+		//! Get the corners of the television in the frame, in the order of left-upper,
+		//	right-upper, right-lower and left-lower.
+		//	@return False if any of the corners is not visible in the frame.
+		bool GetScreenQuad(int frame_id, std::vector<cv::Point2f>& quad) const;
+		void Draw(cv::Mat& scene, const cv::Mat& camera_matrix, int frame_id);
+		bool PrepareDraw(const std::vector<cv::Point2f>& quad, cv::Rect& bounds);
+		void DrawRegion(cv::Mat& scene, const cv::Rect& region);
+		void PrepareYUV(YUVFormat format);
+		void DrawRegion(YUVFrame& scene, const cv::Rect& region);
 	};
 }
 
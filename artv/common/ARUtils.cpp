@@ -4,59 +4,47 @@ using namespace std;
 using namespace cv;
 
 namespace ar {
-	Mat RefineFundamentalMatrix(const Mat& fundamental_matrix,
+	Matx33d RefineFundamentalMatrix(const Matx33d& fundamental_matrix,
 		const vector<Point2d>& point1,
 		const vector<Point2d>& point2) {
 		// TODO: Locally minimize a geometric cost function.
 		
 
 		// Enforce singularity.
-		auto svd = SVD(fundamental_matrix);
-		auto Sigma = svd.w;
-		Sigma.at<double>(Sigma.cols - 1, Sigma.rows - 1) = 0;
-		return svd.u * Sigma * svd.vt;
+		Matx33d U, V;
+		Vec3d w;
+		SVD3x3(fundamental_matrix, U, w, V);
+		return U * Matx33d::diag(Vec3d(w[0], w[1], 0)) * V.t();
 	}
 
 	//! Recover rotation and translation from an essential matrix.
-	//	This operation produces four posible results, each is a 3x4 matrix that combines
-	//	rotation and translation.
-	vector<Mat> RecoverRotAndTranslation(const Mat& essential_matrix) {
-		Mat U, W, Vt;
-		auto svd = SVD();
-		svd.compute(essential_matrix, U, W, Vt);
+	//	This operation produces four posible results, each combining a rotation and a
+	//	translation.
+	array<SE3, 4> RecoverRotAndTranslation(const Matx33d& essential_matrix) {
+		// The two equal singular values of a regularized essential matrix do not change
+		// U and V, so a single decomposition is enough.
+		Matx33d U, V;
+		Vec3d w;
+		SVD3x3(essential_matrix, U, w, V);
 
-		double m = (W.at<double>(1, 1) + W.at<double>(2, 2)) / 2;
-		W.at<double>(0, 0) = W.at<double>(1, 1) = m;
-		Mat regularized_E = U * W * Vt;
-		svd.compute(regularized_E, U, W, Vt);
-
-		W.at<double>(0, 0) = W.at<double>(1, 1) = 0;
-		W.at<double>(0, 1) = -1;
-		W.at<double>(1, 0) = W.at<double>(2, 2) = 1;
+		Matx33d W(0, -1, 0,
+				  1, 0, 0,
+				  0, 0, 1);
+		Matx33d Vt = V.t();
 		if (determinant(U * W * Vt) < 0)
 			W = -W;
 
-		vector<Mat> res;
-		res.reserve(4);
-		Mat R1 = U * W * Vt;
-		Mat R2 = U * W.t() * Vt;
-		Mat t = U.col(2) / max({ abs(U.at<double>(2, 0)), abs(U.at<double>(2, 1)), abs(U.at<double>(2, 2)) });
-		Mat candidate;
-		hconcat(R1, t, candidate);
-		res.push_back(candidate);
-		hconcat(R1, -t, candidate);
-		res.push_back(candidate);
-		hconcat(R2, t, candidate);
-		res.push_back(candidate);
-		hconcat(R2, -t, candidate);
-		res.push_back(candidate);
-		return res;
+		Matx33d R1 = U * W * Vt;
+		Matx33d R2 = U * W.t() * Vt;
+		Vec3d t = Vec3d(U(0, 2), U(1, 2), U(2, 2)) * (1 / max({ abs(U(2, 0)), abs(U(2, 1)), abs(U(2, 2)) }));
+		return { { SE3(R1, t), SE3(R1, -t), SE3(R2, t), SE3(R2, -t) } };
 	}
 
 	//! Calculate the relative rotation and translation from camera 1 to camera 2,
 	//	given their own rotations and translations with respect to the world coordinate.
-	pair<Mat, Mat> CalRelRotAndTranslation(Mat R1, Mat t1, Mat R2, Mat t2) {
-		return { R1.t() * R2, R1.t() * (t2 - t1) };
+	SE3 CalRelRotAndTranslation(const SE3& pose1, const SE3& pose2) {
+		Matx33d R1t = pose1.R.t();
+		return SE3(R1t * pose2.R, R1t * (pose2.t - pose1.t));
 	}
 
 	//! Input a series of camera matrices and 2D points. The 2D points are all matched in order to relate to some 3D points.
@@ -64,14 +52,76 @@ namespace ar {
 	ERROR_CODE triangulate(const std::vector<std::pair<cv::Mat, cv::Mat>>& camera_matrices_and_2d_points,
 						   cv::Mat& points3d,
 						   double* error) {
+		return triangulate(camera_matrices_and_2d_points.data(), int(camera_matrices_and_2d_points.size()),
+						   points3d, error);
+	}
+
+	ERROR_CODE triangulate(const std::pair<cv::Mat, cv::Mat>* camera_matrices_and_2d_points,
+						   int num_views,
+						   cv::Mat& points3d,
+						   double* error) {
 		int num_pts = -1;
-		for (auto& p : camera_matrices_and_2d_points) {
+		for (int i = 0; i < num_views; ++i) {
+			auto& p = camera_matrices_and_2d_points[i];
 			if (num_pts < 0)
 				num_pts = p.second.rows;
 			else if (p.second.rows != num_pts)
 				return AR_INVALID_INPUT;
+			if (p.first.rows != 3 || p.first.cols != 4 || p.second.type() != CV_32F)
+				return AR_INVALID_INPUT;
 		}
+		if (num_views < 2)
+			return AR_INVALID_INPUT;
 
-		// TODO: Estimate the 3D points with all the information.
+		// Linear triangulation with all the views: each view gives two rows of A in AX = 0.
+		vector<Matx34d> cameras(num_views);
+		for (int i = 0; i < num_views; ++i)
+			cameras[i] = camera_matrices_and_2d_points[i].first;
+		points3d.create(num_pts, 3, CV_64F);
+		Mat A(num_views * 2, 4, CV_64F);
+		Mat X;
+		double total_error = 0;
+		for (int k = 0; k < num_pts; ++k) {
+			for (int i = 0; i < num_views; ++i) {
+				auto& P = cameras[i];
+				const float* x = camera_matrices_and_2d_points[i].second.ptr<float>(k);
+				for (int j = 0; j < 4; ++j) {
+					A.at<double>(i * 2, j) = x[0] * P(2, j) - P(0, j);
+					A.at<double>(i * 2 + 1, j) = x[1] * P(2, j) - P(1, j);
+				}
+			}
+			SVD::solveZ(A, X);
+			Vec4d Xh(X.at<double>(0), X.at<double>(1), X.at<double>(2), X.at<double>(3));
+			Vec3d pt(Xh[0] / Xh[3], Xh[1] / Xh[3], Xh[2] / Xh[3]);
+			points3d.at<double>(k, 0) = pt[0];
+			points3d.at<double>(k, 1) = pt[1];
+			points3d.at<double>(k, 2) = pt[2];
+
+			if (error)
+				for (int i = 0; i < num_views; ++i) {
+					Vec3d projected = cameras[i] * Vec4d(pt[0], pt[1], pt[2], 1);
+					const float* x = camera_matrices_and_2d_points[i].second.ptr<float>(k);
+					total_error += sqrt(pow(projected[0] / projected[2] - x[0], 2) +
+										pow(projected[1] / projected[2] - x[1], 2));
+				}
+		}
+		// Mean reprojection error in pixels.
+		if (error)
+			*error = num_pts ? total_error / (num_pts * num_views) : 0;
+		return AR_SUCCESS;
+	}
+
+	Vec4d TriangulatePoint(const Matx34d& P1, const Matx34d& P2, const Point2f& x1, const Point2f& x2) {
+		Matx44d A;
+		for (int j = 0; j < 4; ++j) {
+			A(0, j) = x1.x * P1(2, j) - P1(0, j);
+			A(1, j) = x1.y * P1(2, j) - P1(1, j);
+			A(2, j) = x2.x * P2(2, j) - P2(0, j);
+			A(3, j) = x2.y * P2(2, j) - P2(1, j);
+		}
+		Matx41d w;
+		Matx44d u, vt;
+		SVD::compute(A, w, u, vt);
+		return Vec4d(vt(3, 0), vt(3, 1), vt(3, 2), vt(3, 3));
 	}
 }
\ No newline at end of file
@@ -6,12 +6,14 @@
 ///////////////////////////////////////////////////////////
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <vector>
 
 #include <opencv2/opencv.hpp>
 
 #include <common/ErrorCodes.h>
+#include <common/Geometry.h>
 
 #ifdef _WIN32
 #ifdef COMMON_EXPORTS
@@ -31,25 +33,38 @@ namespace ar {
 	//! Data collected by the motion sensors.
 	struct MotionData {
 		std::chrono::steady_clock::time_point shot_time;
-		//TODO: Fill the data here.
+		//! Angular velocity measured by the gyroscope, in rad/s in the camera coordinate.
+		cv::Vec3d angular_velocity;
+		//! Specific force measured by the accelerometer, in m/s^2 in the camera coordinate.
+		//	Gravity is included, as a real accelerometer would report it.
+		cv::Vec3d acceleration;
 	};
 
-	cv::Mat COMMON_API RefineFundamentalMatrix(const cv::Mat& fundamentalMatrix,
-											   const std::vector<cv::Point2d>& point1,
-											   const std::vector<cv::Point2d>& point2);
+	cv::Matx33d COMMON_API RefineFundamentalMatrix(const cv::Matx33d& fundamental_matrix,
+												   const std::vector<cv::Point2d>& point1,
+												   const std::vector<cv::Point2d>& point2);
 
 	//! Recover rotation and translation from an essential matrix.
-	//	This operation produces four posible results, each is a 3x4 matrix that combines
-	//	rotation and translation.
-	std::vector<cv::Mat> COMMON_API RecoverRotAndTranslation(const cv::Mat& essential_matrix);
+	//	This operation produces four posible results, each combining a rotation and a
+	//	translation.
+	std::array<SE3, 4> COMMON_API RecoverRotAndTranslation(const cv::Matx33d& essential_matrix);
 
 	//! Calculate the relative rotation and translation from camera 1 to camera 2,
 	//	given their own rotations and translations with respect to the world coordinate.
-	std::pair<cv::Mat, cv::Mat> COMMON_API CalRelRotAndTranslation(cv::Mat R1, cv::Mat t1, cv::Mat R2, cv::Mat t2);
+	SE3 COMMON_API CalRelRotAndTranslation(const SE3& pose1, const SE3& pose2);
 
 	//! Input a series of camera matrices and 2D points. The 2D points are all matched in order to relate to some 3D points.
 	//	Output the estimation of 3D points and estimation error.
 	ERROR_CODE COMMON_API triangulate(const std::vector<std::pair<cv::Mat, cv::Mat>>& camera_matrices_and_2d_points,
 									  cv::Mat& points3d,
 									  double* error = NULL);
+	ERROR_CODE COMMON_API triangulate(const std::pair<cv::Mat, cv::Mat>* camera_matrices_and_2d_points,
+									  int num_views,
+									  cv::Mat& points3d,
+									  double* error = NULL);
+
+	//! Triangulate a single point from two views with the linear method.
+	//	@return The point in homogeneous coordinates.
+	cv::Vec4d COMMON_API TriangulatePoint(const cv::Matx34d& P1, const cv::Matx34d& P2,
+										  const cv::Point2f& x1, const cv::Point2f& x2);
 }
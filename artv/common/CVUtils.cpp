@@ -45,20 +45,55 @@ namespace ar {
 			return AR_SUCCESS;
 	}
 
+	SharedFrameStream::SharedFrameStream(shared_ptr<FrameStream> source, double max_fps) :
+		source_(source),
+		refresh_interval_(chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1 / max_fps))) {}
+
+	ERROR_CODE SharedFrameStream::NextFrame(Mat& output_buf) {
+		lock_guard<mutex> lock(mutex_);
+		auto now = chrono::steady_clock::now();
+		if (!decoded_ || now - decoded_time_ >= refresh_interval_) {
+			// Decode into a new buffer, since readers may still hold the last frame.
+			Mat frame;
+			last_ret_ = source_->NextFrame(frame);
+			if (last_ret_ == AR_SUCCESS)
+				frame_ = frame;
+			decoded_ = true;
+			decoded_time_ = now;
+		}
+		output_buf = frame_;
+		return last_ret_;
+	}
+
 	void InterestPointsTracker::GenKeypointsDesc(const Mat& frame,
 												 vector<KeyPoint>& keypoints,
 												 Mat& descriptors) {
 		detector_->detectAndCompute(frame, noArray(), keypoints, descriptors);
 	}
 
+	void InterestPointsTracker::GenKeypointsDesc(const FramePyramid& pyramid,
+												 vector<KeyPoint>& keypoints,
+												 Mat& descriptors) {
+		if (use_orb_extractor_)
+			orb_extractor_.Extract(pyramid, keypoints, descriptors);
+		else
+			GenKeypointsDesc(pyramid.Level(0), keypoints, descriptors);
+	}
+
 	std::vector<std::pair<int, int>> InterestPointsTracker::MatchKeypoints(const cv::Mat& descriptors1,
 																		   const cv::Mat& descriptors2) {
 		std::vector<std::pair<int, int>> matches;
-		vector<vector<DMatch>> dmatches;
+		MatchKeypoints(descriptors1, descriptors2, matches);
+		return matches;
+	}
+
+	void InterestPointsTracker::MatchKeypoints(const Mat& descriptors1,
+											   const Mat& descriptors2,
+											   vector<pair<int, int>>& matches) {
+		auto& dmatches = knn_matches_;
 		matcher_->knnMatch(descriptors1, descriptors2, dmatches, 2);
 		for (unsigned i = 0; i < dmatches.size(); i++)
-			if (dmatches[i][0].distance < NN_MATCH_RATIO * dmatches[i][1].distance)
+			if (dmatches[i].size() > 1 && dmatches[i][0].distance < nn_match_ratio_ * dmatches[i][1].distance)
 				matches.push_back({ dmatches[i][0].queryIdx, dmatches[i][0].trainIdx });
-		return matches;
 	}
 }
\ No newline at end of file
@@ -12,11 +12,15 @@
 #include <vector>
 #include <string>
 #include <chrono>
+#include <memory>
+#include <mutex>
 #include <opencv2/opencv.hpp>
 #include <opencv2/videoio.hpp>
 #include <opencv2/features2d.hpp>
 
 #include <common/ErrorCodes.h>
+#include <common/FramePyramid.h>
+#include <common/OrbExtractor.h>
 
 #ifdef _WIN32
 #ifdef COMMON_EXPORTS
@@ -50,6 +54,23 @@ namespace ar
 		ERROR_CODE NextFrame(cv::Mat& outputBuf);
 	};
 
+	//! The class SharedFrameStream lets many readers share the decoding of one stream.
+	//	A decoded frame is handed to every reader until it gets older than the refresh
+	//	interval, so the source is decoded at most once per interval however many
+	//	sessions show it. Readers must not write into the frames they get.
+	class COMMON_API SharedFrameStream : public FrameStream {
+		std::shared_ptr<FrameStream> source_;
+		std::chrono::steady_clock::duration refresh_interval_;
+		std::mutex mutex_;
+		bool decoded_ = false;
+		std::chrono::steady_clock::time_point decoded_time_;
+		cv::Mat frame_;
+		ERROR_CODE last_ret_ = AR_UNINITIALIZED;
+	public:
+		SharedFrameStream(std::shared_ptr<FrameStream> source, double max_fps = 30);
+		ERROR_CODE NextFrame(cv::Mat& outputBuf);
+	};
+
 	class COMMON_API InterestPointsTracker
 	{
 	public:
@@ -61,22 +82,46 @@ namespace ar
 		};
 
 		InterestPointsTracker(cv::Ptr<cv::Feature2D> detector,
-							  cv::Ptr<cv::DescriptorMatcher>& matcher) :
+							  cv::Ptr<cv::DescriptorMatcher> matcher) :
 			detector_(detector),
 			matcher_(matcher)
 		{}
 
+		inline void SetDetector(cv::Ptr<cv::Feature2D> detector) { detector_ = detector; }
+		inline void SetMatcher(cv::Ptr<cv::DescriptorMatcher> matcher) { matcher_ = matcher; }
+		inline void SetMatchRatio(double nn_match_ratio) { nn_match_ratio_ = nn_match_ratio; }
+		inline void SetRansacThresh(double ransac_thresh) { ransac_thresh_ = ransac_thresh; }
+		//! Extract the keypoints of pyramids with the parallel ORB extractor instead of the detector.
+		inline void UseOrbExtractor(bool enabled, const OrbOptions& options = OrbOptions()) {
+			use_orb_extractor_ = enabled;
+			if (enabled)
+				orb_extractor_.SetOptions(options);
+		}
+		inline void SetWorkerPool(WorkerPool* pool) { orb_extractor_.SetWorkerPool(pool); }
+
 		void GenKeypointsDesc(const cv::Mat& frame, 
 							  std::vector<cv::KeyPoint>& keypoints,
 							  cv::Mat& descriptors);
+		//! Same as above, but on a pyramid built already. The ORB extractor, if used, reuses
+		//	its buffers across frames. The detector runs on level 0 otherwise.
+		void GenKeypointsDesc(const FramePyramid& pyramid,
+							  std::vector<cv::KeyPoint>& keypoints,
+							  cv::Mat& descriptors);
 		std::vector<std::pair<int, int>> MatchKeypoints(const cv::Mat& descriptors1,
 														const cv::Mat& descriptors2);
+		//! Same as above, but appends to the given vector, so that its capacity can be reused.
+		void MatchKeypoints(const cv::Mat& descriptors1,
+							const cv::Mat& descriptors2,
+							std::vector<std::pair<int, int>>& matches);
 	protected:
-		const double RANSAC_THRESH = 2.5f; // RANSAC inlier threshold
-		const double NN_MATCH_RATIO = 0.8f; // Nearest-neighbour matching ratio
+		double ransac_thresh_ = 2.5; // RANSAC inlier threshold
+		double nn_match_ratio_ = 0.8; // Nearest-neighbour matching ratio
 		const int STATS_UPDATE_PERIOD = 10; // On-screen statistics are updated every 10 frames
 		cv::Ptr<cv::Feature2D> detector_;
 		cv::Ptr<cv::DescriptorMatcher> matcher_;
+		bool use_orb_extractor_ = false;
+		OrbExtractor orb_extractor_;
+		std::vector<std::vector<cv::DMatch>> knn_matches_;
 	};
 }
 
@@ -0,0 +1,211 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+
+#include <common/CameraModel.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar
+{
+	CameraModel::CameraModel(const Matx33d& K,
+							 Size image_size,
+							 DistortionModel model,
+							 const vector<double>& coeffs) :
+		K_(K), K_inv_(K.inv()), image_size_(image_size), model_(model), coeffs_(coeffs) {
+		// Missing coefficients are zeros.
+		coeffs_.resize(model_ == DISTORTION_RADTAN ? 5 : model_ == DISTORTION_FISHEYE ? 4 : 0, 0);
+		if (HasDistortion())
+			BuildLUT();
+	}
+
+	ERROR_CODE CameraModel::Load(const string& path, CameraModel& camera) {
+		FileStorage fs(path, FileStorage::READ);
+		if (!fs.isOpened())
+			return AR_FILE_NOT_FOUND;
+		return Read(fs.root(), camera);
+	}
+
+	ERROR_CODE CameraModel::Read(const FileNode& node, CameraModel& camera) {
+		Mat K, coeffs;
+		int width = 0, height = 0;
+		string model_name;
+		node["camera_matrix"] >> K;
+		node["distortion_coefficients"] >> coeffs;
+		node["image_width"] >> width;
+		node["image_height"] >> height;
+		node["distortion_model"] >> model_name;
+		if (K.rows != 3 || K.cols != 3 || width < 0 || height < 0)
+			return AR_INVALID_INPUT;
+
+		DistortionModel model;
+		if (model_name == "none" || (model_name.empty() && coeffs.empty()))
+			model = DISTORTION_NONE;
+		else if (model_name == "fisheye")
+			model = DISTORTION_FISHEYE;
+		else if (model_name == "radtan" || model_name.empty())
+			model = DISTORTION_RADTAN;
+		else
+			return AR_INVALID_INPUT;
+		// The lookup table of a distortion model covers the image.
+		if (model != DISTORTION_NONE && (width == 0 || height == 0))
+			return AR_INVALID_INPUT;
+		vector<double> coeff_vec;
+		if (!coeffs.empty())
+			coeffs.reshape(1, 1).convertTo(coeff_vec, CV_64F);
+		camera = CameraModel(Matx33d(K), Size(width, height), model, coeff_vec);
+		return AR_SUCCESS;
+	}
+
+	ERROR_CODE CameraModel::Save(const string& path) const {
+		FileStorage fs(path, FileStorage::WRITE);
+		if (!fs.isOpened())
+			return AR_FILE_NOT_FOUND;
+		Write(fs);
+		return AR_SUCCESS;
+	}
+
+	void CameraModel::Write(FileStorage& fs) const {
+		const char* model_names[] = { "none", "radtan", "fisheye" };
+		fs << "image_width" << image_size_.width;
+		fs << "image_height" << image_size_.height;
+		fs << "camera_matrix" << Mat(K_);
+		fs << "distortion_model" << model_names[model_];
+		fs << "distortion_coefficients" << Mat(coeffs_);
+	}
+
+	Point2d CameraModel::DistortNormalized(const Point2d& pt) const {
+		const double* k = coeffs_.data();
+		double x = pt.x, y = pt.y;
+		double r2 = x * x + y * y;
+		switch (model_) {
+		case DISTORTION_RADTAN: {
+			double radial = 1 + r2 * (k[0] + r2 * (k[1] + r2 * k[4]));
+			return Point2d(x * radial + 2 * k[2] * x * y + k[3] * (r2 + 2 * x * x),
+						   y * radial + k[2] * (r2 + 2 * y * y) + 2 * k[3] * x * y);
+		}
+		case DISTORTION_FISHEYE: {
+			double r = sqrt(r2);
+			if (r < 1e-8)
+				return pt;
+			double theta = atan(r);
+			double theta2 = theta * theta;
+			double theta_d = theta * (1 + theta2 * (k[0] + theta2 * (k[1] + theta2 * (k[2] + theta2 * k[3]))));
+			return pt * (theta_d / r);
+		}
+		case DISTORTION_NONE:
+		default:
+			return pt;
+		}
+	}
+
+	Point2f CameraModel::DistortPixel(const Point2f& pt) const {
+		if (!HasDistortion())
+			return pt;
+		Vec3d n = K_inv_ * Vec3d(pt.x, pt.y, 1);
+		Point2d d = DistortNormalized(Point2d(n[0] / n[2], n[1] / n[2]));
+		Vec3d p = K_ * Vec3d(d.x, d.y, 1);
+		return Point2f(float(p[0] / p[2]), float(p[1] / p[2]));
+	}
+
+	Point2f CameraModel::UndistortPixelExact(const Point2f& pt) const {
+		if (!HasDistortion())
+			return pt;
+		const int NUM_ITERATIONS = 20;
+		const double* k = coeffs_.data();
+		Vec3d n = K_inv_ * Vec3d(pt.x, pt.y, 1);
+		double xd = n[0] / n[2], yd = n[1] / n[2];
+		double x = xd, y = yd;
+		if (model_ == DISTORTION_RADTAN) {
+			// Fixed-point iterations, as in cv::undistortPoints.
+			for (int i = 0; i < NUM_ITERATIONS; ++i) {
+				double r2 = x * x + y * y;
+				double inv_radial = 1 / (1 + r2 * (k[0] + r2 * (k[1] + r2 * k[4])));
+				double dx = 2 * k[2] * x * y + k[3] * (r2 + 2 * x * x);
+				double dy = k[2] * (r2 + 2 * y * y) + 2 * k[3] * x * y;
+				x = (xd - dx) * inv_radial;
+				y = (yd - dy) * inv_radial;
+			}
+		}
+		else {
+			// Solve theta * (1 + k1 theta^2 + ...) = theta_d by Newton's method.
+			double theta_d = sqrt(xd * xd + yd * yd);
+			if (theta_d > 1e-8) {
+				double theta = min(theta_d, CV_PI / 2);
+				for (int i = 0; i < NUM_ITERATIONS; ++i) {
+					double t2 = theta * theta;
+					double f = theta * (1 + t2 * (k[0] + t2 * (k[1] + t2 * (k[2] + t2 * k[3])))) - theta_d;
+					double df = 1 + t2 * (3 * k[0] + t2 * (5 * k[1] + t2 * (7 * k[2] + t2 * 9 * k[3])));
+					if (abs(df) < 1e-12)
+						break;
+					theta = min(max(theta - f / df, 0.0), CV_PI / 2 - 1e-6);
+				}
+				double scale = tan(theta) / theta_d;
+				x = xd * scale;
+				y = yd * scale;
+			}
+		}
+		Vec3d p = K_ * Vec3d(x, y, 1);
+		return Point2f(float(p[0] / p[2]), float(p[1] / p[2]));
+	}
+
+	void CameraModel::BuildLUT() {
+		lut_cols_ = image_size_.width / LUT_STEP + 2;
+		lut_rows_ = image_size_.height / LUT_STEP + 2;
+		lut_.resize(lut_cols_ * lut_rows_);
+		for (int j = 0; j < lut_rows_; ++j)
+			for (int i = 0; i < lut_cols_; ++i)
+				lut_[j * lut_cols_ + i] = UndistortPixelExact(Point2f(float(i * LUT_STEP), float(j * LUT_STEP)));
+	}
+
+	Point2f CameraModel::UndistortPixel(const Point2f& pt) const {
+		if (!HasDistortion())
+			return pt;
+		if (lut_.empty())
+			return UndistortPixelExact(pt);
+		float fx = min(max(pt.x, 0.f), float((lut_cols_ - 1) * LUT_STEP)) / LUT_STEP;
+		float fy = min(max(pt.y, 0.f), float((lut_rows_ - 1) * LUT_STEP)) / LUT_STEP;
+		int i = min(int(fx), lut_cols_ - 2);
+		int j = min(int(fy), lut_rows_ - 2);
+		float ax = fx - i, ay = fy - j;
+		const Point2f* node = &lut_[j * lut_cols_ + i];
+		Point2f top = node[0] * (1 - ax) + node[1] * ax;
+		Point2f bottom = node[lut_cols_] * (1 - ax) + node[lut_cols_ + 1] * ax;
+		return top * (1 - ay) + bottom * ay;
+	}
+
+	void CameraModel::UndistortPoints(Point2f* pts, int num_pts) const {
+		if (!HasDistortion())
+			return;
+		for (int i = 0; i < num_pts; ++i)
+			pts[i] = UndistortPixel(pts[i]);
+	}
+
+	Rect CameraModel::DistortedBounds(const vector<Point2f>& outline) const {
+		if (!HasDistortion() || outline.empty())
+			return boundingRect(outline);
+		// Straight edges bend under distortion, so points along them are taken too.
+		const int SAMPLES_PER_EDGE = 8;
+		float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
+		for (int e = 0; e < outline.size(); ++e) {
+			const Point2f& a = outline[e];
+			const Point2f& b = outline[(e + 1) % outline.size()];
+			for (int s = 0; s < SAMPLES_PER_EDGE; ++s) {
+				Point2f p = DistortPixel(a + (b - a) * (float(s) / SAMPLES_PER_EDGE));
+				min_x = min(min_x, p.x);
+				min_y = min(min_y, p.y);
+				max_x = max(max_x, p.x);
+				max_y = max(max_y, p.y);
+			}
+		}
+		return Rect(Point(cvFloor(min_x), cvFloor(min_y)), Point(cvFloor(max_x) + 1, cvFloor(max_y) + 1));
+	}
+}
@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef CAMERAMODEL_H
+#define CAMERAMODEL_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <common/ErrorCodes.h>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	enum DistortionModel {
+		DISTORTION_NONE,
+		//! Radial-tangential distortion with the coefficients k1, k2, p1, p2[, k3], as in
+		//	the calibration of OpenCV.
+		DISTORTION_RADTAN,
+		//! Equidistant fisheye distortion with the coefficients k1, k2, k3, k4, as in the
+		//	fisheye calibration of OpenCV.
+		DISTORTION_FISHEYE
+	};
+
+	//! The class CameraModel describes how a camera maps the world onto its images: the
+	//	camera matrix and the lens distortion. Tracking works on undistorted pixels, the
+	//	ones an ideal pinhole camera with the same matrix would see. Instead of remapping
+	//	whole frames, only the keypoints are undistorted, through a lookup table computed
+	//	once for the image size and interpolated bilinearly.
+	class COMMON_API CameraModel {
+	public:
+		//! Spacing of the lookup table nodes in pixels.
+		static const int LUT_STEP = 8;
+
+		CameraModel() {}
+		//! @param coeffs Distortion coefficients in the order of the model.
+		CameraModel(const cv::Matx33d& K,
+					cv::Size image_size,
+					DistortionModel model = DISTORTION_NONE,
+					const std::vector<double>& coeffs = std::vector<double>());
+
+		//! Load a calibration saved by OpenCV's calibration sample: camera_matrix,
+		//	distortion_coefficients, image_width and image_height, and optionally
+		//	distortion_model as "none", "radtan" or "fisheye" (radtan by default).
+		static ERROR_CODE Load(const std::string& path, CameraModel& camera);
+		ERROR_CODE Save(const std::string& path) const;
+		//! Read a calibration in the layout of Load from a node of a file storage.
+		static ERROR_CODE Read(const cv::FileNode& node, CameraModel& camera);
+		void Write(cv::FileStorage& fs) const;
+
+		inline bool IsValid() const { return K_(2, 2) != 0; }
+		inline bool HasDistortion() const { return model_ != DISTORTION_NONE; }
+		inline const cv::Matx33d& K() const { return K_; }
+		inline cv::Size GetImageSize() const { return image_size_; }
+		inline DistortionModel GetModel() const { return model_; }
+		inline const std::vector<double>& GetCoeffs() const { return coeffs_; }
+
+		//! Map a point on the normalized image plane to where the lens puts it.
+		cv::Point2d DistortNormalized(const cv::Point2d& pt) const;
+		//! Map an undistorted pixel to the pixel of the image.
+		cv::Point2f DistortPixel(const cv::Point2f& pt) const;
+		//! Map a pixel of the image to the undistorted pixel by iterations. Exact but slow.
+		cv::Point2f UndistortPixelExact(const cv::Point2f& pt) const;
+		//! Map a pixel of the image to the undistorted pixel through the lookup table.
+		//	Pixels off the image are clamped to its border.
+		cv::Point2f UndistortPixel(const cv::Point2f& pt) const;
+		//! Undistort points in place through the lookup table.
+		void UndistortPoints(cv::Point2f* pts, int num_pts) const;
+		//! Bounding box in the image of a convex outline given in undistorted pixels.
+		cv::Rect DistortedBounds(const std::vector<cv::Point2f>& outline) const;
+
+	private:
+		cv::Matx33d K_ = cv::Matx33d::zeros();
+		cv::Matx33d K_inv_ = cv::Matx33d::zeros();
+		cv::Size image_size_;
+		DistortionModel model_ = DISTORTION_NONE;
+		std::vector<double> coeffs_;
+		//! Undistorted pixels at the nodes of a grid over the image, row by row.
+		std::vector<cv::Point2f> lut_;
+		int lut_cols_ = 0;
+		int lut_rows_ = 0;
+
+		void BuildLUT();
+	};
+}
+
+#endif // !CAMERAMODEL_H
@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <cstring>
+
+#include <common/DescriptorPool.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	int DescriptorPool::Add(const Mat& desc) {
+		CV_Assert(desc.rows == 1 && desc.depth() == CV_8U && desc.isContinuous());
+		int bytes = int(desc.total() * desc.elemSize());
+		lock_guard<mutex> lock(mutex_);
+		if (!desc_bytes_)
+			desc_bytes_ = bytes;
+		CV_Assert(bytes == desc_bytes_);
+
+		int slot;
+		if (!free_slots_.empty()) {
+			slot = free_slots_.back();
+			free_slots_.pop_back();
+		}
+		else {
+			slot = num_slots_++;
+			// Chunks never move, so headers given out stay valid while the pool grows.
+			if (slot / CHUNK_SLOTS == chunks_.size())
+				chunks_.emplace_back(new uchar[CHUNK_SLOTS * desc_bytes_]);
+		}
+		memcpy(&chunks_[slot / CHUNK_SLOTS][(slot % CHUNK_SLOTS) * desc_bytes_], desc.data, desc_bytes_);
+		return slot;
+	}
+
+	void DescriptorPool::Release(int slot) {
+		lock_guard<mutex> lock(mutex_);
+		free_slots_.push_back(slot);
+	}
+
+	Mat DescriptorPool::Get(int slot) const {
+		lock_guard<mutex> lock(mutex_);
+		return Mat(1, desc_bytes_, CV_8U, &chunks_[slot / CHUNK_SLOTS][(slot % CHUNK_SLOTS) * desc_bytes_]);
+	}
+
+	int DescriptorPool::Size() const {
+		lock_guard<mutex> lock(mutex_);
+		return num_slots_ - int(free_slots_.size());
+	}
+
+	size_t DescriptorPool::Bytes() const {
+		lock_guard<mutex> lock(mutex_);
+		return chunks_.size() * CHUNK_SLOTS * desc_bytes_;
+	}
+}
@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef DESCRIPTORPOOL_H
+#define DESCRIPTORPOOL_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	//! The class DescriptorPool stores fixed-size binary descriptors in shared chunks,
+	//	so that keeping a descriptor costs its bytes only, without a Mat and a heap
+	//	buffer of its own. Slots are recycled after being released.
+	class COMMON_API DescriptorPool {
+		static const int CHUNK_SLOTS = 1024;
+		mutable std::mutex mutex_;
+		//! Size of a descriptor in bytes. Fixed by the first descriptor added.
+		int desc_bytes_ = 0;
+		std::vector<std::unique_ptr<uchar[]>> chunks_;
+		int num_slots_ = 0;
+		std::vector<int> free_slots_;
+	public:
+		//! Store a descriptor row of type CV_8U.
+		//	@return The slot of the stored descriptor.
+		int Add(const cv::Mat& desc);
+		void Release(int slot);
+		//! A 1-row header onto a stored descriptor. It stays valid until the slot is released.
+		cv::Mat Get(int slot) const;
+		//! Number of descriptors in the pool.
+		int Size() const;
+		//! Bytes of the chunks allocated, including the free slots.
+		size_t Bytes() const;
+	};
+}
+
+#endif // !DESCRIPTORPOOL_H
@@ -15,6 +15,7 @@
 #define AR_NO_MORE_FRAMES	-3
 #define AR_INVALID_INPUT    -4
 #define AR_UNIMPLEMENTED    -5
+#define AR_FRAME_DROPPED    -6
 
 namespace ar {
 	typedef int ERROR_CODE;
@@ -22,14 +23,20 @@ namespace ar {
 	inline const char* ErrCode2Msg(ERROR_CODE errorCode) {
 		switch (errorCode)
 		{
-		case 0:
+		case AR_SUCCESS:
 			return "Success.";
-		case 1:
+		case AR_FILE_NOT_FOUND:
 			return "File not found.";
-		case 2:
+		case AR_UNINITIALIZED:
 			return "Instance not initialized.";
-		case 3:
+		case AR_NO_MORE_FRAMES:
 			return "No more frames.";
+		case AR_INVALID_INPUT:
+			return "Invalid input.";
+		case AR_UNIMPLEMENTED:
+			return "Not implemented.";
+		case AR_FRAME_DROPPED:
+			return "Frame dropped.";
 		default:
 			return "Unknown error.";
 		}
@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <cstdlib>
+#include <new>
+
+#include <common/FrameArena.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	//! Mat buffers are aligned to cache lines, which also suits any SIMD width.
+	static const size_t MAT_ALIGNMENT = 64;
+
+	UMatData* ArenaMatAllocator::allocate(int dims, const int* sizes, int type,
+										  void* data0, size_t* step, int /*flags*/, UMatUsageFlags /*usageFlags*/) const {
+		// Same layout as the standard allocator of OpenCV.
+		size_t total = CV_ELEM_SIZE(type);
+		for (int i = dims - 1; i >= 0; --i) {
+			if (step) {
+				if (data0 && step[i] != CV_AUTOSTEP) {
+					CV_Assert(total <= step[i]);
+					total = step[i];
+				}
+				else
+					step[i] = total;
+			}
+			total *= sizes[i];
+		}
+		uchar* data = data0 ? (uchar*)data0 : (uchar*)arena_.Allocate(total, MAT_ALIGNMENT);
+		UMatData* u = new (arena_.Allocate(sizeof(UMatData), alignof(UMatData))) UMatData(this);
+		u->data = u->origdata = data;
+		u->size = total;
+		if (data0)
+			u->flags |= UMatData::USER_ALLOCATED;
+		++live_cnt_;
+		return u;
+	}
+
+	bool ArenaMatAllocator::allocate(UMatData* u, int /*accessflags*/, UMatUsageFlags /*usageFlags*/) const {
+		return u != NULL;
+	}
+
+	void ArenaMatAllocator::deallocate(UMatData* u) const {
+		if (!u)
+			return;
+		CV_Assert(u->urefcount == 0 && u->refcount == 0);
+		// The memory goes back to the arena on reset.
+		u->~UMatData();
+		--live_cnt_;
+	}
+
+	FrameArena::FrameArena(size_t initial_capacity) : mat_allocator_(*this) {
+		blocks_.reserve(16);
+		AddBlock(initial_capacity);
+	}
+
+	FrameArena::~FrameArena() {
+		for (auto& block : blocks_)
+			free(block.data);
+	}
+
+	void FrameArena::AddBlock(size_t size) {
+		blocks_.push_back({ (char*)malloc(size), size });
+		if (!blocks_.back().data) {
+			blocks_.pop_back();
+			throw bad_alloc();
+		}
+		++heap_allocations_;
+	}
+
+	void* FrameArena::Allocate(size_t size, size_t alignment) {
+		for (;;) {
+			Block& block = blocks_[block_ind_];
+			size_t start = (size_t(block.data) + offset_ + alignment - 1) & ~(alignment - 1);
+			size_t end = start + size - size_t(block.data);
+			if (end <= block.size) {
+				used_ += end - offset_;
+				offset_ = end;
+				return (void*)start;
+			}
+			if (++block_ind_ == blocks_.size())
+				AddBlock(max(block.size * 2, size + alignment));
+			offset_ = 0;
+		}
+	}
+
+	Mat FrameArena::NewMat(int rows, int cols, int type) {
+		Mat m;
+		m.allocator = &mat_allocator_;
+		m.create(rows, cols, type);
+		return m;
+	}
+
+	void FrameArena::Reset() {
+		// A Mat still alive would share its buffer with the next frame.
+		CV_Assert(mat_allocator_.live_cnt_ == 0);
+		if (blocks_.size() > 1) {
+			// Merge the blocks, so that one block covers a frame like the last one.
+			size_t capacity = Capacity();
+			for (auto& block : blocks_)
+				free(block.data);
+			blocks_.clear();
+			AddBlock(capacity);
+		}
+		block_ind_ = 0;
+		offset_ = 0;
+		used_ = 0;
+	}
+
+	size_t FrameArena::Capacity() const {
+		size_t capacity = 0;
+		for (auto& block : blocks_)
+			capacity += block.size;
+		return capacity;
+	}
+}
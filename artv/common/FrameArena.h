@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	class FrameArena;
+
+	//! A cv::MatAllocator that takes the buffers of Mats from a FrameArena. Buffers are
+	//	only given back when the arena is reset, so such Mats must not outlive the frame.
+	class COMMON_API ArenaMatAllocator : public cv::MatAllocator {
+		FrameArena& arena_;
+	public:
+		//! Number of Mat buffers not yet released. Should be zero when the arena is reset.
+		mutable int live_cnt_ = 0;
+		ArenaMatAllocator(FrameArena& arena) : arena_(arena) {}
+		cv::UMatData* allocate(int dims, const int* sizes, int type,
+							   void* data, size_t* step, int flags, cv::UMatUsageFlags usageFlags) const;
+		bool allocate(cv::UMatData* data, int accessflags, cv::UMatUsageFlags usageFlags) const;
+		void deallocate(cv::UMatData* data) const;
+	};
+
+	//! The class FrameArena is a bump allocator for the short-lived buffers of a frame.
+	//	Allocation is a pointer increment, and everything is released at once by Reset.
+	//	It is not thread-safe: every thread processing frames should have its own arena.
+	class COMMON_API FrameArena {
+		struct Block {
+			char* data;
+			size_t size;
+		};
+		std::vector<Block> blocks_;
+		size_t block_ind_ = 0;
+		size_t offset_ = 0;
+		//! Bytes requested since the last reset, including alignment padding.
+		size_t used_ = 0;
+		size_t heap_allocations_ = 0;
+		ArenaMatAllocator mat_allocator_;
+
+		void AddBlock(size_t size);
+	public:
+		FrameArena(size_t initial_capacity = 1 << 20);
+		~FrameArena();
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+		template<class T>
+		inline T* AllocateArray(size_t n) { return static_cast<T*>(Allocate(sizeof(T) * n, alignof(T))); }
+		//! Create a Mat whose buffer lives in the arena.
+		cv::Mat NewMat(int rows, int cols, int type);
+
+		//! Release everything allocated since the last reset. No Mat created from the
+		//	arena may be alive by then, which is asserted in all builds. If the frame did not fit
+		//	into one block, the blocks are merged into a single block large enough for it,
+		//	so a steady workload stops calling the global heap after a few frames.
+		void Reset();
+
+		inline cv::MatAllocator* GetMatAllocator() { return &mat_allocator_; }
+		inline size_t Used() const { return used_; }
+		size_t Capacity() const;
+		//! Number of blocks ever taken from the global heap.
+		inline size_t HeapAllocations() const { return heap_allocations_; }
+	};
+
+	//! STL allocator drawing from a FrameArena. Deallocation is a no-op.
+	template<class T>
+	class ArenaAllocator {
+	public:
+		typedef T value_type;
+		FrameArena* arena_;
+		ArenaAllocator(FrameArena& arena) : arena_(&arena) {}
+		template<class U>
+		ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena_) {}
+		inline T* allocate(size_t n) { return arena_->AllocateArray<T>(n); }
+		inline void deallocate(T*, size_t) {}
+		template<class U>
+		inline bool operator==(const ArenaAllocator<U>& other) const { return arena_ == other.arena_; }
+		template<class U>
+		inline bool operator!=(const ArenaAllocator<U>& other) const { return arena_ != other.arena_; }
+	};
+
+	//! A vector whose storage lives in a FrameArena.
+	template<class T>
+	using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}
+
+#endif // !FRAMEARENA_H
@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+
+#include <common/FramePipeline.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar
+{
+	FramePool::FramePool(int num_frames) {
+		for (int i = 0; i < num_frames; ++i) {
+			frames_.emplace_back(new PooledFrame);
+			free_.push_back(frames_.back().get());
+		}
+	}
+
+	FramePool::~FramePool() {
+		Close();
+	}
+
+	FrameRef FramePool::Acquire(cv::Size size, int type, Backpressure pressure) {
+		unique_lock<mutex> lock(mutex_);
+		if (pressure == BACKPRESSURE_BLOCK)
+			free_cond_.wait(lock, [this] { return closed_ || !free_.empty(); });
+		if (closed_ || free_.empty())
+			return FrameRef();
+		PooledFrame* frame = free_.back();
+		free_.pop_back();
+		lock.unlock();
+
+		// Reallocates only if the size or the type changed.
+		frame->image.create(size, type);
+		return FrameRef(frame, [this](PooledFrame* frame) { Release(frame); });
+	}
+
+	void FramePool::Release(PooledFrame* frame) {
+		{
+			lock_guard<mutex> lock(mutex_);
+			free_.push_back(frame);
+		}
+		free_cond_.notify_one();
+	}
+
+	void FramePool::Close() {
+		{
+			lock_guard<mutex> lock(mutex_);
+			closed_ = true;
+		}
+		free_cond_.notify_all();
+	}
+
+	void FramePool::Reopen() {
+		lock_guard<mutex> lock(mutex_);
+		closed_ = false;
+	}
+
+	AsyncCapture::AsyncCapture(const AsyncCaptureOptions& options) :
+		options_(options), pool_(options.queue_size + 2), queue_(options.queue_size) {}
+
+	AsyncCapture::~AsyncCapture() {
+		Close();
+	}
+
+	ERROR_CODE AsyncCapture::Open(const string& path) {
+		Close();
+		cap_.open(path);
+		if (!cap_.isOpened())
+			return AR_FILE_NOT_FOUND;
+		fps_ = cap_.get(CAP_PROP_FPS);
+		frame_size_ = Size(int(cap_.get(CAP_PROP_FRAME_WIDTH)), int(cap_.get(CAP_PROP_FRAME_HEIGHT)));
+		pool_.Reopen();
+		queue_.Reset();
+		stopping_ = false;
+		decoder_ = thread(&AsyncCapture::DecodeLoop, this);
+		return AR_SUCCESS;
+	}
+
+	void AsyncCapture::Close() {
+		if (!decoder_.joinable())
+			return;
+		stopping_ = true;
+		queue_.Close();
+		pool_.Close();
+		decoder_.join();
+		cap_.release();
+	}
+
+	ERROR_CODE AsyncCapture::Read(FrameRef& frame) {
+		frame.reset();
+		if (!decoder_.joinable())
+			return AR_UNINITIALIZED;
+		return queue_.Pop(frame) ? AR_SUCCESS : AR_NO_MORE_FRAMES;
+	}
+
+	void AsyncCapture::DecodeLoop() {
+		int index = 0;
+		while (!stopping_) {
+			// The frame is acquired before decoding, so a slow consumer holds the decoder
+			// back instead of piling decoded frames up.
+			FrameRef frame = pool_.Acquire(frame_size_, CV_8UC3);
+			if (!frame)
+				break;
+			// Most backends decode into the buffer given if its size and type fit.
+			if (!cap_.read(frame->image) || frame->image.empty())
+				break;
+			frame->index = index++;
+			frame->time = chrono::steady_clock::now();
+			if (!queue_.Push(move(frame), options_.pressure))
+				break;
+		}
+		queue_.Close();
+	}
+
+	AsyncEncoder::AsyncEncoder(const AsyncEncoderOptions& options) :
+		options_(options), pool_(options.queue_size + 2), queue_(options.queue_size) {}
+
+	AsyncEncoder::~AsyncEncoder() {
+		Close();
+	}
+
+	ERROR_CODE AsyncEncoder::Open(const string& path, int fourcc, double input_fps, Size input_size) {
+		Close();
+		if (input_fps <= 0 || input_size.area() <= 0)
+			return AR_INVALID_INPUT;
+		input_fps_ = input_fps;
+		output_size_ = options_.output_size.area() > 0 ? options_.output_size : input_size;
+		double output_fps = options_.output_fps > 0 ? min(options_.output_fps, input_fps) : input_fps;
+		if (!writer_.open(path, fourcc, output_fps, output_size_))
+			return AR_FILE_NOT_FOUND;
+		frame_cnt_ = 0;
+		pool_dropped_ = 0;
+		pool_.Reopen();
+		queue_.Reset();
+		encoder_ = thread(&AsyncEncoder::EncodeLoop, this);
+		return AR_SUCCESS;
+	}
+
+	void AsyncEncoder::Close() {
+		if (!encoder_.joinable())
+			return;
+		// The frames queued are still encoded.
+		queue_.Close();
+		encoder_.join();
+		writer_.release();
+	}
+
+	ERROR_CODE AsyncEncoder::Write(const Mat& frame) {
+		if (!encoder_.joinable())
+			return AR_UNINITIALIZED;
+		int index = frame_cnt_++;
+		if (options_.output_fps > 0 && options_.output_fps < input_fps_) {
+			// Keep a frame whenever the output clock ticks between it and the previous one.
+			double rate = options_.output_fps / input_fps_;
+			if (index > 0 && floor(index * rate) == floor((index - 1) * rate))
+				return AR_SUCCESS;
+		}
+
+		FrameRef pooled = pool_.Acquire(frame.size(), frame.type(), options_.pressure);
+		if (!pooled) {
+			++pool_dropped_;
+			return AR_FRAME_DROPPED;
+		}
+		frame.copyTo(pooled->image);
+		pooled->index = index;
+		pooled->time = chrono::steady_clock::now();
+		if (!queue_.Push(move(pooled), options_.pressure))
+			return AR_UNINITIALIZED;
+		return AR_SUCCESS;
+	}
+
+	void AsyncEncoder::EncodeLoop() {
+		FrameRef frame;
+		while (queue_.Pop(frame)) {
+			if (frame->image.size() == output_size_)
+				writer_ << frame->image;
+			else {
+				resize(frame->image, resized_, output_size_, 0, 0, INTER_AREA);
+				writer_ << resized_;
+			}
+			frame.reset();
+		}
+	}
+}
@@ -0,0 +1,245 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <common/ErrorCodes.h>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	//! What a producer does when the next stage is full.
+	enum Backpressure {
+		//! Wait for room, so that no frame is lost.
+		BACKPRESSURE_BLOCK,
+		//! Drop the oldest frame waiting, so that the latency stays low.
+		BACKPRESSURE_DROP
+	};
+
+	struct PooledFrame {
+		cv::Mat image;
+		//! Index of the frame in its source.
+		int index = 0;
+		std::chrono::steady_clock::time_point time;
+	};
+	//! A frame is returned to its pool when the last reference to it is gone.
+	typedef std::shared_ptr<PooledFrame> FrameRef;
+
+	//! The class FramePool owns a fixed number of frame buffers and lends them out as
+	//	reference-counted frames. The buffers keep their memory between uses, so a
+	//	pipeline of frames of the same size stops allocating after warming up. The pool
+	//	must outlive the frames it lends.
+	class COMMON_API FramePool {
+	public:
+		FramePool(int num_frames);
+		~FramePool();
+		FramePool(const FramePool&) = delete;
+		FramePool& operator=(const FramePool&) = delete;
+
+		//! Get a free frame whose image has the size and type.
+		//	@return Null if no frame is free and the pressure is BACKPRESSURE_DROP, or the
+		//	pool is closed.
+		FrameRef Acquire(cv::Size size, int type, Backpressure pressure = BACKPRESSURE_BLOCK);
+		//! Wake up and fail the callers waiting in Acquire, now and until reopened.
+		void Close();
+		void Reopen();
+		inline int Size() const { return int(frames_.size()); }
+
+	private:
+		std::vector<std::unique_ptr<PooledFrame>> frames_;
+		std::vector<PooledFrame*> free_;
+		std::mutex mutex_;
+		std::condition_variable free_cond_;
+		bool closed_ = false;
+
+		void Release(PooledFrame* frame);
+	};
+
+	//! The class BoundedQueue passes items from producers to consumers. It holds at most
+	//	a fixed number of items, and a full queue either blocks the producer or drops its
+	//	oldest item.
+	template<class T>
+	class BoundedQueue {
+	public:
+		BoundedQueue(int capacity) : capacity_(capacity) {}
+
+		//! @return False if the queue is closed.
+		bool Push(T&& item, Backpressure pressure = BACKPRESSURE_BLOCK) {
+			std::unique_lock<std::mutex> lock(mutex_);
+			if (pressure == BACKPRESSURE_BLOCK)
+				not_full_.wait(lock, [this] { return closed_ || int(items_.size()) < capacity_; });
+			if (closed_)
+				return false;
+			if (int(items_.size()) >= capacity_) {
+				items_.pop_front();
+				++dropped_;
+			}
+			items_.push_back(std::move(item));
+			lock.unlock();
+			not_empty_.notify_one();
+			return true;
+		}
+
+		//! Wait for an item.
+		//	@return False if the queue is closed and empty.
+		bool Pop(T& item) {
+			std::unique_lock<std::mutex> lock(mutex_);
+			not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+			if (items_.empty())
+				return false;
+			item = std::move(items_.front());
+			items_.pop_front();
+			lock.unlock();
+			not_full_.notify_one();
+			return true;
+		}
+
+		//! Stop accepting items. The items queued can still be popped.
+		void Close() {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				closed_ = true;
+			}
+			not_empty_.notify_all();
+			not_full_.notify_all();
+		}
+
+		//! Drop the items queued and accept items again.
+		void Reset() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			items_.clear();
+			closed_ = false;
+			dropped_ = 0;
+		}
+
+		inline int Dropped() const {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return dropped_;
+		}
+
+	private:
+		const int capacity_;
+		std::deque<T> items_;
+		mutable std::mutex mutex_;
+		std::condition_variable not_empty_;
+		std::condition_variable not_full_;
+		bool closed_ = false;
+		int dropped_ = 0;
+	};
+
+	struct AsyncCaptureOptions {
+		//! Frames decoded ahead of the consumer.
+		int queue_size = 2;
+		//! BACKPRESSURE_DROP suits live sources, where the newest frame matters most.
+		//	BACKPRESSURE_BLOCK suits files, where every frame should be processed.
+		Backpressure pressure = BACKPRESSURE_BLOCK;
+	};
+
+	//! The class AsyncCapture decodes a video on a thread of its own, into the frames of
+	//	a pool, so that the consumer only waits for decoding when it is faster than it.
+	class COMMON_API AsyncCapture {
+	public:
+		AsyncCapture(const AsyncCaptureOptions& options = AsyncCaptureOptions());
+		~AsyncCapture();
+		AsyncCapture(const AsyncCapture&) = delete;
+		AsyncCapture& operator=(const AsyncCapture&) = delete;
+
+		ERROR_CODE Open(const std::string& path);
+		void Close();
+		//! Wait for the next frame. Hold the frame no longer than needed, as its buffer is
+		//	reused once released.
+		//	@return AR_NO_MORE_FRAMES at the end of the video.
+		ERROR_CODE Read(FrameRef& frame);
+
+		inline double GetFPS() const { return fps_; }
+		inline cv::Size GetFrameSize() const { return frame_size_; }
+		inline int Dropped() const { return queue_.Dropped(); }
+
+	private:
+		AsyncCaptureOptions options_;
+		cv::VideoCapture cap_;
+		double fps_ = 0;
+		cv::Size frame_size_;
+		//! Enough for the frames queued, the one being decoded and the one held by the consumer.
+		FramePool pool_;
+		BoundedQueue<FrameRef> queue_;
+		std::atomic<bool> stopping_{ false };
+		std::thread decoder_;
+
+		void DecodeLoop();
+	};
+
+	struct AsyncEncoderOptions {
+		//! Size of the encoded frames. Empty to keep the size of the input.
+		cv::Size output_size;
+		//! Frame rate of the encoded video. Zero to keep the rate of the input, otherwise
+		//	input frames are skipped to bring it down.
+		double output_fps = 0;
+		int queue_size = 4;
+		Backpressure pressure = BACKPRESSURE_BLOCK;
+	};
+
+	//! The class AsyncEncoder writes a video on a thread of its own. Frames are copied into
+	//	the buffers of a pool, and resized and encoded by that thread.
+	class COMMON_API AsyncEncoder {
+	public:
+		AsyncEncoder(const AsyncEncoderOptions& options = AsyncEncoderOptions());
+		//! Write the frames queued and close the file.
+		~AsyncEncoder();
+		AsyncEncoder(const AsyncEncoder&) = delete;
+		AsyncEncoder& operator=(const AsyncEncoder&) = delete;
+
+		//! @param input_fps Rate of the frames given to Write.
+		ERROR_CODE Open(const std::string& path, int fourcc, double input_fps, cv::Size input_size);
+		void Close();
+		//! Queue a frame, unless it is skipped to meet the output rate. The frame is copied.
+		//	@return AR_FRAME_DROPPED if the frame cannot be queued without blocking under
+		//	BACKPRESSURE_DROP.
+		ERROR_CODE Write(const cv::Mat& frame);
+
+		inline int Dropped() const { return queue_.Dropped() + pool_dropped_; }
+
+	private:
+		AsyncEncoderOptions options_;
+		cv::VideoWriter writer_;
+		double input_fps_ = 0;
+		cv::Size output_size_;
+		int frame_cnt_ = 0;
+		int pool_dropped_ = 0;
+		FramePool pool_;
+		BoundedQueue<FrameRef> queue_;
+		std::thread encoder_;
+		cv::Mat resized_;
+
+		void EncodeLoop();
+	};
+}
+
+#endif // !FRAMEPIPELINE_H
@@ -0,0 +1,133 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <common/FramePyramid.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	namespace {
+		//! BT.601 weights of blue, green and red with 8 fractional bits. They sum to 256,
+		//	so that the weighted sum of a pixel fits into 16 bits.
+		const int B_WEIGHT = 29;
+		const int G_WEIGHT = 150;
+		const int R_WEIGHT = 77;
+
+		inline uchar Gray(const uchar* bgr) {
+			return uchar((bgr[0] * B_WEIGHT + bgr[1] * G_WEIGHT + bgr[2] * R_WEIGHT + 128) >> 8);
+		}
+
+#if CV_SIMD128
+		//! Gray values of 16 BGR pixels.
+		inline v_uint8x16 Gray16(const uchar* bgr) {
+			v_uint8x16 b, g, r;
+			v_load_deinterleave(bgr, b, g, r);
+			v_uint16x8 b0, b1, g0, g1, r0, r1;
+			v_expand(b, b0, b1);
+			v_expand(g, g0, g1);
+			v_expand(r, r0, r1);
+			v_uint16x8 wb = v_setall_u16(B_WEIGHT), wg = v_setall_u16(G_WEIGHT), wr = v_setall_u16(R_WEIGHT);
+			v_uint16x8 round = v_setall_u16(128);
+			v_uint16x8 y0 = (b0 * wb + g0 * wg + r0 * wr + round) >> 8;
+			v_uint16x8 y1 = (b1 * wb + g1 * wg + r1 * wr + round) >> 8;
+			return v_pack(y0, y1);
+		}
+#endif
+	}
+
+	void BGR2GrayHalfRows(const uchar* bgr0, const uchar* bgr1,
+						  uchar* gray0, uchar* gray1, uchar* half, int width) {
+		int x = 0;
+#if CV_SIMD128
+		v_uint16x8 low_byte = v_setall_u16(0xFF), two = v_setall_u16(2);
+		for (; x <= width - 16; x += 16) {
+			v_uint8x16 y0 = Gray16(bgr0 + x * 3);
+			v_uint8x16 y1 = Gray16(bgr1 + x * 3);
+			v_store(gray0 + x, y0);
+			v_store(gray1 + x, y1);
+			// Viewed as 16-bit lanes, each lane holds a horizontal pair of pixels.
+			v_uint16x8 p0 = v_reinterpret_as_u16(y0), p1 = v_reinterpret_as_u16(y1);
+			v_uint16x8 sum = (p0 & low_byte) + (p0 >> 8) + (p1 & low_byte) + (p1 >> 8) + two;
+			v_uint16x8 avg = sum >> 2;
+			v_store_low(half + x / 2, v_pack(avg, avg));
+		}
+#endif
+		for (int i = x; i < width; ++i) {
+			gray0[i] = Gray(bgr0 + i * 3);
+			gray1[i] = Gray(bgr1 + i * 3);
+		}
+		for (int i = x / 2; i < width / 2; ++i)
+			half[i] = uchar((gray0[i * 2] + gray0[i * 2 + 1] + gray1[i * 2] + gray1[i * 2 + 1] + 2) >> 2);
+	}
+
+	FramePyramid::FramePyramid(int max_levels) :
+		max_levels_(max(2, max_levels)),
+		levels_(max_levels_),
+		edges_(max_levels_) {}
+
+	void FramePyramid::Build(const Mat& frame) {
+		CV_Assert(frame.depth() == CV_8U && (frame.channels() == 3 || frame.channels() == 1));
+		for (auto& cache : edges_)
+			cache.valid = false;
+		int width = frame.cols, height = frame.rows;
+		if (width < 2 || height < 2) {
+			levels_[0] = frame.channels() == 1 ? frame : Mat();
+			num_levels_ = levels_[0].empty() ? 0 : 1;
+			return;
+		}
+
+		Size half_size(width / 2, height / 2);
+		if (frame.channels() == 1) {
+			levels_[0] = frame;
+			resize(frame, levels_[1], half_size, 0, 0, INTER_AREA);
+		}
+		else {
+			// Convert and downsample in one pass, so the BGR frame is only read once.
+			gray_.create(frame.size(), CV_8UC1);
+			levels_[0] = gray_;
+			levels_[1].create(half_size, CV_8UC1);
+			Mat& gray = gray_;
+			Mat& half = levels_[1];
+			parallel_for_(Range(0, half_size.height), [&](const Range& range) {
+				for (int y = range.start; y < range.end; ++y)
+					BGR2GrayHalfRows(frame.ptr(y * 2), frame.ptr(y * 2 + 1),
+									 gray.ptr(y * 2), gray.ptr(y * 2 + 1), half.ptr(y), width);
+			});
+			if (height & 1) {
+				const uchar* bgr = frame.ptr(height - 1);
+				uchar* row = gray.ptr(height - 1);
+				for (int x = 0; x < width; ++x)
+					row[x] = Gray(bgr + x * 3);
+			}
+		}
+
+		num_levels_ = 2;
+		while (num_levels_ < max_levels_) {
+			const Mat& prev = levels_[num_levels_ - 1];
+			if (prev.cols < 2 || prev.rows < 2)
+				break;
+			resize(prev, levels_[num_levels_], Size(prev.cols / 2, prev.rows / 2), 0, 0, INTER_AREA);
+			++num_levels_;
+		}
+	}
+
+	const Mat& FramePyramid::Edges(int level, double threshold1, double threshold2) {
+		CV_Assert(level >= 0 && level < num_levels_);
+		auto& cache = edges_[level];
+		if (!cache.valid || cache.threshold1 != threshold1 || cache.threshold2 != threshold2) {
+			Canny(levels_[level], cache.edges, threshold1, threshold2);
+			cache.valid = true;
+			cache.threshold1 = threshold1;
+			cache.threshold2 = threshold2;
+		}
+		return cache.edges;
+	}
+}
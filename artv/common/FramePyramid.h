@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef FRAMEPYRAMID_H
+#define FRAMEPYRAMID_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	//! Convert two rows of BGR pixels to gray, and average them into one row of the
+	//	half-size image, in a single pass over the input. Gray values are weighted in
+	//	fixed point with 8 fractional bits, which may differ from cvtColor by one level.
+	//	@param half Output of width / 2 pixels.
+	void COMMON_API BGR2GrayHalfRows(const uchar* bgr0, const uchar* bgr1,
+									 uchar* gray0, uchar* gray1, uchar* half, int width);
+
+	//! The class FramePyramid holds the gray image pyramid of the current frame, from
+	//	which every vision stage takes the level it works on, so that the frame is only
+	//	converted and downsampled once. Level 0 is at full resolution and each level
+	//	has half the width and height of the one below. The buffers are kept across
+	//	frames, so frames of the same size cause no allocation.
+	class COMMON_API FramePyramid {
+		struct EdgeCache {
+			bool valid = false;
+			double threshold1 = 0;
+			double threshold2 = 0;
+			cv::Mat edges;
+		};
+		int max_levels_;
+		int num_levels_ = 0;
+		//! Level 0 of a BGR frame. Gray frames are referred to without a copy instead.
+		cv::Mat gray_;
+		std::vector<cv::Mat> levels_;
+		std::vector<EdgeCache> edges_;
+	public:
+		//! @param max_levels Number of levels to build, at least 2. Fewer are built for
+		//	frames too small to halve.
+		explicit FramePyramid(int max_levels = 4);
+
+		//! Build the pyramid of a frame of type CV_8UC3 in BGR order, or CV_8UC1.
+		//	Mats got from the pyramid are overwritten by the next build.
+		void Build(const cv::Mat& frame);
+
+		inline int NumLevels() const { return num_levels_; }
+		inline const cv::Mat& Level(int level) const { return levels_[level]; }
+		//! Ratio of the size of level 0 to the size of a level.
+		inline static double Scale(int level) { return double(1 << level); }
+		inline cv::Size GetSize() const { return num_levels_ ? levels_[0].size() : cv::Size(); }
+
+		//! Canny edge map of a level. It is computed at the first call in a frame, and
+		//	computed again only if the thresholds change.
+		const cv::Mat& Edges(int level, double threshold1, double threshold2);
+	};
+}
+
+#endif // !FRAMEPYRAMID_H
@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <common/FrameQualityGate.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	FrameQualityGate::FrameQualityGate(const FrameQualityOptions& options) : options_(options) {}
+
+	void FrameQualityGate::Reset() {
+		reference_.release();
+		sharpness_ = 0;
+		skipped_ = 0;
+	}
+
+	double FrameQualityGate::LaplacianVariance(const Mat& gray) {
+		CV_Assert(gray.type() == CV_8UC1);
+		if (gray.rows < 3 || gray.cols < 3)
+			return 0;
+		// The squares of a row would overflow 32 bits on large images, so they are
+		// accumulated in 64 bits.
+		int64 sum = 0, sum_sqr = 0;
+		for (int y = 1; y < gray.rows - 1; ++y) {
+			const uchar* up = gray.ptr<uchar>(y - 1);
+			const uchar* row = gray.ptr<uchar>(y);
+			const uchar* down = gray.ptr<uchar>(y + 1);
+			int x = 1;
+			int row_sum = 0;
+			int64 row_sqr = 0;
+#if CV_SIMD128
+			v_int32x4 vsum = v_setzero_s32();
+			v_int64x2 vsqr = v_setzero_s64();
+			v_int16x8 ones = v_setall_s16(1);
+			for (; x <= gray.cols - 9; x += 8) {
+				v_int16x8 c = v_reinterpret_as_s16(v_load_expand(row + x));
+				v_int16x8 l = v_reinterpret_as_s16(v_load_expand(row + x - 1));
+				v_int16x8 r = v_reinterpret_as_s16(v_load_expand(row + x + 1));
+				v_int16x8 u = v_reinterpret_as_s16(v_load_expand(up + x));
+				v_int16x8 d = v_reinterpret_as_s16(v_load_expand(down + x));
+				v_int16x8 lap = (c << 2) - l - r - u - d;
+				vsum += v_dotprod(lap, ones);
+				v_int64x2 sqr0, sqr1;
+				v_expand(v_dotprod(lap, lap), sqr0, sqr1);
+				vsqr += sqr0 + sqr1;
+			}
+			row_sum = v_reduce_sum(vsum);
+			int64 sqr[2];
+			v_store(sqr, vsqr);
+			row_sqr = sqr[0] + sqr[1];
+#endif
+			for (; x < gray.cols - 1; ++x) {
+				int lap = 4 * row[x] - row[x - 1] - row[x + 1] - up[x] - down[x];
+				row_sum += lap;
+				row_sqr += lap * lap;
+			}
+			sum += row_sum;
+			sum_sqr += row_sqr;
+		}
+		double n = double(gray.rows - 2) * (gray.cols - 2);
+		double mean = sum / n;
+		return sum_sqr / n - mean * mean;
+	}
+
+	double FrameQualityGate::MeanAbsDiff(const Mat& a, const Mat& b) {
+		CV_Assert(a.type() == CV_8UC1 && b.type() == CV_8UC1 && a.size() == b.size());
+		if (a.empty())
+			return 0;
+		int64 sum = 0;
+		for (int y = 0; y < a.rows; ++y) {
+			const uchar* pa = a.ptr<uchar>(y);
+			const uchar* pb = b.ptr<uchar>(y);
+			int x = 0;
+#if CV_SIMD128
+			v_uint32x4 acc = v_setzero_u32();
+			for (; x <= a.cols - 16; x += 16) {
+				v_uint16x8 d0, d1;
+				v_expand(v_absdiff(v_load(pa + x), v_load(pb + x)), d0, d1);
+				v_uint32x4 s0, s1;
+				v_expand(d0 + d1, s0, s1);
+				acc += s0 + s1;
+			}
+			sum += v_reduce_sum(acc);
+#endif
+			for (; x < a.cols; ++x)
+				sum += abs(pa[x] - pb[x]);
+		}
+		return double(sum) / a.total();
+	}
+
+	FrameQuality FrameQualityGate::Evaluate(const FramePyramid& pyramid) {
+		FrameQuality quality;
+		if (pyramid.NumLevels() == 0)
+			return quality;
+		const Mat& level = pyramid.Level(min(options_.level, pyramid.NumLevels() - 1));
+		quality.sharpness = LaplacianVariance(level);
+		bool comparable = reference_.size() == level.size();
+		if (comparable)
+			quality.difference = MeanAbsDiff(level, reference_);
+
+		if (!comparable || skipped_ >= options_.max_skipped)
+			quality.decision = FRAME_FULL;
+		else if (quality.difference < options_.duplicate_diff)
+			quality.decision = FRAME_REUSE_POSE;
+		else if (quality.sharpness < sharpness_ * options_.blur_rate)
+			quality.decision = FRAME_POSE_ONLY;
+		else
+			quality.decision = FRAME_FULL;
+
+		if (quality.decision == FRAME_FULL) {
+			skipped_ = 0;
+			// Only the sharp frames set the bar, so a run of blurry ones does not lower it.
+			sharpness_ = sharpness_ > 0 ? sharpness_ + (quality.sharpness - sharpness_) * options_.sharpness_smoothing
+				: quality.sharpness;
+		}
+		else
+			++skipped_;
+		// Duplicates are compared with the last frame tracked, so that a slow drift adds up.
+		if (quality.decision != FRAME_REUSE_POSE)
+			level.copyTo(reference_);
+		return quality;
+	}
+}
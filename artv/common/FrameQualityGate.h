@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef FRAMEQUALITYGATE_H
+#define FRAMEQUALITYGATE_H
+
+#include <opencv2/core.hpp>
+
+#include <common/FramePyramid.h>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	//! How much of the tracking a frame is worth.
+	enum FrameDecision {
+		//! Track the frame and update the map with it.
+		FRAME_FULL,
+		//! Track the pose, but keep the frame out of the map, such as a blurry one.
+		FRAME_POSE_ONLY,
+		//! Nothing moved since the last frame tracked, so its pose is kept as it is.
+		FRAME_REUSE_POSE
+	};
+
+	struct FrameQualityOptions {
+		//! Pyramid level the metrics are computed on, or the coarsest one if there are fewer.
+		int level = 2;
+		//! Frames with a sharpness below this rate of the recent sharp frames are blurry.
+		double blur_rate = 0.4;
+		//! Frames differing from the last frame tracked by less than this mean absolute
+		//	difference in gray levels are duplicates.
+		double duplicate_diff = 1.5;
+		//! Weight of a new frame in the running sharpness of the sharp frames.
+		double sharpness_smoothing = 0.1;
+		//! Frames after which a frame is fully tracked anyway, so that the gate cannot
+		//	keep the tracking stale.
+		int max_skipped = 8;
+	};
+
+	//! Metrics of a frame and the decision taken on them.
+	struct FrameQuality {
+		//! Variance of the Laplacian.
+		double sharpness = 0;
+		//! Mean absolute difference from the last frame tracked.
+		double difference = 0;
+		FrameDecision decision = FRAME_FULL;
+	};
+
+	//! The class FrameQualityGate decides how much of the tracking a frame gets, before
+	//	any of it runs. The metrics are computed on a coarse level of the pyramid with
+	//	the universal intrinsics, so they cost a few microseconds.
+	class COMMON_API FrameQualityGate {
+	public:
+		FrameQualityGate(const FrameQualityOptions& options = FrameQualityOptions());
+		inline void SetOptions(const FrameQualityOptions& options) { options_ = options; }
+
+		//! Measure the frame of the pyramid and decide on it.
+		FrameQuality Evaluate(const FramePyramid& pyramid);
+		//! Forget the frames seen, so that the next one is fully tracked.
+		void Reset();
+
+		//! Variance of the 4-neighbour Laplacian over the interior of a gray image.
+		static double LaplacianVariance(const cv::Mat& gray);
+		//! Mean absolute difference of two gray images of the same size.
+		static double MeanAbsDiff(const cv::Mat& a, const cv::Mat& b);
+
+	private:
+		FrameQualityOptions options_;
+		//! The level of the last frame tracked.
+		cv::Mat reference_;
+		double sharpness_ = 0;
+		int skipped_ = 0;
+	};
+}
+
+#endif // !FRAMEQUALITYGATE_H
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <common/Geometry.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar
+{
+	void SVD3x3(const Matx33d& A, Matx33d& U, Vec3d& w, Matx33d& V) {
+		const int MAX_SWEEPS = 20;
+		const double EPS = 1e-15;
+		// Rotate pairs of columns of B = A V until they are orthogonal. Then the column
+		// norms are the singular values, and the normalized columns are U.
+		Matx33d B = A;
+		V = Matx33d::eye();
+		for (int sweep = 0; sweep < MAX_SWEEPS; ++sweep) {
+			bool rotated = false;
+			for (int p = 0; p < 2; ++p)
+				for (int q = p + 1; q < 3; ++q) {
+					double alpha = 0, beta = 0, gamma = 0;
+					for (int i = 0; i < 3; ++i) {
+						alpha += B(i, p) * B(i, p);
+						beta += B(i, q) * B(i, q);
+						gamma += B(i, p) * B(i, q);
+					}
+					if (abs(gamma) <= EPS * sqrt(alpha * beta) || gamma == 0)
+						continue;
+					rotated = true;
+					double zeta = (beta - alpha) / (2 * gamma);
+					double tangent = (zeta >= 0 ? 1 : -1) / (abs(zeta) + sqrt(1 + zeta * zeta));
+					double c = 1 / sqrt(1 + tangent * tangent);
+					double s = c * tangent;
+					for (int i = 0; i < 3; ++i) {
+						double bp = B(i, p), bq = B(i, q);
+						B(i, p) = c * bp - s * bq;
+						B(i, q) = s * bp + c * bq;
+						double vp = V(i, p), vq = V(i, q);
+						V(i, p) = c * vp - s * vq;
+						V(i, q) = s * vp + c * vq;
+					}
+				}
+			if (!rotated)
+				break;
+		}
+
+		// Sort the columns by their norms, descending.
+		int order[3] = { 0, 1, 2 };
+		Vec3d norms;
+		for (int j = 0; j < 3; ++j)
+			norms[j] = sqrt(B(0, j) * B(0, j) + B(1, j) * B(1, j) + B(2, j) * B(2, j));
+		sort(order, order + 3, [&norms](int a, int b) { return norms[a] > norms[b]; });
+		Matx33d sorted_V;
+		Vec3d u[3];
+		for (int k = 0; k < 3; ++k) {
+			int j = order[k];
+			w[k] = norms[j];
+			for (int i = 0; i < 3; ++i)
+				sorted_V(i, k) = V(i, j);
+			u[k] = Vec3d(B(0, j), B(1, j), B(2, j));
+		}
+		V = sorted_V;
+
+		// Columns of U for vanishing singular values are completed to an orthonormal basis.
+		double tiny = max(w[0], 1.) * 1e-12;
+		if (w[0] <= tiny)
+			u[0] = Vec3d(1, 0, 0);
+		else
+			u[0] /= w[0];
+		if (w[1] <= tiny) {
+			// Any direction orthogonal to u[0].
+			Vec3d axis = abs(u[0][0]) < 0.9 ? Vec3d(1, 0, 0) : Vec3d(0, 1, 0);
+			u[1] = u[0].cross(axis);
+			u[1] /= norm(u[1]);
+		}
+		else
+			u[1] /= w[1];
+		if (w[2] <= tiny)
+			u[2] = u[0].cross(u[1]);
+		else
+			u[2] /= w[2];
+		for (int k = 0; k < 3; ++k)
+			for (int i = 0; i < 3; ++i)
+				U(i, k) = u[k][i];
+	}
+}
@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/core.hpp>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+//! Pose math on fixed-size types. Everything here lives on the stack, and the small
+//	functions are inline, so they can be used per point without allocating.
+namespace ar
+{
+	//! The skew-symmetric matrix of w, so that Hat(w) * x = w x x.
+	inline cv::Matx33d Hat(const cv::Vec3d& w) {
+		return cv::Matx33d(0, -w[2], w[1],
+						   w[2], 0, -w[0],
+						   -w[1], w[0], 0);
+	}
+
+	//! The rotation of the angle |w| around the axis w, by the Rodrigues formula.
+	inline cv::Matx33d ExpSO3(const cv::Vec3d& w) {
+		double theta2 = w.dot(w);
+		double a, b;
+		if (theta2 < 1e-10) {
+			// Taylor expansions of sin(theta) / theta and (1 - cos(theta)) / theta^2.
+			a = 1 - theta2 / 6;
+			b = 0.5 - theta2 / 24;
+		}
+		else {
+			double theta = std::sqrt(theta2);
+			a = std::sin(theta) / theta;
+			b = (1 - std::cos(theta)) / theta2;
+		}
+		cv::Matx33d W = Hat(w);
+		return cv::Matx33d::eye() + W * a + (W * W) * b;
+	}
+
+	//! The rotation vector of R, with an angle in [0, pi].
+	inline cv::Vec3d LogSO3(const cv::Matx33d& R) {
+		double cos_theta = std::min(std::max((R(0, 0) + R(1, 1) + R(2, 2) - 1) * 0.5, -1.0), 1.0);
+		// Twice the axis times sin(theta).
+		cv::Vec3d v(R(2, 1) - R(1, 2), R(0, 2) - R(2, 0), R(1, 0) - R(0, 1));
+		if (cos_theta > 1 - 1e-10)
+			return v * 0.5;
+		double theta = std::acos(cos_theta);
+		if (cos_theta > -0.99)
+			return v * (theta / (2 * std::sin(theta)));
+
+		// Near pi, sin(theta) vanishes, so the axis is taken from the symmetric part,
+		// (1 - cos(theta)) n n^T, starting from its largest diagonal element.
+		int i = 0;
+		if (R(1, 1) > R(i, i))
+			i = 1;
+		if (R(2, 2) > R(i, i))
+			i = 2;
+		double scale = 1 - cos_theta;
+		cv::Vec3d n;
+		n[i] = std::sqrt(std::max((R(i, i) - cos_theta) / scale, 0.0));
+		for (int j = 0; j < 3; ++j)
+			if (j != i)
+				n[j] = (R(i, j) + R(j, i)) / (2 * scale * n[i]);
+		n /= cv::norm(n);
+		if (n.dot(v) < 0)
+			n = -n;
+		return n * theta;
+	}
+
+	//! A rigid transformation x' = R x + t. A camera pose maps the world coordinate to
+	//	the camera coordinate.
+	struct SE3 {
+		cv::Matx33d R;
+		cv::Vec3d t;
+
+		SE3() : R(cv::Matx33d::eye()), t(0, 0, 0) {}
+		SE3(const cv::Matx33d& _R, const cv::Vec3d& _t) : R(_R), t(_t) {}
+
+		inline cv::Vec3d operator*(const cv::Vec3d& x) const { return R * x + t; }
+		inline SE3 operator*(const SE3& other) const { return SE3(R * other.R, R * other.t + t); }
+		inline SE3 Inverse() const {
+			cv::Matx33d Rt = R.t();
+			return SE3(Rt, -(Rt * t));
+		}
+		//! The 3x4 matrix [R|t].
+		inline cv::Matx34d Matrix() const {
+			return cv::Matx34d(R(0, 0), R(0, 1), R(0, 2), t[0],
+							   R(1, 0), R(1, 1), R(1, 2), t[1],
+							   R(2, 0), R(2, 1), R(2, 2), t[2]);
+		}
+	};
+
+	//! The transformation of the twist xi = (rho, phi): rotation by ExpSO3(phi), and
+	//	translation by the left Jacobian of SO3 applied to rho.
+	inline SE3 ExpSE3(const cv::Vec6d& xi) {
+		cv::Vec3d rho(xi[0], xi[1], xi[2]);
+		cv::Vec3d phi(xi[3], xi[4], xi[5]);
+		double theta2 = phi.dot(phi);
+		double b, c;
+		if (theta2 < 1e-10) {
+			b = 0.5 - theta2 / 24;
+			c = 1. / 6 - theta2 / 120;
+		}
+		else {
+			double theta = std::sqrt(theta2);
+			b = (1 - std::cos(theta)) / theta2;
+			c = (theta - std::sin(theta)) / (theta2 * theta);
+		}
+		cv::Matx33d W = Hat(phi);
+		cv::Matx33d V = cv::Matx33d::eye() + W * b + (W * W) * c;
+		return SE3(ExpSO3(phi), V * rho);
+	}
+
+	//! The twist (rho, phi) of a transformation, the inverse of ExpSE3.
+	inline cv::Vec6d LogSE3(const SE3& T) {
+		cv::Vec3d phi = LogSO3(T.R);
+		double theta2 = phi.dot(phi);
+		double d;
+		if (theta2 < 1e-10)
+			d = 1. / 12 + theta2 / 720;
+		else {
+			double theta = std::sqrt(theta2);
+			double half = theta / 2;
+			d = (1 - half * std::cos(half) / std::sin(half)) / theta2;
+		}
+		cv::Matx33d W = Hat(phi);
+		cv::Vec3d rho = (cv::Matx33d::eye() - W * 0.5 + (W * W) * d) * T.t;
+		return cv::Vec6d(rho[0], rho[1], rho[2], phi[0], phi[1], phi[2]);
+	}
+
+	//! Singular value decomposition A = U diag(w) V^T of a 3x3 matrix by one-sided Jacobi
+	//	rotations. The singular values are in descending order, and U and V are orthogonal
+	//	even if A is singular.
+	void COMMON_API SVD3x3(const cv::Matx33d& A, cv::Matx33d& U, cv::Vec3d& w, cv::Matx33d& V);
+}
+
+#endif // !GEOMETRY_H
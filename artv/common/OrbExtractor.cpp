@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <common/OrbExtractor.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	namespace {
+		const int HALF_PATCH = OrbExtractor::PATCH_SIZE / 2;
+		const int NUM_TESTS = OrbExtractor::DESCRIPTOR_BYTES * 8;
+		//! Keypoints are kept this far from the borders, so that the rotated test pattern,
+		//	within HALF_PATCH * sqrt(2) of the keypoint, stays inside the image.
+		const int EDGE_THRESHOLD = 23;
+
+		//! The point pairs of the binary tests, as floats for rotating them.
+		struct TestPattern {
+			float x0[NUM_TESTS], y0[NUM_TESTS], x1[NUM_TESTS], y1[NUM_TESTS];
+		};
+
+		//! Points drawn from an isotropic Gaussian of sigma PATCH_SIZE / 5 around the
+		//	keypoint, as in the BRIEF paper, with a fixed seed.
+		TestPattern MakeTestPattern() {
+			TestPattern pattern;
+			RNG rng(0x0DB);
+			double sigma = OrbExtractor::PATCH_SIZE / 5.;
+			auto Draw = [&rng, sigma]() {
+				return float(min(max(cvRound(rng.gaussian(sigma)), -HALF_PATCH), HALF_PATCH));
+			};
+			for (int i = 0; i < NUM_TESTS; ++i) {
+				pattern.x0[i] = Draw();
+				pattern.y0[i] = Draw();
+				pattern.x1[i] = Draw();
+				pattern.y1[i] = Draw();
+			}
+			return pattern;
+		}
+
+		const TestPattern& GetTestPattern() {
+			static const TestPattern pattern = MakeTestPattern();
+			return pattern;
+		}
+
+		//! Half widths of the rows of the circular patch.
+		const vector<int>& GetUMax() {
+			static const vector<int> umax = [] {
+				vector<int> u(HALF_PATCH + 1);
+				for (int v = 0; v <= HALF_PATCH; ++v)
+					u[v] = cvFloor(sqrt(double(HALF_PATCH * HALF_PATCH - v * v)) + 0.5);
+				return u;
+			}();
+			return umax;
+		}
+
+		//! Orientation of the intensity centroid of the circular patch, in degrees.
+		float ICAngle(const Mat& image, Point2f pt) {
+			const vector<int>& umax = GetUMax();
+			const uchar* center = image.ptr<uchar>(cvRound(pt.y)) + cvRound(pt.x);
+			int step = int(image.step1());
+			int m_01 = 0, m_10 = 0;
+			for (int u = -HALF_PATCH; u <= HALF_PATCH; ++u)
+				m_10 += u * center[u];
+			// Rows above and below the center at once.
+			for (int v = 1; v <= HALF_PATCH; ++v) {
+				int v_sum = 0;
+				for (int u = -umax[v]; u <= umax[v]; ++u) {
+					int below = center[u + v * step], above = center[u - v * step];
+					v_sum += below - above;
+					m_10 += u * (below + above);
+				}
+				m_01 += v * v_sum;
+			}
+			return fastAtan2(float(m_01), float(m_10));
+		}
+
+		//! The rBRIEF descriptor of a keypoint, on the blurred level.
+		void Describe(const Mat& blurred, const KeyPoint& kp, uchar* desc) {
+			const TestPattern& pattern = GetTestPattern();
+			const uchar* center = blurred.ptr<uchar>(cvRound(kp.pt.y)) + cvRound(kp.pt.x);
+			float angle = kp.angle * float(CV_PI / 180);
+			float c = cos(angle), s = sin(angle);
+			float step = float(blurred.step1());
+			// Offsets of the rotated points from the center, then the pixels gathered at them.
+			int off0[NUM_TESTS], off1[NUM_TESTS];
+			uchar a[NUM_TESTS], b[NUM_TESTS];
+			int i = 0;
+#if CV_SIMD128
+			v_float32x4 vc = v_setall_f32(c), vs = v_setall_f32(s), vstep = v_setall_f32(step);
+			auto Offsets = [&](const float* px, const float* py, int* off) {
+				v_float32x4 x = v_load(px), y = v_load(py);
+				v_float32x4 rx = v_cvt_f32(v_round(x * vc - y * vs));
+				v_float32x4 ry = v_cvt_f32(v_round(x * vs + y * vc));
+				v_store(off, v_round(ry * vstep + rx));
+			};
+			for (; i < NUM_TESTS; i += 4) {
+				Offsets(pattern.x0 + i, pattern.y0 + i, off0 + i);
+				Offsets(pattern.x1 + i, pattern.y1 + i, off1 + i);
+			}
+#endif
+			for (; i < NUM_TESTS; ++i) {
+				off0[i] = cvRound(pattern.x0[i] * s + pattern.y0[i] * c) * int(step) + cvRound(pattern.x0[i] * c - pattern.y0[i] * s);
+				off1[i] = cvRound(pattern.x1[i] * s + pattern.y1[i] * c) * int(step) + cvRound(pattern.x1[i] * c - pattern.y1[i] * s);
+			}
+			for (i = 0; i < NUM_TESTS; ++i) {
+				a[i] = center[off0[i]];
+				b[i] = center[off1[i]];
+			}
+			// Bit k of byte j is the test 8j + k.
+			i = 0;
+#if CV_SIMD128
+			for (; i < NUM_TESTS; i += 16) {
+				int bits = v_signmask(v_load(a + i) < v_load(b + i));
+				desc[i / 8] = uchar(bits);
+				desc[i / 8 + 1] = uchar(bits >> 8);
+			}
+#endif
+			for (; i < NUM_TESTS; i += 8) {
+				int byte = 0;
+				for (int k = 0; k < 8; ++k)
+					byte |= (a[i + k] < b[i + k]) << k;
+				desc[i / 8] = uchar(byte);
+			}
+		}
+	}
+
+	OrbExtractor::OrbExtractor(const OrbOptions& options) {
+		SetOptions(options);
+	}
+
+	void OrbExtractor::SetOptions(const OrbOptions& options) {
+		options_ = options;
+		levels_.resize(max(options_.num_levels, 1));
+		// The features are spread over the levels in a geometric series of the scale
+		// factor, as in cv::ORB, so that the coarse levels are not crowded.
+		float factor = 1 / options_.scale_factor;
+		int n = int(levels_.size());
+		double first = options_.max_features * (1 - factor) / (1 - pow(factor, n));
+		int assigned = 0;
+		for (int l = 0; l < n; ++l) {
+			levels_[l].scale = pow(options_.scale_factor, float(l));
+			levels_[l].num_features = l + 1 < n ? cvRound(first * pow(factor, l)) : max(options_.max_features - assigned, 0);
+			assigned += levels_[l].num_features;
+		}
+	}
+
+	void OrbExtractor::ExtractLevel(const FramePyramid& pyramid, Level& level) {
+		level.keypoints.clear();
+		// Resample the level from the finest octave not finer than it.
+		int octave = 0;
+		while (octave + 1 < pyramid.NumLevels() && FramePyramid::Scale(octave + 1) <= level.scale + 1e-3)
+			++octave;
+		const Mat& source = pyramid.Level(octave);
+		double ratio = level.scale / FramePyramid::Scale(octave);
+		Size level_size(cvRound(pyramid.GetSize().width / level.scale), cvRound(pyramid.GetSize().height / level.scale));
+		if (level_size.width <= 2 * EDGE_THRESHOLD || level_size.height <= 2 * EDGE_THRESHOLD)
+			return;
+		if (abs(ratio - 1) < 1e-3)
+			level.image = source;
+		else {
+			resize(source, level.resampled, level_size, 0, 0, INTER_LINEAR);
+			level.image = level.resampled;
+		}
+		const Mat& image = level.image;
+
+		// Detect within the borders. FAST leaves 3 pixels of the region out itself.
+		Rect roi(EDGE_THRESHOLD - 3, EDGE_THRESHOLD - 3,
+				 image.cols - 2 * (EDGE_THRESHOLD - 3), image.rows - 2 * (EDGE_THRESHOLD - 3));
+		FAST(image(roi), level.keypoints, options_.fast_threshold, true);
+		if (int(level.keypoints.size()) < level.num_features && options_.min_fast_threshold < options_.fast_threshold)
+			FAST(image(roi), level.keypoints, options_.min_fast_threshold, true);
+		KeyPointsFilter::retainBest(level.keypoints, level.num_features);
+		if (int(level.keypoints.size()) > level.num_features)
+			level.keypoints.resize(level.num_features);
+
+		for (auto& kp : level.keypoints) {
+			kp.pt.x += roi.x;
+			kp.pt.y += roi.y;
+			kp.angle = ICAngle(image, kp.pt);
+		}
+
+		GaussianBlur(image, level.blurred, Size(7, 7), 2, 2, BORDER_REFLECT_101);
+		level.descriptors.create(int(level.keypoints.size()), DESCRIPTOR_BYTES, CV_8U);
+		for (int i = 0; i < level.keypoints.size(); ++i)
+			Describe(level.blurred, level.keypoints[i], level.descriptors.ptr<uchar>(i));
+	}
+
+	void OrbExtractor::Extract(const FramePyramid& pyramid, vector<KeyPoint>& keypoints, Mat& descriptors) {
+		keypoints.clear();
+		if (pyramid.NumLevels() == 0) {
+			descriptors.release();
+			return;
+		}
+		ParallelFor(pool_, 0, int(levels_.size()), [&](int begin, int end) {
+			for (int l = begin; l < end; ++l)
+				ExtractLevel(pyramid, levels_[l]);
+		});
+
+		int total = 0;
+		for (auto& level : levels_)
+			total += int(level.keypoints.size());
+		descriptors.create(total, DESCRIPTOR_BYTES, CV_8U);
+		keypoints.reserve(total);
+		int row = 0;
+		for (int l = 0; l < levels_.size(); ++l) {
+			auto& level = levels_[l];
+			if (level.keypoints.empty())
+				continue;
+			float size = PATCH_SIZE * level.scale;
+			for (auto kp : level.keypoints) {
+				kp.pt *= level.scale;
+				kp.size = size;
+				kp.octave = l;
+				keypoints.push_back(kp);
+			}
+			level.descriptors.copyTo(descriptors.rowRange(row, row + level.descriptors.rows));
+			row += level.descriptors.rows;
+		}
+	}
+}
@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef ORBEXTRACTOR_H
+#define ORBEXTRACTOR_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <common/FramePyramid.h>
+#include <common/WorkerPool.h>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	struct OrbOptions {
+		int max_features = 500;
+		int num_levels = 8;
+		float scale_factor = 1.2f;
+		//! FAST threshold, lowered to the minimum on levels where too few corners are found.
+		int fast_threshold = 20;
+		int min_fast_threshold = 7;
+	};
+
+	//! The class OrbExtractor detects ORB keypoints and computes their descriptors, with
+	//	each level of its scale pyramid as a parallel task. The levels are resampled from
+	//	the nearest octave of a FramePyramid, so the frame is not converted again. All the
+	//	buffers are kept across frames.
+	//	The descriptors are 32-byte rBRIEF strings like those of cv::ORB, though with a
+	//	test pattern of their own, so they are not to be matched against cv::ORB ones.
+	class COMMON_API OrbExtractor {
+	public:
+		//! Size of the patch the orientation and the descriptor are computed on.
+		static const int PATCH_SIZE = 31;
+		static const int DESCRIPTOR_BYTES = 32;
+
+		OrbExtractor(const OrbOptions& options = OrbOptions());
+		void SetOptions(const OrbOptions& options);
+		inline const OrbOptions& GetOptions() const { return options_; }
+		//! Run the levels on a pool instead of with cv::parallel_for_.
+		inline void SetWorkerPool(WorkerPool* pool) { pool_ = pool; }
+
+		//! Detect keypoints in the pyramid and describe them. The keypoints are in the
+		//	pixels of level 0 of the pyramid, with their levels as octaves.
+		//	@param descriptors Created with its own allocator, if any.
+		void Extract(const FramePyramid& pyramid, std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors);
+
+	private:
+		struct Level {
+			float scale = 1;
+			int num_features = 0;
+			//! The octave of the pyramid, or the level resampled from one.
+			cv::Mat image;
+			cv::Mat resampled;
+			cv::Mat blurred;
+			std::vector<cv::KeyPoint> keypoints;
+			cv::Mat descriptors;
+		};
+		OrbOptions options_;
+		std::vector<Level> levels_;
+		WorkerPool* pool_ = NULL;
+
+		void ExtractLevel(const FramePyramid& pyramid, Level& level);
+	};
+}
+
+#endif // !ORBEXTRACTOR_H
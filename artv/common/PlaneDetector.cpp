@@ -0,0 +1,276 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cfloat>
+
+#include <common/PlaneDetector.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar
+{
+	PlaneDetector::PlaneDetector(const PlaneDetectorOptions& options) :
+		options_(options), output_(make_shared<PlaneMap>()), rng_(options.seed) {}
+
+	void PlaneDetector::SubmitLandmarks(vector<Vec3d>&& landmarks, const Vec3d& down, const Vec3d& viewpoint) {
+		lock_guard<mutex> lock(input_mutex_);
+		input_ = move(landmarks);
+		input_down_ = down;
+		input_viewpoint_ = viewpoint;
+		++input_version_;
+	}
+
+	shared_ptr<const PlaneMap> PlaneDetector::GetPlaneMap() const {
+		lock_guard<mutex> lock(output_mutex_);
+		return output_;
+	}
+
+	void PlaneDetector::Reset() {
+		{
+			lock_guard<mutex> lock(input_mutex_);
+			input_.clear();
+			input_version_ = 0;
+		}
+		processed_version_ = 0;
+		planes_.clear();
+		lock_guard<mutex> lock(output_mutex_);
+		output_ = make_shared<PlaneMap>();
+	}
+
+	bool PlaneDetector::FitPlane(const vector<Vec3d>& points, const vector<int>& indices, DetectedPlane& plane) {
+		if (indices.size() < 3)
+			return false;
+		Vec3d centroid(0, 0, 0);
+		for (int i : indices)
+			centroid += points[i];
+		centroid *= 1. / indices.size();
+		Matx33d cov = Matx33d::zeros();
+		for (int i : indices) {
+			Vec3d p = points[i] - centroid;
+			cov += p * p.t();
+		}
+		// The normal is the direction of the least spread.
+		Matx33d U, V;
+		Vec3d w;
+		SVD3x3(cov, U, w, V);
+		Vec3d normal(V(0, 2), V(1, 2), V(2, 2));
+		// Keep the side of the normal the plane had.
+		if (plane.normal.dot(normal) < 0)
+			normal = -normal;
+		plane.normal = normal;
+		plane.d = -normal.dot(centroid);
+		return true;
+	}
+
+	bool PlaneDetector::Update() {
+		Vec3d down, viewpoint;
+		int version;
+		{
+			lock_guard<mutex> lock(input_mutex_);
+			if (input_version_ == processed_version_)
+				return false;
+			points_.swap(input_);
+			down = input_down_;
+			viewpoint = input_viewpoint_;
+			version = input_version_;
+		}
+		processed_version_ = version;
+		// Seeded per version, so that the same landmarks always give the same planes.
+		rng_ = RNG(options_.seed ^ unsigned(version));
+
+		auto plane_map = make_shared<PlaneMap>();
+		plane_map->version = version;
+		int n = int(points_.size());
+		if (n < options_.min_inliers) {
+			planes_.clear();
+			lock_guard<mutex> lock(output_mutex_);
+			output_ = plane_map;
+			return true;
+		}
+
+		// The inlier threshold follows the spread of the map, whose scale is arbitrary.
+		Vec3d centroid(0, 0, 0);
+		for (auto& p : points_)
+			centroid += p;
+		centroid *= 1. / n;
+		vector<double> dists(n);
+		for (int i = 0; i < n; ++i)
+			dists[i] = norm(points_[i] - centroid);
+		nth_element(dists.begin(), dists.begin() + n / 2, dists.end());
+		double thresh = max(dists[n / 2], 1e-9) * options_.inlier_rate;
+
+		vector<char> used(n, 0);
+		vector<int> inliers;
+		auto Collect = [&](const DetectedPlane& plane, vector<int>& out) {
+			out.clear();
+			for (int i = 0; i < n; ++i)
+				if (!used[i] && abs(plane.normal.dot(points_[i]) + plane.d) < thresh)
+					out.push_back(i);
+		};
+		// Refine a plane by least squares on its inliers, and take them if still enough.
+		auto Accept = [&](DetectedPlane plane) {
+			Collect(plane, inliers);
+			if (int(inliers.size()) < options_.min_inliers || !FitPlane(points_, inliers, plane))
+				return false;
+			Collect(plane, inliers);
+			if (int(inliers.size()) < options_.min_inliers)
+				return false;
+			plane.num_inliers = int(inliers.size());
+			for (int i : inliers)
+				used[i] = 1;
+			if (plane.normal.dot(viewpoint) + plane.d < 0) {
+				plane.normal = -plane.normal;
+				plane.d = -plane.d;
+			}
+			// Seen from the viewpoint, right x normal is down.
+			plane.right = plane.normal.cross(down);
+			double right_norm = norm(plane.right);
+			plane.right = right_norm > 1e-9 ? plane.right / right_norm : Vec3d(0, 0, 0);
+			plane.down = plane.right.cross(plane.normal);
+			FindCandidates(plane, int(plane_map->planes.size()), inliers, down, plane_map->candidates);
+			plane_map->planes.push_back(plane);
+			return true;
+		};
+
+		// Refit the planes found before, the most supported first.
+		for (auto& plane : planes_)
+			Accept(plane);
+
+		// Look for new planes among the landmarks left.
+		vector<int> remaining;
+		while (int(plane_map->planes.size()) < options_.max_planes) {
+			remaining.clear();
+			for (int i = 0; i < n; ++i)
+				if (!used[i])
+					remaining.push_back(i);
+			int m = int(remaining.size());
+			if (m < options_.min_inliers)
+				break;
+			DetectedPlane best;
+			int best_cnt = 0;
+			for (int iter = 0; iter < options_.ransac_iterations; ++iter) {
+				const Vec3d& a = points_[remaining[rng_.uniform(0, m)]];
+				const Vec3d& b = points_[remaining[rng_.uniform(0, m)]];
+				const Vec3d& c = points_[remaining[rng_.uniform(0, m)]];
+				Vec3d normal = (b - a).cross(c - a);
+				double len = norm(normal);
+				if (len < 1e-12)
+					continue;
+				normal /= len;
+				double d = -normal.dot(a);
+				int cnt = 0;
+				for (int i : remaining)
+					cnt += abs(normal.dot(points_[i]) + d) < thresh;
+				if (cnt > best_cnt) {
+					best_cnt = cnt;
+					best.normal = normal;
+					best.d = d;
+				}
+			}
+			if (best_cnt < options_.min_inliers || !Accept(best))
+				break;
+		}
+		planes_ = plane_map->planes;
+		sort(planes_.begin(), planes_.end(),
+			 [](const DetectedPlane& a, const DetectedPlane& b) { return a.num_inliers > b.num_inliers; });
+
+		if (plane_map->candidates.size() > MAX_CANDIDATES) {
+			sort(plane_map->candidates.begin(), plane_map->candidates.end(),
+				 [](const ScreenCandidate& a, const ScreenCandidate& b) { return a.support > b.support; });
+			plane_map->candidates.resize(MAX_CANDIDATES);
+		}
+
+		lock_guard<mutex> lock(output_mutex_);
+		output_ = plane_map;
+		return true;
+	}
+
+	void PlaneDetector::FindCandidates(const DetectedPlane& plane, int plane_ind, const vector<int>& inliers,
+									   const Vec3d& down, vector<ScreenCandidate>& candidates) const {
+		// Screens hang on walls, not on floors or tables.
+		if (norm(plane.right) == 0 || abs(plane.normal.dot(down)) > options_.max_down_cos * norm(down))
+			return;
+
+		// Mark the cells of a grid over the plane that landmarks fall into.
+		const int GRID = 16;
+		Point2d lo(DBL_MAX, DBL_MAX), hi(-DBL_MAX, -DBL_MAX);
+		vector<Point2d> coords;
+		coords.reserve(inliers.size());
+		for (int i : inliers) {
+			Point2d c(plane.right.dot(points_[i]), plane.down.dot(points_[i]));
+			lo = Point2d(min(lo.x, c.x), min(lo.y, c.y));
+			hi = Point2d(max(hi.x, c.x), max(hi.y, c.y));
+			coords.push_back(c);
+		}
+		Point2d extent = hi - lo;
+		if (extent.x <= 0 || extent.y <= 0)
+			return;
+		Point2d cell(extent.x / GRID, extent.y / GRID);
+		bool occupied[GRID][GRID] = {};
+		for (auto& c : coords)
+			occupied[min(int((c.y - lo.y) / cell.y), GRID - 1)][min(int((c.x - lo.x) / cell.x), GRID - 1)] = true;
+
+		// Slide 16:9 rectangles of a few sizes over the plane, scoring each by the rate of
+		// its cells backed by landmarks.
+		struct Rect2d {
+			double x, y, w, h, score;
+		};
+		vector<Rect2d> rects;
+		for (double rate : options_.screen_width_rates) {
+			double w = extent.x * rate;
+			double h = w * 9 / 16;
+			if (h > extent.y)
+				continue;
+			double step = max(w / 4, cell.x);
+			for (double y = lo.y; y + h <= hi.y + 1e-9; y += max(h / 4, cell.y))
+				for (double x = lo.x; x + w <= hi.x + 1e-9; x += step) {
+					int total = 0, backed = 0;
+					for (int gy = 0; gy < GRID; ++gy) {
+						double cy = lo.y + (gy + 0.5) * cell.y;
+						if (cy < y || cy > y + h)
+							continue;
+						for (int gx = 0; gx < GRID; ++gx) {
+							double cx = lo.x + (gx + 0.5) * cell.x;
+							if (cx < x || cx > x + w)
+								continue;
+							++total;
+							backed += occupied[gy][gx];
+						}
+					}
+					if (total && backed * 2 >= total)
+						rects.push_back({ x, y, w, h, double(backed) / total });
+				}
+		}
+		// Prefer well backed and large screens, and keep them apart.
+		sort(rects.begin(), rects.end(), [](const Rect2d& a, const Rect2d& b) {
+			return a.score * a.w > b.score * b.w;
+		});
+		vector<Rect2d> kept;
+		for (auto& r : rects) {
+			if (int(kept.size()) >= options_.max_candidates_per_plane)
+				break;
+			double cx = r.x + r.w / 2, cy = r.y + r.h / 2;
+			bool overlapping = false;
+			for (auto& k : kept)
+				overlapping |= cx > k.x && cx < k.x + k.w && cy > k.y && cy < k.y + k.h;
+			if (overlapping)
+				continue;
+			kept.push_back(r);
+
+			Vec3d origin = -plane.d * plane.normal;
+			auto OnPlane = [&](double a, double b) { return origin + plane.right * a + plane.down * b; };
+			ScreenCandidate candidate;
+			candidate.plane = plane_ind;
+			candidate.corners = { { OnPlane(r.x, r.y), OnPlane(r.x + r.w, r.y),
+									OnPlane(r.x + r.w, r.y + r.h), OnPlane(r.x, r.y + r.h) } };
+			candidate.center = OnPlane(cx, cy);
+			candidate.support = r.score;
+			candidates.push_back(candidate);
+		}
+	}
+}
@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef PLANEDETECTOR_H
+#define PLANEDETECTOR_H
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <common/Geometry.h>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	struct PlaneDetectorOptions {
+		//! Most planes kept at a time.
+		int max_planes = 4;
+		//! Fewest landmarks supporting a plane.
+		int min_inliers = 30;
+		//! Distance within which a landmark is on a plane, as a rate of the median distance
+		//	of the landmarks from their centroid, since the map has no metric scale.
+		double inlier_rate = 0.02;
+		int ransac_iterations = 200;
+		//! Planes whose normal is within this cosine of the down axis of the world, such as
+		//	floors and tables, get no screen candidates.
+		double max_down_cos = 0.8;
+		//! Screens of these widths, as rates of the extent of the plane, are tried.
+		std::vector<double> screen_width_rates = { 0.6, 0.4, 0.25 };
+		//! Most screen candidates per plane.
+		int max_candidates_per_plane = 4;
+		unsigned seed = 0x5eed;
+	};
+
+	//! A plane n . x + d = 0 of the world, with |n| = 1 pointing to the viewer.
+	struct DetectedPlane {
+		cv::Vec3d normal;
+		double d = 0;
+		//! Landmarks supporting the plane.
+		int num_inliers = 0;
+		//! In-plane axes of the screens on it: right is level, and down points to the
+		//	down axis of the world.
+		cv::Vec3d right;
+		cv::Vec3d down;
+	};
+
+	//! A 16:9 rectangle on a plane where a screen could be placed.
+	struct ScreenCandidate {
+		int plane = -1;
+		//! Corners in the world, in the order of left-upper, right-upper, right-lower and
+		//	left-lower.
+		std::array<cv::Vec3d, 4> corners;
+		cv::Vec3d center;
+		//! Rate of the screen area backed by landmarks on the plane.
+		double support = 0;
+	};
+
+	//! The planes and screen candidates found from one snapshot of the map.
+	struct PlaneMap {
+		std::vector<DetectedPlane> planes;
+		std::vector<ScreenCandidate> candidates;
+		//! Version of the landmarks the planes were found from.
+		int version = 0;
+	};
+
+	//! The class PlaneDetector finds the dominant planes among the 3D landmarks, and
+	//	suggests rectangles on them for screens. The tracking thread only hands over a
+	//	snapshot of the landmarks. The detection runs on the mapping side, and the result
+	//	is published as an immutable PlaneMap, so readers never wait for it.
+	//	Detection is incremental: the planes found before are refitted to the new landmarks
+	//	first, and RANSAC only looks for new planes among the landmarks they leave.
+	class COMMON_API PlaneDetector {
+	public:
+		//! Most candidates in a PlaneMap, so looking one up costs a bounded time.
+		static const int MAX_CANDIDATES = 32;
+
+		PlaneDetector(const PlaneDetectorOptions& options = PlaneDetectorOptions());
+
+		//! Hand over the 3D locations of the landmarks. Called from the tracking thread.
+		//	@param down The down axis of the world.
+		//	@param viewpoint Where the planes are seen from, to orient their normals.
+		void SubmitLandmarks(std::vector<cv::Vec3d>&& landmarks, const cv::Vec3d& down, const cv::Vec3d& viewpoint);
+		//! Detect the planes of the landmarks last submitted, if not yet done.
+		//	@return False if there was nothing new to do.
+		bool Update();
+		//! The latest planes and candidates. Never null.
+		std::shared_ptr<const PlaneMap> GetPlaneMap() const;
+		void Reset();
+
+		//! Fit a plane to the points by least squares. The normal keeps the side of the
+		//	one the plane had, if any.
+		static bool FitPlane(const std::vector<cv::Vec3d>& points, const std::vector<int>& indices, DetectedPlane& plane);
+
+	private:
+		PlaneDetectorOptions options_;
+		mutable std::mutex input_mutex_;
+		std::vector<cv::Vec3d> input_;
+		cv::Vec3d input_down_;
+		cv::Vec3d input_viewpoint_;
+		int input_version_ = 0;
+		mutable std::mutex output_mutex_;
+		std::shared_ptr<const PlaneMap> output_;
+
+		//! Owned by the thread calling Update.
+		int processed_version_ = 0;
+		std::vector<cv::Vec3d> points_;
+		std::vector<DetectedPlane> planes_;
+		cv::RNG rng_;
+
+		void FindCandidates(const DetectedPlane& plane, int plane_ind, const std::vector<int>& inliers,
+							const cv::Vec3d& down, std::vector<ScreenCandidate>& candidates) const;
+	};
+}
+
+#endif // !PLANEDETECTOR_H
@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+
+#include <common/ARUtils.h>
+#include <common/PoseDisambiguator.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	namespace {
+		//! Pose of a candidate with respect to the world coordinate, and its camera matrix.
+		struct CandidatePose {
+			SE3 pose;
+			Matx34d P;
+		};
+
+		inline CandidatePose ComposeCandidate(const SE3& relative, const Matx33d& K, const SE3& ref_pose) {
+			CandidatePose candidate;
+			candidate.pose = relative * ref_pose;
+			candidate.P = K * candidate.pose.Matrix();
+			return candidate;
+		}
+
+		//! With K = [... ; 0 0 1], the third coordinate of PX has the sign of the depth times X[3].
+		inline bool InFront(const Matx34d& P, const Vec4d& X) {
+			return (P * X)[2] * X[3] > 0;
+		}
+
+		//! Count the points of the subset in front of both cameras, giving up once
+		//	more than MAX_FAILURES points fail.
+		//	@return The number of points passed, or -1 if rejected.
+		int CheckCheirality(const Matx34d& P_ref, const Matx34d& P,
+							const Mat& ref_pts, const Mat& pts, const int* subset, int subset_size) {
+			int failures = 0;
+			for (int k = 0; k < subset_size; ++k) {
+				const float* x1 = ref_pts.ptr<float>(subset[k]);
+				const float* x2 = pts.ptr<float>(subset[k]);
+				Vec4d X = TriangulatePoint(P_ref, P, Point2f(x1[0], x1[1]), Point2f(x2[0], x2[1]));
+				if (!InFront(P_ref, X) || !InFront(P, X))
+					if (++failures > PoseDisambiguator::MAX_FAILURES)
+						return -1;
+			}
+			return subset_size - failures;
+		}
+	}
+
+	ERROR_CODE PoseDisambiguator::Disambiguate(const SE3* candidates, int num_candidates,
+											   const Matx33d& K,
+											   const SE3& ref_pose,
+											   pair<Mat, Mat>* views, int num_views,
+											   const pair<int, int>& keyframe_pair,
+											   const double* ref_depths, double ref_average_depth,
+											   Result& result) {
+		if (num_candidates <= 0 || num_views < 2 || K(2, 2) == 0)
+			return AR_INVALID_INPUT;
+		const Mat& ref_pts = views[0].second;
+		const Mat& pts = views[num_views - 1].second;
+		if (ref_pts.rows != pts.rows || pts.rows == 0)
+			return AR_INVALID_INPUT;
+
+		Matx34d P_ref = views[0].first;
+
+		// Sample the subset with a fixed seed, so that the same input always gives the same winner.
+		int subset[SUBSET_SIZE];
+		int subset_size = min(int(SUBSET_SIZE), pts.rows);
+		RNG rng(0x2545F491u ^ unsigned(pts.rows));
+		for (int k = 0; k < subset_size; ++k) {
+			int ind;
+			do
+				ind = rng.uniform(0, pts.rows);
+			while (find(subset, subset + k, ind) != subset + k);
+			subset[k] = ind;
+		}
+
+		int winner = -1;
+		CandidatePose winner_pose;
+		// The last winner is usually still valid while the keyframe pair stays the same.
+		if (keyframe_pair == cached_keyframe_pair_ && cached_candidate_ >= 0 &&
+			cached_candidate_ < num_candidates) {
+			auto pose = ComposeCandidate(candidates[cached_candidate_], K, ref_pose);
+			if (CheckCheirality(P_ref, pose.P, ref_pts, pts, subset, subset_size) == subset_size) {
+				winner = cached_candidate_;
+				winner_pose = pose;
+			}
+		}
+
+		if (winner < 0) {
+			vector<CandidatePose> poses(num_candidates);
+			vector<int> scores(num_candidates, -1);
+			ParallelFor(pool_, 0, num_candidates, [&](int begin, int end) {
+				for (int i = begin; i < end; ++i) {
+					poses[i] = ComposeCandidate(candidates[i], K, ref_pose);
+					scores[i] = CheckCheirality(P_ref, poses[i].P, ref_pts, pts, subset, subset_size);
+				}
+			});
+			for (int i = 0; i < num_candidates; ++i)
+				if (scores[i] >= 0 && (winner < 0 || scores[i] > scores[winner]))
+					winner = i;
+			if (winner < 0)
+				return AR_INVALID_INPUT;
+			winner_pose = poses[winner];
+		}
+		cached_keyframe_pair_ = keyframe_pair;
+		cached_candidate_ = winner;
+
+		// Scale the winner to the map, from the depths of the points in the reference
+		// keyframe as triangulated from the two views with the unit translation.
+		vector<double> ratios;
+		double depth_sum = 0;
+		int depth_cnt = 0;
+		for (int k = 0; k < pts.rows; ++k) {
+			const float* x1 = ref_pts.ptr<float>(k);
+			const float* x2 = pts.ptr<float>(k);
+			Vec4d X = TriangulatePoint(P_ref, winner_pose.P, Point2f(x1[0], x1[1]), Point2f(x2[0], x2[1]));
+			if (X[3] == 0)
+				continue;
+			double depth = (ref_pose * Vec3d(X[0] / X[3], X[1] / X[3], X[2] / X[3]))[2];
+			if (depth <= 0)
+				continue;
+			depth_sum += depth;
+			++depth_cnt;
+			if (ref_depths && ref_depths[k] > 0)
+				ratios.push_back(ref_depths[k] / depth);
+		}
+		if (!depth_cnt)
+			return AR_INVALID_INPUT;
+		double scale;
+		if (int(ratios.size()) >= MIN_SCALE_POINTS) {
+			nth_element(ratios.begin(), ratios.begin() + ratios.size() / 2, ratios.end());
+			scale = ratios[ratios.size() / 2];
+		}
+		else
+			scale = (ref_average_depth > 0 ? ref_average_depth : 1) / (depth_sum / depth_cnt);
+		SE3 relative = candidates[winner];
+		relative.t *= scale;
+		winner_pose = ComposeCandidate(relative, K, ref_pose);
+
+		// Triangulate all the points with the winner only.
+		Mat& P = views[num_views - 1].first;
+		P.create(3, 4, CV_64F);
+		*P.ptr<Matx34d>() = winner_pose.P;
+		ERROR_CODE ret = triangulate(views, num_views, result.points3d, &result.error);
+		if (ret != AR_SUCCESS)
+			return ret;
+
+		result.candidate = winner;
+		result.scale = scale;
+		result.R = winner_pose.pose.R;
+		result.t = winner_pose.pose.t;
+		double cur_depth_sum = 0, ref_depth_sum = 0;
+		for (int k = 0; k < result.points3d.rows; ++k) {
+			Vec3d X(result.points3d.ptr<double>(k));
+			cur_depth_sum += (winner_pose.pose * X)[2];
+			ref_depth_sum += (ref_pose * X)[2];
+		}
+		result.average_depth = cur_depth_sum / result.points3d.rows;
+		result.ref_average_depth = ref_depth_sum / result.points3d.rows;
+		return AR_SUCCESS;
+	}
+}
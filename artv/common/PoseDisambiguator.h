@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef POSEDISAMBIGUATOR_H
+#define POSEDISAMBIGUATOR_H
+
+#include <utility>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <common/ErrorCodes.h>
+#include <common/Geometry.h>
+#include <common/WorkerPool.h>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	//! The class PoseDisambiguator picks the valid one among the four [R|t] candidates
+	//	recovered from an essential matrix. Only a few random points are triangulated for
+	//	each candidate to check that they lie in front of both cameras, and a candidate
+	//	is dropped as soon as it fails on too many of them. The candidates are checked in
+	//	parallel, and only the winner is triangulated with all the points and views.
+	//	The candidates have unit translations, so the winner is scaled to the map first:
+	//	by the median ratio of the depths the points have in the map to those they get
+	//	from the two views, or so that the reference keyframe keeps its average depth if
+	//	too few points are in the map. The depth of the first keyframe is 1.
+	class COMMON_API PoseDisambiguator {
+	public:
+		//! Number of points checked for the cheirality of each candidate.
+		static const int SUBSET_SIZE = 8;
+		//! A candidate is rejected once this many points of the subset are behind a camera.
+		static const int MAX_FAILURES = 2;
+		//! Fewest points in the map the scale is taken from.
+		static const int MIN_SCALE_POINTS = 8;
+
+		struct Result {
+			//! Index of the winner among the candidates.
+			int candidate = -1;
+			//! Rotation and translation of the current camera with respect to the world coordinate.
+			cv::Matx33d R;
+			cv::Vec3d t;
+			//! Points triangulated from all the views, one per row, of type CV_64F.
+			cv::Mat points3d;
+			//! Mean reprojection error of points3d in pixels.
+			double error = 0;
+			//! Average depth of points3d in the current camera.
+			double average_depth = 0;
+			//! Average depth of points3d in the reference keyframe.
+			double ref_average_depth = 0;
+			//! Scale applied to the unit translation of the winner.
+			double scale = 1;
+		};
+
+		//! Pick the valid candidate of the current camera relative to the reference keyframe.
+		//	@param candidates The candidates given by RecoverRotAndTranslation.
+		//	@param intrinsics Intrinsics of the current camera.
+		//	@param ref_pose Rotation and translation of the reference keyframe.
+		//	@param views Camera matrices and 2D points of each view, with the reference keyframe first
+		//	and the current frame last. The camera matrix of the current frame is filled on success.
+		//	@param keyframe_pair Frame IDs of the keyframes the views come from. While it does
+		//	not change, the last winner is checked first and accepted alone if it passes.
+		//	@param ref_depths Depth of each point in the reference keyframe from the map, or 0
+		//	where the point is not in the map yet. May be NULL.
+		//	@param ref_average_depth Average depth of the reference keyframe, or 0 if unknown.
+		ERROR_CODE Disambiguate(const SE3* candidates, int num_candidates,
+								const cv::Matx33d& intrinsics,
+								const SE3& ref_pose,
+								std::pair<cv::Mat, cv::Mat>* views, int num_views,
+								const std::pair<int, int>& keyframe_pair,
+								const double* ref_depths, double ref_average_depth,
+								Result& result);
+		//! Check the candidates on a pool instead of with cv::parallel_for_.
+		inline void SetWorkerPool(WorkerPool* pool) { pool_ = pool; }
+
+	private:
+		WorkerPool* pool_ = NULL;
+		std::pair<int, int> cached_keyframe_pair_ = std::make_pair(-1, -1);
+		int cached_candidate_ = -1;
+	};
+}
+
+#endif // !POSEDISAMBIGUATOR_H
@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <common/Geometry.h>
+#include <common/PosePredictor.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar
+{
+	namespace {
+		const int MAX_GYRO_SAMPLES = 1024;
+
+		inline double Seconds(PosePredictor::TimePoint from, PosePredictor::TimePoint to) {
+			return chrono::duration<double>(to - from).count();
+		}
+	}
+
+	void PosePredictor::AddPose(TimePoint time, const Matx33d& R, const Vec3d& t) {
+		lock_guard<mutex> lock(mutex_);
+		if (num_poses_ && time <= poses_[1].time) {
+			// A pose of the same time only corrects the latest one.
+			if (time == poses_[1].time) {
+				poses_[1].R = R;
+				poses_[1].t = t;
+			}
+			return;
+		}
+		poses_[0] = poses_[1];
+		poses_[1] = { time, R, t };
+		num_poses_ = min(num_poses_ + 1, 2);
+		if (num_poses_ == 2) {
+			double dt = Seconds(poses_[0].time, poses_[1].time);
+			Matx33d dR = poses_[1].R * poses_[0].R.t();
+			rotation_rate_ = LogSO3(dR) / dt;
+			// The camera center moves by t1 - dR * t0 in the coordinate of the latest camera.
+			translation_rate_ = (poses_[1].t - dR * poses_[0].t) / dt;
+		}
+		// Gyroscope samples long before the pose won't be needed again.
+		while (!gyro_samples_.empty() && gyro_samples_.front().shot_time < time - chrono::seconds(1))
+			gyro_samples_.pop_front();
+	}
+
+	void PosePredictor::AddMotionData(const MotionData& data) {
+		lock_guard<mutex> lock(mutex_);
+		if (!gyro_samples_.empty() && data.shot_time < gyro_samples_.back().shot_time)
+			return;
+		gyro_samples_.push_back(data);
+		if (gyro_samples_.size() > MAX_GYRO_SAMPLES)
+			gyro_samples_.pop_front();
+	}
+
+	void PosePredictor::Reset() {
+		lock_guard<mutex> lock(mutex_);
+		num_poses_ = 0;
+		gyro_samples_.clear();
+	}
+
+	bool PosePredictor::IntegrateGyro(TimePoint from, TimePoint to, Matx33d& R) const {
+		if (gyro_samples_.empty() || gyro_samples_.back().shot_time < from - chrono::milliseconds(MAX_GYRO_GAP_MS))
+			return false;
+		// Each sample holds until the next one. Before the first sample in the range, the
+		// first sample is used. Rotating by w for dt maps the camera coordinate by exp(-w * dt).
+		R = Matx33d::eye();
+		TimePoint cur = from;
+		Vec3d w;
+		bool has_w = false;
+		for (auto& sample : gyro_samples_) {
+			if (sample.shot_time <= cur) {
+				w = sample.angular_velocity;
+				has_w = true;
+				continue;
+			}
+			if (sample.shot_time >= to)
+				break;
+			if (!has_w)
+				w = sample.angular_velocity;
+			R = ExpSO3(-w * Seconds(cur, sample.shot_time)) * R;
+			cur = sample.shot_time;
+			w = sample.angular_velocity;
+			has_w = true;
+		}
+		if (!has_w)
+			w = gyro_samples_.front().angular_velocity;
+		R = ExpSO3(-w * Seconds(cur, to)) * R;
+		return true;
+	}
+
+	bool PosePredictor::Predict(TimePoint time, Matx33d& R, Vec3d& t) const {
+		lock_guard<mutex> lock(mutex_);
+		if (!num_poses_)
+			return false;
+		auto& last = poses_[1];
+		Matx33d dR;
+		Vec3d dt(0, 0, 0);
+		if (!IntegrateGyro(last.time, time, dR)) {
+			if (num_poses_ < 2) {
+				R = last.R;
+				t = last.t;
+				return true;
+			}
+			dR = ExpSO3(rotation_rate_ * Seconds(last.time, time));
+		}
+		if (num_poses_ == 2)
+			dt = translation_rate_ * Seconds(last.time, time);
+		R = dR * last.R;
+		t = dR * last.t + dt;
+		return true;
+	}
+
+	bool PosePredictor::PredictRotation(TimePoint from, TimePoint to, Matx33d& R) const {
+		lock_guard<mutex> lock(mutex_);
+		if (IntegrateGyro(from, to, R))
+			return true;
+		if (num_poses_ < 2)
+			return false;
+		R = ExpSO3(rotation_rate_ * Seconds(from, to));
+		return true;
+	}
+}
@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef POSEPREDICTOR_H
+#define POSEPREDICTOR_H
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <opencv2/core.hpp>
+
+#include <common/ARUtils.h>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	//! The class PosePredictor extrapolates the camera pose to a later time, such as the
+	//	time a frame is displayed. The camera is assumed to keep the velocity between the
+	//	last two estimated poses. Gyroscope samples, when given, replace the assumption
+	//	for the rotation, which is the main cause of visible lag. Poses are rotations and
+	//	translations from the world coordinate to the camera coordinate.
+	//	It is thread-safe, so poses can be added by tracking while rendering predicts.
+	class COMMON_API PosePredictor {
+	public:
+		typedef std::chrono::steady_clock::time_point TimePoint;
+		//! Gyroscope samples older than this before a prediction are not used.
+		static const int MAX_GYRO_GAP_MS = 100;
+
+		void AddPose(TimePoint time, const cv::Matx33d& R, const cv::Vec3d& t);
+		void AddMotionData(const MotionData& data);
+		void Reset();
+
+		//! Predict the pose at a time.
+		//	@return False if no pose has been added.
+		bool Predict(TimePoint time, cv::Matx33d& R, cv::Vec3d& t) const;
+		//! Predict the rotation of the camera between two times, mapping the camera
+		//	coordinate at the first time to the camera coordinate at the second.
+		//	@return False if neither poses nor gyroscope samples are available.
+		bool PredictRotation(TimePoint from, TimePoint to, cv::Matx33d& R) const;
+
+	private:
+		struct Pose {
+			TimePoint time;
+			cv::Matx33d R;
+			cv::Vec3d t;
+		};
+		mutable std::mutex mutex_;
+		int num_poses_ = 0;
+		//! The last two poses, the latest last.
+		Pose poses_[2];
+		//! Rotation vector per second in the camera coordinate, and translation per second,
+		//	between the last two poses.
+		cv::Vec3d rotation_rate_;
+		cv::Vec3d translation_rate_;
+		std::deque<MotionData> gyro_samples_;
+
+		bool IntegrateGyro(TimePoint from, TimePoint to, cv::Matx33d& R) const;
+	};
+}
+
+#endif // !POSEPREDICTOR_H
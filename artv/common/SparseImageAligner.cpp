@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cfloat>
+
+#include <common/SparseImageAligner.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	namespace {
+		const int AREA = SparseImageAligner::PATCH_SIZE * SparseImageAligner::PATCH_SIZE;
+		//! Patches are sampled at these offsets from their centers, and their gradients
+		//	one pixel further, with one more for the bilinear interpolation.
+		const float HALF_PATCH = (SparseImageAligner::PATCH_SIZE - 1) * 0.5f;
+		const float BORDER = HALF_PATCH + 2;
+		//! Fewest points a level is aligned with, below which the motion is not constrained.
+		const int MIN_LEVEL_POINTS = 6;
+
+		//! Project a point in the camera coordinate into a level of the pyramid.
+		inline Point2f ProjectToLevel(const CameraModel& camera, const Vec3d& x, float scale) {
+			const Matx33d& K = camera.K();
+			Point2f pt(float(K(0, 0) * x[0] / x[2] + K(0, 2)), float(K(1, 1) * x[1] / x[2] + K(1, 2)));
+			if (camera.HasDistortion())
+				pt = camera.DistortPixel(pt);
+			// Pixel centers of a level are at the centers of the blocks they average.
+			return Point2f((pt.x + 0.5f) * scale - 0.5f, (pt.y + 0.5f) * scale - 0.5f);
+		}
+
+		inline bool PatchInside(const Mat& image, const Point2f& pt) {
+			return pt.x >= BORDER && pt.y >= BORDER && pt.x < image.cols - BORDER && pt.y < image.rows - BORDER;
+		}
+
+		inline float Sample(const Mat& image, float x, float y) {
+			int x0 = cvFloor(x), y0 = cvFloor(y);
+			float ax = x - x0, ay = y - y0;
+			const uchar* p = image.ptr<uchar>(y0) + x0;
+			size_t step = image.step;
+			return (1 - ay) * ((1 - ax) * p[0] + ax * p[1]) + ay * ((1 - ax) * p[step] + ax * p[step + 1]);
+		}
+	}
+
+	SparseImageAligner::SparseImageAligner(const SparseAlignOptions& options) : options_(options) {}
+
+	void SparseImageAligner::Reset() {
+		reference_size_ = Size();
+	}
+
+	void SparseImageAligner::SetReference(const FramePyramid& pyramid) {
+		reference_size_ = pyramid.GetSize();
+		reference_.resize(pyramid.NumLevels());
+		for (int level = 0; level < pyramid.NumLevels(); ++level)
+			if (level >= options_.min_level && level <= options_.max_level)
+				pyramid.Level(level).copyTo(reference_[level]);
+	}
+
+	int SparseImageAligner::AlignLevel(int level, const Mat& image, const CameraModel& camera,
+									   const vector<Vec3d>& points, SE3& motion) {
+		const Mat& reference = reference_[level];
+		const Matx33d& K = camera.K();
+		float scale = float(1 / FramePyramid::Scale(level));
+		int n = int(points.size());
+		ref_patches_.resize(n * AREA);
+		jacobians_.resize(n * AREA);
+		visible_.assign(n, 0);
+
+		// The reference patches and their Jacobians, at the identity motion.
+		for (int i = 0; i < n; ++i) {
+			const Vec3d& x = points[i];
+			if (x[2] <= 0)
+				continue;
+			Point2f center = ProjectToLevel(camera, x, scale);
+			if (!PatchInside(reference, center))
+				continue;
+			visible_[i] = 1;
+			double z_inv = 1 / x[2], z_inv2 = z_inv * z_inv;
+			double fx = K(0, 0) * scale, fy = K(1, 1) * scale;
+			// Derivative of the pixel with respect to a twist (rho, phi) moving the point.
+			Vec6d du(fx * z_inv, 0, -fx * x[0] * z_inv2,
+					 -fx * x[0] * x[1] * z_inv2, fx * (1 + x[0] * x[0] * z_inv2), -fx * x[1] * z_inv);
+			Vec6d dv(0, fy * z_inv, -fy * x[1] * z_inv2,
+					 -fy * (1 + x[1] * x[1] * z_inv2), fy * x[0] * x[1] * z_inv2, fy * x[0] * z_inv);
+			float* patch = &ref_patches_[i * AREA];
+			Vec6d* jacobian = &jacobians_[i * AREA];
+			for (int r = 0; r < PATCH_SIZE; ++r) {
+				float y = center.y - HALF_PATCH + r;
+				for (int c = 0; c < PATCH_SIZE; ++c) {
+					float x = center.x - HALF_PATCH + c;
+					float gx = (Sample(reference, x + 1, y) - Sample(reference, x - 1, y)) * 0.5f;
+					float gy = (Sample(reference, x, y + 1) - Sample(reference, x, y - 1)) * 0.5f;
+					patch[r * PATCH_SIZE + c] = Sample(reference, x, y);
+					jacobian[r * PATCH_SIZE + c] = du * gx + dv * gy;
+				}
+			}
+		}
+
+		double last_chi2 = DBL_MAX;
+		SE3 last_motion = motion;
+		int num_points = 0;
+		for (int iter = 0; iter < options_.max_iterations; ++iter) {
+			Matx66d H = Matx66d::zeros();
+			Vec6d b(0, 0, 0, 0, 0, 0);
+			double chi2 = 0;
+			num_points = 0;
+			for (int i = 0; i < n; ++i) {
+				if (!visible_[i])
+					continue;
+				Vec3d x = motion * points[i];
+				if (x[2] <= 0)
+					continue;
+				Point2f center = ProjectToLevel(camera, x, scale);
+				if (!PatchInside(image, center))
+					continue;
+				++num_points;
+				const float* patch = &ref_patches_[i * AREA];
+				const Vec6d* jacobian = &jacobians_[i * AREA];
+				for (int r = 0; r < PATCH_SIZE; ++r) {
+					float y = center.y - HALF_PATCH + r;
+					for (int c = 0; c < PATCH_SIZE; ++c) {
+						int k = r * PATCH_SIZE + c;
+						double residual = Sample(image, center.x - HALF_PATCH + c, y) - patch[k];
+						double abs_residual = abs(residual);
+						double weight = abs_residual <= options_.huber_threshold ? 1 : options_.huber_threshold / abs_residual;
+						const Vec6d& J = jacobian[k];
+						H += (J * weight) * J.t();
+						b += J * (weight * residual);
+						chi2 += weight * residual * residual;
+					}
+				}
+			}
+			if (num_points < MIN_LEVEL_POINTS)
+				return num_points;
+			chi2 /= num_points;
+			// The error went up, so the last step overshot.
+			if (chi2 > last_chi2) {
+				motion = last_motion;
+				break;
+			}
+			Vec6d delta = H.solve(b, DECOMP_CHOLESKY);
+			last_chi2 = chi2;
+			last_motion = motion;
+			// The step warps the reference, so the motion takes its inverse.
+			motion = motion * ExpSE3(delta).Inverse();
+			if (norm(delta) < options_.min_update)
+				break;
+		}
+		return num_points;
+	}
+
+	int SparseImageAligner::Align(const FramePyramid& pyramid, const CameraModel& camera,
+								  const vector<Vec3d>& points, SE3& motion, vector<float>& errors) {
+		errors.assign(points.size(), -1);
+		if (!HasReference() || pyramid.GetSize() != reference_size_ || !camera.IsValid())
+			return 0;
+		int max_level = min(options_.max_level, min(pyramid.NumLevels(), int(reference_.size())) - 1);
+		int min_level = max(0, min(options_.min_level, max_level));
+		if (reference_[min_level].empty())
+			return 0;
+
+		SE3 estimate = motion;
+		for (int level = max_level; level >= min_level; --level)
+			if (AlignLevel(level, pyramid.Level(level), camera, points, estimate) < MIN_LEVEL_POINTS)
+				return 0;
+
+		// The errors of the patches at the finest level, with the final motion.
+		const Mat& image = pyramid.Level(min_level);
+		float scale = float(1 / FramePyramid::Scale(min_level));
+		int num_aligned = 0;
+		for (int i = 0; i < points.size(); ++i) {
+			if (!visible_[i])
+				continue;
+			Vec3d x = estimate * points[i];
+			if (x[2] <= 0)
+				continue;
+			Point2f center = ProjectToLevel(camera, x, scale);
+			if (!PatchInside(image, center))
+				continue;
+			const float* patch = &ref_patches_[i * AREA];
+			float sum = 0;
+			for (int r = 0; r < PATCH_SIZE; ++r)
+				for (int c = 0; c < PATCH_SIZE; ++c)
+					sum += abs(Sample(image, center.x - HALF_PATCH + c, center.y - HALF_PATCH + r) - patch[r * PATCH_SIZE + c]);
+			errors[i] = sum / AREA;
+			++num_aligned;
+		}
+		motion = estimate;
+		return num_aligned;
+	}
+}
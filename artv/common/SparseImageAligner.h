@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef SPARSEIMAGEALIGNER_H
+#define SPARSEIMAGEALIGNER_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <common/CameraModel.h>
+#include <common/FramePyramid.h>
+#include <common/Geometry.h>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	struct SparseAlignOptions {
+		//! Coarsest and finest pyramid levels aligned. Level 0 is left out, as the pose
+		//	only has to be good enough to find the landmarks again.
+		int max_level = 3;
+		int min_level = 1;
+		int max_iterations = 10;
+		//! A level is aligned once the norm of the update of the twist is below this.
+		double min_update = 1e-5;
+		//! Residuals in gray levels beyond which the Huber weight falls off, so that the
+		//	patches of occluded landmarks pull less.
+		double huber_threshold = 10;
+		//! Most landmarks aligned, those of the smallest reprojection errors first.
+		int max_points = 150;
+		//! Fewest landmarks aligned for the pose to be taken.
+		int min_points = 30;
+		//! Landmarks whose patch still differs by more than this mean absolute error in
+		//	gray levels after the alignment are not observed in the frame.
+		double max_patch_error = 12;
+	};
+
+	//! The class SparseImageAligner tracks the camera directly on the image, without
+	//	features. It finds the motion from a reference frame that minimizes the photometric
+	//	error of small patches around the projections of known 3D points, with the inverse
+	//	compositional Gauss-Newton method: the Jacobians are taken on the reference frame
+	//	once per level, so an iteration costs a pass over the patches of the new frame.
+	//	The levels are aligned from coarse to fine, each starting from the last.
+	//	The Jacobians ignore the lens distortion, which the patches are sampled through.
+	class COMMON_API SparseImageAligner {
+	public:
+		//! Side of the square patches, in pixels of the level aligned.
+		static const int PATCH_SIZE = 4;
+
+		SparseImageAligner(const SparseAlignOptions& options = SparseAlignOptions());
+		inline void SetOptions(const SparseAlignOptions& options) { options_ = options; }
+		inline const SparseAlignOptions& GetOptions() const { return options_; }
+
+		//! Keep the levels of a frame as the reference of the next alignment. They are
+		//	copied, as the pyramid is overwritten by the next frame.
+		void SetReference(const FramePyramid& pyramid);
+		inline bool HasReference() const { return !reference_size_.empty(); }
+		void Reset();
+
+		//! Find the motion of the camera from the reference frame to the frame of a pyramid.
+		//	@param points Points in the camera coordinate of the reference frame.
+		//	@param motion The motion x_cur = R x_ref + t, set to the initial guess on input.
+		//	@param errors Set to the mean absolute error of the patch of each point at the
+		//	finest level, or -1 where the patch is not inside both frames.
+		//	@return Number of points aligned at the finest level. 0 if the alignment failed,
+		//	and the motion is left as it was.
+		int Align(const FramePyramid& pyramid, const CameraModel& camera, const std::vector<cv::Vec3d>& points,
+				  SE3& motion, std::vector<float>& errors);
+
+	private:
+		SparseAlignOptions options_;
+		cv::Size reference_size_;
+		std::vector<cv::Mat> reference_;
+		//! Reference patches and their Jacobians with respect to the twist of the motion,
+		//	PATCH_SIZE^2 of each per point, for the level being aligned.
+		std::vector<float> ref_patches_;
+		std::vector<cv::Vec6d> jacobians_;
+		std::vector<char> visible_;
+
+		//! Align a level, starting from the motion given.
+		//	@return Number of points inside both frames at the last iteration.
+		int AlignLevel(int level, const cv::Mat& image, const CameraModel& camera,
+					   const std::vector<cv::Vec3d>& points, SE3& motion);
+	};
+}
+
+#endif // !SPARSEIMAGEALIGNER_H
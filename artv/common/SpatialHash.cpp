@@ -0,0 +1,39 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <cmath>
+
+#include <common/SpatialHash.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar
+{
+	void SpatialHash::Reset(double cell_size) {
+		CV_Assert(cell_size > 0);
+		cell_size_ = cell_size;
+		heads_.clear();
+		nodes_.clear();
+	}
+
+	int64_t SpatialHash::Key(const Point3d& pt) const {
+		// 21 bits per axis. Cells farther than a million from the origin wrap around, which
+		// only puts far apart points into the same bucket.
+		const int64_t MASK = (1 << 21) - 1;
+		int64_t x = int64_t(floor(pt.x / cell_size_)) & MASK;
+		int64_t y = int64_t(floor(pt.y / cell_size_)) & MASK;
+		int64_t z = int64_t(floor(pt.z / cell_size_)) & MASK;
+		return (x << 42) | (y << 21) | z;
+	}
+
+	void SpatialHash::Insert(const Point3d& pt, int value) {
+		auto result = heads_.insert({ Key(pt), int(nodes_.size()) });
+		int next = result.second ? -1 : result.first->second;
+		result.first->second = int(nodes_.size());
+		nodes_.push_back({ value, next });
+	}
+}
@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	//! The class SpatialHash buckets 3D points into cubic cells of a fixed size, so the
+	//	points near a location are found without visiting the others. The values of a
+	//	cell are chained through a node array, and the buffers keep their capacity across
+	//	resets, so rebuilding it on each frame allocates little.
+	class COMMON_API SpatialHash {
+	public:
+		//! Remove all the values, and set the size of the cells.
+		void Reset(double cell_size);
+		void Insert(const cv::Point3d& pt, int value);
+		//! Call f on each value in the cell of a point, the latest inserted first.
+		template<class F>
+		void ForEachInCell(const cv::Point3d& pt, F f) const {
+			auto it = heads_.find(Key(pt));
+			if (it == heads_.end())
+				return;
+			for (int node = it->second; node >= 0; node = nodes_[node].next)
+				f(nodes_[node].value);
+		}
+		inline double GetCellSize() const { return cell_size_; }
+		inline int Size() const { return int(nodes_.size()); }
+
+	private:
+		struct Node {
+			int value;
+			int next;
+		};
+		double cell_size_ = 1;
+		std::unordered_map<int64_t, int> heads_;
+		std::vector<Node> nodes_;
+
+		int64_t Key(const cv::Point3d& pt) const;
+	};
+}
+
+#endif // !SPATIALHASH_H
@@ -0,0 +1,333 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+
+#include <common/Geometry.h>
+#include <common/SyntheticScene.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	namespace {
+		const double NEAR_PLANE = 0.05;
+		const double GRAVITY = 9.81;
+
+		inline chrono::steady_clock::time_point TimePoint(chrono::steady_clock::time_point start_time, double seconds) {
+			return start_time + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+		}
+
+		//! Ease in and out between two waypoints, so that the camera has smooth velocity
+		//	and finite acceleration along the whole trajectory.
+		Point3d Interpolate(const vector<CameraWaypoint>& waypoints, double time, Point3d CameraWaypoint::* member) {
+			if (time <= waypoints.front().time)
+				return waypoints.front().*member;
+			if (time >= waypoints.back().time)
+				return waypoints.back().*member;
+			int i = 0;
+			while (waypoints[i + 1].time < time)
+				++i;
+			double s = (time - waypoints[i].time) / (waypoints[i + 1].time - waypoints[i].time);
+			s = (1 - cos(CV_PI * s)) / 2;
+			return waypoints[i].*member * (1 - s) + waypoints[i + 1].*member * s;
+		}
+
+		//! Clip a polygon in the camera coordinate to the part in front of the near plane.
+		vector<Vec3d> ClipNear(const vector<Vec3d>& polygon) {
+			vector<Vec3d> clipped;
+			for (size_t i = 0; i < polygon.size(); ++i) {
+				const Vec3d& a = polygon[i];
+				const Vec3d& b = polygon[(i + 1) % polygon.size()];
+				if (a[2] >= NEAR_PLANE)
+					clipped.push_back(a);
+				if ((a[2] >= NEAR_PLANE) != (b[2] >= NEAR_PLANE))
+					clipped.push_back(a + (b - a) * ((NEAR_PLANE - a[2]) / (b[2] - a[2])));
+			}
+			return clipped;
+		}
+	}
+
+	SyntheticScene::SyntheticScene(const Options& options) : options_(options), rng_(options.seed) {}
+
+	SyntheticScene SyntheticScene::CreateLivingRoom(const Options& options, double duration) {
+		SyntheticScene scene(options);
+		// Back wall and floor.
+		scene.AddPlane(Point3d(0, -0.75, 4), Vec3d(4, 0, 0), Vec3d(0, 1.75, 0));
+		scene.AddPlane(Point3d(0, 1, 2), Vec3d(4, 0, 0), Vec3d(0, 0, -2));
+		scene.AddTelevision(Point3d(0, -0.8, 3.95), Vec3d(0.8, 0, 0), Vec3d(0, 0.45, 0));
+		scene.AddBox(Point3d(2.2, 0.6, 2.8), Vec3d(0.4, 0.4, 0.4));
+		scene.SetTrajectory({
+			{ 0, Point3d(-1.2, -0.3, -1), Point3d(0, -0.6, 4) },
+			{ duration / 3, Point3d(0.2, -0.5, -0.6), Point3d(0.2, -0.7, 4) },
+			{ duration * 2 / 3, Point3d(1.2, -0.2, -1.2), Point3d(0.3, -0.5, 4) },
+			{ duration, Point3d(-0.5, -0.4, -0.8), Point3d(0, -0.7, 4) }
+		});
+		return scene;
+	}
+
+	Mat SyntheticScene::GenTexture(Size size) {
+		// Smooth color noise with sharp shapes on top, so that there are plenty of corners.
+		Mat coarse(size.height / 16 + 2, size.width / 16 + 2, CV_8UC3);
+		rng_.fill(coarse, RNG::UNIFORM, 0, 256);
+		Mat texture;
+		resize(coarse, texture, size, 0, 0, INTER_CUBIC);
+		int num_shapes = size.area() / 2048;
+		for (int i = 0; i < num_shapes; ++i) {
+			Scalar color(rng_.uniform(0, 256), rng_.uniform(0, 256), rng_.uniform(0, 256));
+			Point center(rng_.uniform(0, size.width), rng_.uniform(0, size.height));
+			int radius = rng_.uniform(3, max(4, min(size.width, size.height) / 12));
+			if (rng_.uniform(0, 2))
+				circle(texture, center, radius, color, FILLED);
+			else
+				rectangle(texture, center - Point(radius, radius), center + Point(radius, radius), color, FILLED);
+		}
+		return texture;
+	}
+
+	void SyntheticScene::AddQuad(const SyntheticQuad& quad) {
+		quads_.push_back(quad);
+	}
+
+	void SyntheticScene::AddPlane(const Point3d& center, const Vec3d& half_right, const Vec3d& half_down) {
+		SyntheticQuad quad;
+		Point3d r(half_right), d(half_down);
+		quad.corners[0] = center - r - d;
+		quad.corners[1] = center + r - d;
+		quad.corners[2] = center + r + d;
+		quad.corners[3] = center - r + d;
+		// Roughly 128 texels per meter.
+		quad.texture = GenTexture(Size(max(32, int(norm(half_right) * 256)), max(32, int(norm(half_down) * 256))));
+		AddQuad(quad);
+	}
+
+	void SyntheticScene::AddBox(const Point3d& center, const Vec3d& half_size) {
+		double hx = half_size[0], hy = half_size[1], hz = half_size[2];
+		// Outward normal offset, right and down vectors of each face seen from outside.
+		const Vec3d faces[6][3] = {
+			{ Vec3d(0, 0, -hz), Vec3d(hx, 0, 0), Vec3d(0, hy, 0) },
+			{ Vec3d(0, 0, hz), Vec3d(-hx, 0, 0), Vec3d(0, hy, 0) },
+			{ Vec3d(-hx, 0, 0), Vec3d(0, 0, -hz), Vec3d(0, hy, 0) },
+			{ Vec3d(hx, 0, 0), Vec3d(0, 0, hz), Vec3d(0, hy, 0) },
+			{ Vec3d(0, -hy, 0), Vec3d(hx, 0, 0), Vec3d(0, 0, -hz) },
+			{ Vec3d(0, hy, 0), Vec3d(hx, 0, 0), Vec3d(0, 0, hz) }
+		};
+		for (auto& face : faces)
+			AddPlane(center + Point3d(face[0]), face[1], face[2]);
+	}
+
+	void SyntheticScene::AddTelevision(const Point3d& center, const Vec3d& half_right, const Vec3d& half_down) {
+		Vec3d normal = half_right.cross(half_down);
+		normal /= norm(normal);
+
+		// The bezel is a flat dark frame slightly larger than the screen.
+		SyntheticQuad bezel;
+		Point3d r(half_right * 1.08), d(half_down * 1.12);
+		bezel.corners[0] = center - r - d;
+		bezel.corners[1] = center + r - d;
+		bezel.corners[2] = center + r + d;
+		bezel.corners[3] = center - r + d;
+		bezel.texture = Mat(8, 8, CV_8UC3, Scalar(60, 60, 60));
+		AddQuad(bezel);
+
+		// The screen is put a bit in front of the bezel so that it is always drawn later.
+		SyntheticQuad screen;
+		Point3d front = center - Point3d(normal * 0.01);
+		r = Point3d(half_right);
+		d = Point3d(half_down);
+		screen.corners[0] = front - r - d;
+		screen.corners[1] = front + r - d;
+		screen.corners[2] = front + r + d;
+		screen.corners[3] = front - r + d;
+		screen.texture = Mat(8, 8, CV_8UC3, Scalar(20, 20, 20));
+		AddQuad(screen);
+		screens_.push_back(screen);
+	}
+
+	void SyntheticScene::SetTrajectory(const vector<CameraWaypoint>& waypoints) {
+		waypoints_ = waypoints;
+		sort(waypoints_.begin(), waypoints_.end(),
+			 [](const CameraWaypoint& a, const CameraWaypoint& b) { return a.time < b.time; });
+	}
+
+	Mat SyntheticScene::Intrinsics() const {
+		return (Mat_<double>(3, 3) << options_.focal_length, 0, options_.frame_size.width / 2.,
+									  0, options_.focal_length, options_.frame_size.height / 2.,
+									  0, 0, 1);
+	}
+
+	int SyntheticScene::FrameCount() const {
+		if (waypoints_.empty())
+			return 0;
+		return int((waypoints_.back().time - waypoints_.front().time) * options_.fps) + 1;
+	}
+
+	double SyntheticScene::FrameTime(int frame_id) const {
+		return waypoints_.front().time + frame_id / options_.fps;
+	}
+
+	Point3d SyntheticScene::GetPosition(double time) const {
+		return Interpolate(waypoints_, time, &CameraWaypoint::position);
+	}
+
+	void SyntheticScene::GetPose(double time, Matx33d& R, Vec3d& t) const {
+		Vec3d position(GetPosition(time));
+		Vec3d forward(Interpolate(waypoints_, time, &CameraWaypoint::look_at) - GetPosition(time));
+		forward /= norm(forward);
+		Vec3d down(0, 1, 0);
+		if (abs(forward.dot(down)) > 0.99)
+			down = Vec3d(0, 0, 1);
+		Vec3d right = down.cross(forward);
+		right /= norm(right);
+		down = forward.cross(right);
+
+		R = Matx33d(right[0], right[1], right[2],
+					down[0], down[1], down[2],
+					forward[0], forward[1], forward[2]);
+		t = -(R * position);
+	}
+
+	void SyntheticScene::DrawQuad(const SyntheticQuad& quad, const Matx33d& R, const Vec3d& t, Mat& image) const {
+		Vec3d c0 = R * Vec3d(quad.corners[0]) + t;
+		Vec3d u = R * Vec3d(quad.corners[1] - quad.corners[0]);
+		Vec3d v = R * Vec3d(quad.corners[3] - quad.corners[0]);
+		// Back-face culling. The right-down normal points away from the viewer.
+		if (u.cross(v).dot(c0) >= 0)
+			return;
+
+		vector<Vec3d> polygon = ClipNear({ c0, c0 + u, c0 + u + v, c0 + v });
+		if (polygon.size() < 3)
+			return;
+		Matx33d K = Intrinsics();
+		vector<Point2f> projected;
+		for (auto& p : polygon) {
+			Vec3d q = K * p;
+			projected.emplace_back(float(q[0] / q[2]), float(q[1] / q[2]));
+		}
+		Rect roi = boundingRect(projected) & Rect(Point(0, 0), image.size());
+		if (roi.area() == 0)
+			return;
+
+		// Homography from the texture to the region of interest.
+		Matx33d plane_to_cam(u[0], v[0], c0[0],
+							 u[1], v[1], c0[1],
+							 u[2], v[2], c0[2]);
+		Matx33d texture_scale(1. / quad.texture.cols, 0, 0,
+							  0, 1. / quad.texture.rows, 0,
+							  0, 0, 1);
+		Matx33d to_roi(1, 0, -roi.x,
+					   0, 1, -roi.y,
+					   0, 0, 1);
+		Mat patch;
+		warpPerspective(quad.texture, patch, Mat(to_roi * K * plane_to_cam * texture_scale), roi.size(),
+						INTER_LINEAR, BORDER_REPLICATE);
+
+		const int shift = 4;
+		vector<Point> mask_polygon;
+		for (auto& p : projected)
+			mask_polygon.emplace_back(cvRound((p.x - roi.x) * (1 << shift)), cvRound((p.y - roi.y) * (1 << shift)));
+		Mat mask = Mat::zeros(roi.size(), CV_8U);
+		fillConvexPoly(mask, mask_polygon, Scalar(255), LINE_AA, shift);
+		patch.copyTo(image(roi), mask);
+	}
+
+	void SyntheticScene::SimulateMotion(int frame_id, vector<MotionData>& motion) const {
+		motion.clear();
+		if (options_.motion_rate <= 0)
+			return;
+		// Noise is seeded per frame, so that frames can be rendered in any order.
+		RNG rng(options_.seed ^ (unsigned(frame_id) * 2654435761u));
+		const double delta = 1e-3;
+		double start = FrameTime(frame_id - 1);
+		double end = FrameTime(frame_id);
+		for (double time = start + 1 / options_.motion_rate; time <= end + 1e-9; time += 1 / options_.motion_rate) {
+			Matx33d R0, R1;
+			Vec3d t0, t1;
+			GetPose(time, R0, t0);
+			GetPose(time + delta, R1, t1);
+			Vec3d rvec = LogSO3(R0 * R1.t());
+
+			Point3d accel = (GetPosition(time + delta) - GetPosition(time) * 2 + GetPosition(time - delta)) * (1 / (delta * delta));
+
+			MotionData data;
+			data.shot_time = TimePoint(options_.start_time, time);
+			data.angular_velocity = rvec / delta;
+			data.acceleration = R0 * Vec3d(accel.x, accel.y - GRAVITY, accel.z);
+			for (int i = 0; i < 3; ++i) {
+				data.angular_velocity[i] += rng.gaussian(options_.gyro_noise);
+				data.acceleration[i] += rng.gaussian(options_.accel_noise);
+			}
+			motion.push_back(data);
+		}
+	}
+
+	ERROR_CODE SyntheticScene::Render(int frame_id, SyntheticFrame& frame) const {
+		if (frame_id < 0 || frame_id >= FrameCount())
+			return AR_NO_MORE_FRAMES;
+
+		double time = FrameTime(frame_id);
+		frame.frame_id = frame_id;
+		frame.shot_time = TimePoint(options_.start_time, time);
+		GetPose(time, frame.R, frame.t);
+		frame.image = Mat(options_.frame_size, CV_8UC3, Scalar(90, 90, 90));
+
+		// Painter's algorithm: draw from the farthest quad to the nearest one.
+		Point3d position = GetPosition(time);
+		vector<pair<double, int>> order;
+		order.reserve(quads_.size());
+		for (int i = 0; i < quads_.size(); ++i) {
+			auto& c = quads_[i].corners;
+			order.push_back({ -norm((c[0] + c[1] + c[2] + c[3]) * 0.25 - position), i });
+		}
+		sort(order.begin(), order.end());
+		for (auto& o : order)
+			DrawQuad(quads_[o.second], frame.R, frame.t, frame.image);
+
+		Matx33d K = Intrinsics();
+		frame.tv_corners.clear();
+		for (auto& screen : screens_) {
+			vector<Point2f> corners;
+			for (auto& corner : screen.corners) {
+				Vec3d p = K * (frame.R * Vec3d(corner) + frame.t);
+				if (p[2] < NEAR_PLANE)
+					break;
+				corners.emplace_back(float(p[0] / p[2]), float(p[1] / p[2]));
+			}
+			frame.tv_corners.push_back(corners.size() == 4 ? corners : vector<Point2f>());
+		}
+
+		SimulateMotion(frame_id, frame.motion);
+		return AR_SUCCESS;
+	}
+
+	ERROR_CODE SyntheticScene::RenderBatch(int first_frame_id, int count, vector<SyntheticFrame>& frames) const {
+		count = min(count, FrameCount() - first_frame_id);
+		if (first_frame_id < 0 || count <= 0)
+			return AR_NO_MORE_FRAMES;
+		frames.resize(count);
+		parallel_for_(Range(0, count), [&](const Range& range) {
+			for (int i = range.start; i < range.end; ++i)
+				Render(first_frame_id + i, frames[i]);
+		});
+		return AR_SUCCESS;
+	}
+
+	SyntheticSceneStream::SyntheticSceneStream(shared_ptr<const SyntheticScene> scene, int batch_size) :
+		scene_(scene),
+		batch_size_(batch_size > 0 ? batch_size : max(1, getNumThreads() * 2)) {}
+
+	ERROR_CODE SyntheticSceneStream::NextFrame(Mat& output_buf) {
+		if (batch_pos_ >= batch_.size()) {
+			ERROR_CODE ret = scene_->RenderBatch(next_frame_id_, batch_size_, batch_);
+			if (ret < 0)
+				return ret;
+			next_frame_id_ += int(batch_.size());
+			batch_pos_ = 0;
+		}
+		output_buf = batch_[batch_pos_++].image;
+		return AR_SUCCESS;
+	}
+}
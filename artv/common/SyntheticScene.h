@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef SYNTHETICSCENE_H
+#define SYNTHETICSCENE_H
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include <common/ErrorCodes.h>
+#include <common/ARUtils.h>
+#include <common/CVUtils.h>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	//! A textured planar patch in the synthetic world. The corners are ordered
+	//	left-upper, right-upper, right-lower, left-lower as seen from the front, and
+	//	the texture is stretched over them.
+	struct COMMON_API SyntheticQuad {
+		cv::Point3d corners[4];
+		cv::Mat texture;
+	};
+
+	//! A waypoint of the scripted camera trajectory. Time is in seconds. The camera
+	//	moves smoothly between the waypoints, looking at the interpolated target.
+	struct COMMON_API CameraWaypoint {
+		double time;
+		cv::Point3d position;
+		cv::Point3d look_at;
+	};
+
+	//! A rendered frame together with its ground truth.
+	struct COMMON_API SyntheticFrame {
+		int frame_id = -1;
+		std::chrono::steady_clock::time_point shot_time;
+		cv::Mat image;
+		//! Rotation of the camera with respect to the world coordinate (x_cam = R * x_world + t).
+		cv::Matx33d R;
+		//! Translation of the camera with respect to the world coordinate.
+		cv::Vec3d t;
+		//! Corners of the television screens in the image, in the order of SyntheticQuad.
+		//	A television partially behind the camera has no corners here.
+		std::vector<std::vector<cv::Point2f>> tv_corners;
+		//! Simulated motion sensor samples collected since the previous frame.
+		std::vector<MotionData> motion;
+	};
+
+	//! Options of a SyntheticScene.
+	struct SyntheticSceneOptions {
+		cv::Size frame_size = cv::Size(640, 480);
+		//! Focal length in pixels. The principal point is at the image center.
+		double focal_length = 525;
+		double fps = 30;
+		//! Rate of the simulated motion sensors in Hz. Zero disables them.
+		double motion_rate = 200;
+		//! Standard deviations of the gyroscope (rad/s) and accelerometer (m/s^2) noise.
+		double gyro_noise = 0;
+		double accel_noise = 0;
+		unsigned seed = 0x2017;
+		//! Time frame 0 is shot at. The frames and the motion samples are stamped from it,
+		//	so pass the time the frames start being fed, such as steady_clock::now(), when
+		//	they are compared with the clock of the engine.
+		std::chrono::steady_clock::time_point start_time;
+	};
+
+	//! The class SyntheticScene renders textured planar and box scenes along a scripted
+	//	camera trajectory. All outputs are deterministic given the seed, so the tracker
+	//	can be benchmarked offline against known poses. The world coordinate has its
+	//	y-axis pointing down, the same as the camera coordinate.
+	class COMMON_API SyntheticScene {
+	public:
+		typedef SyntheticSceneOptions Options;
+
+		SyntheticScene(const Options& options = Options());
+
+		//! A scene with a textured floor, a back wall carrying a television and a box,
+		//	watched by a camera sweeping in front of the wall for the given duration.
+		static SyntheticScene CreateLivingRoom(const Options& options = Options(), double duration = 10);
+
+		void AddQuad(const SyntheticQuad& quad);
+		//! Add a randomly textured rectangle spanned by two half-extent vectors from its center.
+		void AddPlane(const cv::Point3d& center, const cv::Vec3d& half_right, const cv::Vec3d& half_down);
+		//! Add a randomly textured box with axis-aligned faces.
+		void AddBox(const cv::Point3d& center, const cv::Vec3d& half_size);
+		//! Add a television-like rectangle: a dark screen inside a bezel. The screen
+		//	corners are reported as ground truth in every SyntheticFrame.
+		void AddTelevision(const cv::Point3d& center,
+						   const cv::Vec3d& half_right,
+						   const cv::Vec3d& half_down);
+		void SetTrajectory(const std::vector<CameraWaypoint>& waypoints);
+
+		//! The camera matrix to set as the intrinsics of the AR engine.
+		cv::Mat Intrinsics() const;
+		int FrameCount() const;
+		void GetPose(double time, cv::Matx33d& R, cv::Vec3d& t) const;
+
+		//! Render a single frame. This method does not modify the scene, so it can be
+		//	called from several threads at once.
+		ERROR_CODE Render(int frame_id, SyntheticFrame& frame) const;
+		//! Render consecutive frames in parallel.
+		ERROR_CODE RenderBatch(int first_frame_id, int count, std::vector<SyntheticFrame>& frames) const;
+	private:
+		Options options_;
+		std::vector<SyntheticQuad> quads_;
+		std::vector<SyntheticQuad> screens_;
+		std::vector<CameraWaypoint> waypoints_;
+		cv::RNG rng_;
+
+		cv::Mat GenTexture(cv::Size size);
+		cv::Point3d GetPosition(double time) const;
+		double FrameTime(int frame_id) const;
+		void DrawQuad(const SyntheticQuad& quad, const cv::Matx33d& R, const cv::Vec3d& t, cv::Mat& image) const;
+		void SimulateMotion(int frame_id, std::vector<MotionData>& motion) const;
+	};
+
+	//! Stream frames from a synthetic scene. Frames are rendered ahead in parallel
+	//	batches, so thousands of frames can be generated on the fly. The stream shares
+	//	the ownership of the scene, so it may outlive the scene it was given.
+	class COMMON_API SyntheticSceneStream : public FrameStream {
+		std::shared_ptr<const SyntheticScene> scene_;
+		int batch_size_;
+		int next_frame_id_ = 0;
+		int batch_pos_ = 0;
+		std::vector<SyntheticFrame> batch_;
+	public:
+		//! @param batch_size Number of frames rendered at once. Zero picks twice the number of threads.
+		SyntheticSceneStream(std::shared_ptr<const SyntheticScene> scene, int batch_size = 0);
+		inline void Restart() { next_frame_id_ = 0; batch_pos_ = 0; batch_.clear(); }
+		ERROR_CODE NextFrame(cv::Mat& outputBuf);
+		//! Ground truth of the frame last returned by NextFrame.
+		inline const SyntheticFrame& LastFrame() const { return batch_[batch_pos_ - 1]; }
+	};
+}
+
+#endif // !SYNTHETICSCENE_H
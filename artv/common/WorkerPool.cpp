@@ -0,0 +1,298 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <algorithm>
+#include <exception>
+#include <opencv2/core.hpp>
+
+#include <common/WorkerPool.h>
+
+using namespace std;
+
+namespace ar {
+	namespace {
+		thread_local const WorkerPool* current_pool = NULL;
+		thread_local int current_worker = -1;
+
+		//! A parallel loop, shared with the tasks helping with it, which may only get to
+		//	run after the loop has returned.
+		struct LoopState {
+			//! Only used while some chunk is left, so the caller still waits for the loop.
+			const WorkerPool::RangeBody* body;
+			int begin, end, chunk, num_chunks;
+			atomic<int> next_chunk;
+			atomic<int> done_chunks;
+			mutex done_mutex;
+			condition_variable done_cond;
+			//! The first exception thrown by the body, guarded by done_mutex.
+			exception_ptr error;
+		};
+
+		//! Run the chunks of a loop until none is left. A chunk that throws stops the
+		//	loop: the chunks not taken yet are counted as done without running.
+		void RunChunks(LoopState& loop) {
+			for (;;) {
+				int c = loop.next_chunk++;
+				if (c >= loop.num_chunks)
+					return;
+				int finished = 1;
+				int begin = loop.begin + c * loop.chunk;
+				try {
+					(*loop.body)(begin, min(begin + loop.chunk, loop.end));
+				}
+				catch (...) {
+					lock_guard<mutex> lock(loop.done_mutex);
+					if (!loop.error)
+						loop.error = current_exception();
+					finished += max(0, loop.num_chunks - loop.next_chunk.exchange(loop.num_chunks));
+				}
+				if ((loop.done_chunks += finished) == loop.num_chunks) {
+					lock_guard<mutex> lock(loop.done_mutex);
+					loop.done_cond.notify_all();
+				}
+			}
+		}
+	}
+
+	WorkerPool::WorkerPool(int num_threads) : pending_(0), failed_(0) {
+		for (auto& queued : queued_)
+			queued = 0;
+		if (num_threads <= 0)
+			num_threads = max(1, int(thread::hardware_concurrency()));
+		for (int i = 0; i < num_threads; ++i)
+			queues_.emplace_back(new WorkerQueue);
+		threads_.reserve(num_threads);
+		for (int i = 0; i < num_threads; ++i)
+			threads_.emplace_back(&WorkerPool::WorkerLoop, this, i);
+	}
+
+	WorkerPool::~WorkerPool() {
+		{
+			lock_guard<mutex> lock(mutex_);
+			stop_ = true;
+		}
+		task_cond_.notify_all();
+		for (auto& t : threads_)
+			t.join();
+	}
+
+	int WorkerPool::CurrentWorker() const {
+		return current_pool == this ? current_worker : -1;
+	}
+
+	int WorkerPool::Queued() const {
+		int total = 0;
+		for (auto& queued : queued_)
+			total += queued;
+		return total;
+	}
+
+	void WorkerPool::Enqueue(WorkerQueue& queue, Task&& task, TaskPriority priority) {
+		++pending_;
+		{
+			lock_guard<mutex> lock(queue.mutex);
+			queue.tasks[priority].push_back(move(task));
+		}
+		{
+			// Taking the lock makes sure a worker about to sleep sees the new task.
+			lock_guard<mutex> lock(mutex_);
+			++queued_[priority];
+		}
+		task_cond_.notify_one();
+	}
+
+	void WorkerPool::Submit(Task task, TaskPriority priority) {
+		int ind = CurrentWorker();
+		Enqueue(ind < 0 ? global_queue_ : *queues_[ind], move(task), priority);
+	}
+
+	void WorkerPool::Post(Task task, TaskPriority priority) {
+		Enqueue(global_queue_, move(task), priority);
+	}
+
+	void WorkerPool::WaitIdle() {
+		unique_lock<mutex> lock(mutex_);
+		idle_cond_.wait(lock, [this] { return pending_ == 0; });
+	}
+
+	bool WorkerPool::TryGetTask(int ind, TaskPriority max_priority, Task& task) {
+		int n = int(queues_.size());
+		for (int p = 0; p <= max_priority; ++p) {
+			if (queued_[p] == 0)
+				continue;
+			// The latest task of its own first, as its data is likely still in the cache.
+			if (ind >= 0) {
+				auto& own = queues_[ind]->tasks[p];
+				lock_guard<mutex> lock(queues_[ind]->mutex);
+				if (!own.empty()) {
+					task = move(own.back());
+					own.pop_back();
+					--queued_[p];
+					return true;
+				}
+			}
+			{
+				auto& global = global_queue_.tasks[p];
+				lock_guard<mutex> lock(global_queue_.mutex);
+				if (!global.empty()) {
+					task = move(global.front());
+					global.pop_front();
+					--queued_[p];
+					return true;
+				}
+			}
+			// Steal the oldest task of another worker.
+			for (int i = ind < 0 ? 0 : 1; i < n; ++i) {
+				auto& victim = *queues_[(max(ind, 0) + i) % n];
+				lock_guard<mutex> lock(victim.mutex);
+				if (!victim.tasks[p].empty()) {
+					task = move(victim.tasks[p].front());
+					victim.tasks[p].pop_front();
+					--queued_[p];
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	void WorkerPool::RunTask(Task& task) {
+		// Counts the task out even if it throws, so that the waiters are not left hanging.
+		struct PendingGuard {
+			WorkerPool& pool;
+			~PendingGuard() {
+				if (--pool.pending_ == 0) {
+					lock_guard<mutex> lock(pool.mutex_);
+					pool.idle_cond_.notify_all();
+				}
+			}
+		} guard{ *this };
+		try {
+			task();
+		}
+		catch (...) {
+			++failed_;
+		}
+	}
+
+	bool WorkerPool::TryRunTask(TaskPriority max_priority) {
+		Task task;
+		if (!TryGetTask(CurrentWorker(), max_priority, task))
+			return false;
+		RunTask(task);
+		return true;
+	}
+
+	void WorkerPool::ParallelFor(int begin, int end, const RangeBody& body, TaskPriority priority, int grain) {
+		int n = end - begin;
+		if (n <= 0)
+			return;
+		// A few chunks per thread, so that uneven iterations still balance.
+		int max_chunks = 4 * (NumThreads() + 1);
+		int chunk = max(max(grain, 1), (n + max_chunks - 1) / max_chunks);
+		int num_chunks = (n + chunk - 1) / chunk;
+		if (num_chunks == 1) {
+			body(begin, end);
+			return;
+		}
+
+		auto loop = make_shared<LoopState>();
+		loop->body = &body;
+		loop->begin = begin;
+		loop->end = end;
+		loop->chunk = chunk;
+		loop->num_chunks = num_chunks;
+		loop->next_chunk = 0;
+		loop->done_chunks = 0;
+		int num_helpers = min(num_chunks - 1, NumThreads());
+		for (int i = 0; i < num_helpers; ++i)
+			Submit([loop] { RunChunks(*loop); }, priority);
+		RunChunks(*loop);
+		// Chunks taken by the helpers may still be running, and use the body even if
+		// another chunk has thrown.
+		unique_lock<mutex> lock(loop->done_mutex);
+		loop->done_cond.wait(lock, [&] { return loop->done_chunks == num_chunks; });
+		if (loop->error)
+			rethrow_exception(loop->error);
+	}
+
+	void WorkerPool::WorkerLoop(int ind) {
+		current_pool = this;
+		current_worker = ind;
+		for (;;) {
+			Task task;
+			if (TryGetTask(ind, TaskPriority(NUM_TASK_PRIORITIES - 1), task)) {
+				RunTask(task);
+				continue;
+			}
+			unique_lock<mutex> lock(mutex_);
+			if (stop_ && Queued() == 0)
+				break;
+			task_cond_.wait(lock, [this] { return stop_ || Queued() > 0; });
+		}
+		current_pool = NULL;
+		current_worker = -1;
+	}
+
+	void ParallelFor(WorkerPool* pool, int begin, int end, const WorkerPool::RangeBody& body,
+					 TaskPriority priority, int grain) {
+		if (pool) {
+			pool->ParallelFor(begin, end, body, priority, grain);
+			return;
+		}
+		grain = max(grain, 1);
+		cv::parallel_for_(cv::Range(begin, end), [&](const cv::Range& range) {
+			body(range.start, range.end);
+		}, double((end - begin + grain - 1) / grain));
+	}
+
+	TaskGroup::TaskGroup(WorkerPool& pool, TaskPriority priority) :
+		pool_(pool), priority_(priority), pending_(0), cancelled_(false) {}
+
+	TaskGroup::~TaskGroup() {
+		Wait();
+	}
+
+	void TaskGroup::Run(WorkerPool::Task task) {
+		if (cancelled_)
+			return;
+		++pending_;
+		pool_.Submit([this, task] {
+			exception_ptr error;
+			if (!cancelled_) {
+				try {
+					task();
+				}
+				catch (...) {
+					error = current_exception();
+				}
+			}
+			// Under the lock, so that a waiter cannot destroy the group before it is notified.
+			lock_guard<mutex> lock(mutex_);
+			if (error && !error_)
+				error_ = error;
+			if (--pending_ == 0)
+				done_cond_.notify_all();
+		}, priority_);
+	}
+
+	void TaskGroup::Wait() {
+		while (pending_ > 0 && pool_.TryRunTask(priority_));
+		unique_lock<mutex> lock(mutex_);
+		done_cond_.wait(lock, [this] { return pending_ == 0; });
+	}
+
+	void TaskGroup::Cancel() {
+		cancelled_ = true;
+	}
+
+	exception_ptr TaskGroup::TakeError() {
+		lock_guard<mutex> lock(mutex_);
+		exception_ptr error = error_;
+		error_ = NULL;
+		return error;
+	}
+}
@@ -0,0 +1,159 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	//! Priorities of the tasks, highest first. A worker takes the tasks of a higher
+	//	priority from every queue before any of a lower one.
+	enum TaskPriority {
+		//! Work on the frame being tracked, which the latency of the session waits on.
+		TASK_TRACKING,
+		//! Drawing the virtual objects onto a frame.
+		TASK_COMPOSITING,
+		//! Refining the map in the background.
+		TASK_MAPPING,
+		NUM_TASK_PRIORITIES
+	};
+
+	//! The class WorkerPool runs tasks on a fixed set of threads with work stealing.
+	//	Every worker has its own queue. Tasks submitted from a worker go to its own
+	//	queue and are run last-in-first-out, while idle workers steal the oldest tasks
+	//	from the others. Tasks posted from outside, or posted to take turns with other
+	//	tasks, go through a shared first-in-first-out queue. Each queue is split by
+	//	priority.
+	class COMMON_API WorkerPool {
+	public:
+		typedef std::function<void()> Task;
+		//! Body of a parallel loop, run on the range [begin, end).
+		typedef std::function<void(int begin, int end)> RangeBody;
+
+		//! @param num_threads Number of workers. Zero for one per hardware thread.
+		explicit WorkerPool(int num_threads = 0);
+		//! Run the queued tasks, then stop the workers.
+		~WorkerPool();
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		//! Run a task on the pool. Called on a worker, the task is queued on that worker.
+		void Submit(Task task, TaskPriority priority = TASK_TRACKING);
+		//! Queue a task behind all the tasks of its priority posted before it.
+		void Post(Task task, TaskPriority priority = TASK_TRACKING);
+		//! Wait until no task is queued or running. Must not be called on a worker.
+		void WaitIdle();
+		//! Run one queued task of the priority or a higher one on the calling thread,
+		//	which need not be a worker. For waiting threads to help instead of blocking.
+		//	@return False if there was no such task.
+		bool TryRunTask(TaskPriority max_priority = TASK_MAPPING);
+		//! Run a loop body over [begin, end) in chunks of at least grain iterations, on
+		//	the workers and the calling thread, and return when all are done. The caller
+		//	runs chunks itself, so it may be called from a task without deadlocking.
+		//	If the body throws, the chunks not started yet are skipped, and the first
+		//	exception is rethrown once the running chunks are done.
+		void ParallelFor(int begin, int end, const RangeBody& body,
+						 TaskPriority priority = TASK_TRACKING, int grain = 1);
+
+		inline int NumThreads() const { return int(threads_.size()); }
+		//! Number of tasks that threw. Tasks are to handle their own errors: one that
+		//	throws anyway is dropped, and the worker carries on.
+		inline int FailedTasks() const { return failed_; }
+		//! Index of the worker running the calling thread, or -1 if it is not a worker of this pool.
+		int CurrentWorker() const;
+
+	private:
+		struct WorkerQueue {
+			std::mutex mutex;
+			std::deque<Task> tasks[NUM_TASK_PRIORITIES];
+		};
+		std::vector<std::unique_ptr<WorkerQueue>> queues_;
+		WorkerQueue global_queue_;
+		std::vector<std::thread> threads_;
+
+		std::mutex mutex_;
+		std::condition_variable task_cond_;
+		std::condition_variable idle_cond_;
+		bool stop_ = false;
+		//! Number of tasks of each priority queued but not taken yet.
+		std::atomic<int> queued_[NUM_TASK_PRIORITIES];
+		//! Number of tasks queued or running.
+		std::atomic<int> pending_;
+		std::atomic<int> failed_;
+
+		int Queued() const;
+		void Enqueue(WorkerQueue& queue, Task&& task, TaskPriority priority);
+		//! Take a task of the priority or a higher one.
+		//	@param ind Index of the calling worker, or -1 for another thread.
+		bool TryGetTask(int ind, TaskPriority max_priority, Task& task);
+		void RunTask(Task& task);
+		void WorkerLoop(int ind);
+	};
+
+	//! Run a loop body on a pool, or with cv::parallel_for_ if there is none.
+	COMMON_API void ParallelFor(WorkerPool* pool, int begin, int end, const WorkerPool::RangeBody& body,
+								TaskPriority priority = TASK_TRACKING, int grain = 1);
+
+	//! The class TaskGroup runs tasks of one priority on a pool and joins them. Cancelling
+	//	the group skips its tasks not started yet, and long tasks may poll IsCancelled to
+	//	stop early, so that an owner can shut down without waiting for queued work.
+	//	The group waits for its tasks when destroyed.
+	class COMMON_API TaskGroup {
+	public:
+		TaskGroup(WorkerPool& pool, TaskPriority priority);
+		~TaskGroup();
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+		//! Queue a task of the group. Ignored once the group is cancelled.
+		void Run(WorkerPool::Task task);
+		//! Wait until the tasks of the group are done, running queued tasks of the pool
+		//	meanwhile, of the priority of the group or a higher one.
+		void Wait();
+		//! Skip the tasks not started yet. The group stays cancelled.
+		void Cancel();
+		inline bool IsCancelled() const { return cancelled_; }
+		//! Number of tasks of the group queued or running.
+		inline int Pending() const { return pending_; }
+		//! The first exception thrown by a task of the group since the last call, or null.
+		//	A task that throws does not stop the others.
+		std::exception_ptr TakeError();
+
+	private:
+		WorkerPool& pool_;
+		TaskPriority priority_;
+		std::atomic<int> pending_;
+		std::atomic<bool> cancelled_;
+		std::mutex mutex_;
+		std::condition_variable done_cond_;
+		//! Guarded by mutex_.
+		std::exception_ptr error_;
+	};
+}
+
+#endif // !WORKERPOOL_H
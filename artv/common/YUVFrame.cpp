@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#include <opencv2/imgproc.hpp>
+
+#include <common/YUVFrame.h>
+
+using namespace std;
+using namespace cv;
+
+namespace ar {
+	bool YUVFrame::IsValid() const {
+		if (width <= 0 || height <= 0 || !y || !u || y_stride < size_t(width))
+			return false;
+		if (format == YUV_I420)
+			return v && u_stride >= size_t(ChromaWidth()) && v_stride >= size_t(ChromaWidth());
+		return u_stride >= size_t(ChromaWidth() * 2);
+	}
+
+	YUVFrame YUVFrame::FromMat(const Mat& yuv, YUVFormat format) {
+		CV_Assert(yuv.type() == CV_8UC1 && yuv.rows % 3 == 0 && yuv.cols % 2 == 0);
+		YUVFrame frame;
+		frame.format = format;
+		frame.width = yuv.cols;
+		frame.height = yuv.rows * 2 / 3;
+		frame.y = const_cast<uchar*>(yuv.ptr(0));
+		frame.y_stride = yuv.step;
+		frame.u = const_cast<uchar*>(yuv.ptr(frame.height));
+		if (format == YUV_I420) {
+			// The chroma planes follow the Y plane back to back.
+			CV_Assert(yuv.isContinuous());
+			frame.u_stride = frame.v_stride = frame.ChromaWidth();
+			frame.v = frame.u + frame.ChromaWidth() * frame.ChromaHeight();
+		}
+		else
+			frame.u_stride = yuv.step;
+		frame.owner = make_shared<Mat>(yuv);
+		return frame;
+	}
+
+	void YUVFrame::ToBGR(Mat& bgr) const {
+		CV_Assert(IsValid() && width % 2 == 0 && height % 2 == 0);
+		// Gather the planes into the layout taken by cvtColor.
+		Mat packed(height * 3 / 2, width, CV_8UC1);
+		Luma().copyTo(packed.rowRange(0, height));
+		int chroma_bytes = ChromaWidth() * ChromaHeight();
+		if (format == YUV_I420) {
+			PlaneU().copyTo(Mat(ChromaHeight(), ChromaWidth(), CV_8UC1, packed.ptr(height)));
+			PlaneV().copyTo(Mat(ChromaHeight(), ChromaWidth(), CV_8UC1, packed.ptr(height) + chroma_bytes));
+			cvtColor(packed, bgr, COLOR_YUV2BGR_I420);
+		}
+		else {
+			InterleavedChroma().copyTo(Mat(ChromaHeight(), ChromaWidth(), CV_8UC2, packed.ptr(height)));
+			cvtColor(packed, bgr, format == YUV_NV12 ? COLOR_YUV2BGR_NV12 : COLOR_YUV2BGR_NV21);
+		}
+	}
+}
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////
+// AR Television
+// Copyright(c) 2017 Carnegie Mellon University
+// Licensed under The MIT License[see LICENSE for details]
+// Written by Kai Yu, Zhongxu Wang, Ruoyuan Zhao, Qiqi Xiao
+///////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef YUVFRAME_H
+#define YUVFRAME_H
+
+#include <memory>
+#include <opencv2/core.hpp>
+
+#ifdef _WIN32
+#ifdef COMMON_EXPORTS
+#define COMMON_API __declspec(dllexport)
+#else
+#define COMMON_API __declspec(dllimport)
+#endif
+#else
+#define COMMON_API
+#endif
+
+namespace ar
+{
+	enum YUVFormat {
+		//! Y plane, then a plane of interleaved U and V.
+		YUV_NV12,
+		//! Y plane, then a plane of interleaved V and U.
+		YUV_NV21,
+		//! Y plane, U plane and V plane.
+		YUV_I420
+	};
+
+	//! The struct YUVFrame refers to a YUV 4:2:0 frame in buffers given by pointers and
+	//	strides, as camera and decoder outputs are, so that they can be used without a
+	//	copy. The chroma planes have half the width and height of the frame, rounded up.
+	struct COMMON_API YUVFrame {
+		YUVFormat format = YUV_NV12;
+		int width = 0;
+		int height = 0;
+		uchar* y = NULL;
+		size_t y_stride = 0;
+		//! The interleaved chroma plane of NV12 and NV21, or the U plane of I420.
+		uchar* u = NULL;
+		size_t u_stride = 0;
+		//! The V plane of I420. Not used by NV12 and NV21.
+		uchar* v = NULL;
+		size_t v_stride = 0;
+		//! Keeps the buffers alive as long as the frame is referred to. Leave it null
+		//	if the caller owns the buffers and keeps them valid.
+		std::shared_ptr<void> owner;
+
+		inline int ChromaWidth() const { return (width + 1) / 2; }
+		inline int ChromaHeight() const { return (height + 1) / 2; }
+		bool IsValid() const;
+
+		inline cv::Mat Luma() const { return cv::Mat(height, width, CV_8UC1, y, y_stride); }
+		//! The chroma plane of NV12 or NV21, of type CV_8UC2.
+		inline cv::Mat InterleavedChroma() const { return cv::Mat(ChromaHeight(), ChromaWidth(), CV_8UC2, u, u_stride); }
+		inline cv::Mat PlaneU() const { return cv::Mat(ChromaHeight(), ChromaWidth(), CV_8UC1, u, u_stride); }
+		inline cv::Mat PlaneV() const { return cv::Mat(ChromaHeight(), ChromaWidth(), CV_8UC1, v, v_stride); }
+
+		//! Refer to a single-channel Mat of height * 3 / 2 rows holding a whole frame, as
+		//	given by cvtColor to YUV_I420 or by cameras in NV12. The Mat is kept as owner.
+		static YUVFrame FromMat(const cv::Mat& yuv, YUVFormat format);
+		//! Convert the frame to BGR, for display. Width and height must be even.
+		void ToBGR(cv::Mat& bgr) const;
+	};
+}
+
+#endif // !YUVFRAME_H
@@ -8,8 +8,11 @@
 
 #include <opencv2/opencv.hpp>
 
+#include <common/FramePipeline.h>
 #include <common/OSUtils.h>
 #include <ar_engine/AREngine.h>
+#include <ar_engine/SessionRecorder.h>
+#include <ar_engine/SessionReplayer.h>
 
 using namespace std;
 using namespace cv;
@@ -18,6 +21,8 @@ using namespace ar;
 struct MouseListenerMemory {
 	int holding_obj_id;
 	bool left_down = false;
+	// Whether the object held by the left button has been dragged.
+	bool dragging = false;
 	bool middle_down = false;
 	bool right_down = false;
 	// Location of the mouse on pressing down the left button.
@@ -28,15 +33,19 @@ struct MouseListenerMemory {
 	int rdx, rdy;
 	AREngine* ar_engine;
 	FrameStream* tv_show;
+	// Null if the session is not recorded.
+	SessionRecorder* session_recorder = NULL;
 };
 
 void RespondMouseAction(int event, int x, int y, int flags, void* p) {
 	MouseListenerMemory* mem = (MouseListenerMemory*)p;
 	auto ar_engine = mem->ar_engine;
+	auto session_recorder = mem->session_recorder;
 	switch (event) {
 	case EVENT_LBUTTONDOWN:
 		if (!mem->right_down) {
 			mem->left_down = true;
+			mem->dragging = false;
 			mem->ldx = x;
 			mem->ldy = y;
 			mem->holding_obj_id = ar_engine->GetTopVObj(x, y);
@@ -57,47 +66,120 @@ void RespondMouseAction(int event, int x, int y, int flags, void* p) {
 		break;
 	case EVENT_LBUTTONUP:
 		if (mem->left_down) {
-			// Place a television here!
-			ar_engine->CreateTelevision(cv::Point(x, y), *mem->tv_show);
+			if (mem->dragging) {
+				// Drop the television, which finds its new anchor in the background.
+				ar_engine->FixVObj(mem->holding_obj_id);
+				if (session_recorder)
+					session_recorder->RecordFix(mem->holding_obj_id);
+			}
+			else {
+				// Place a television here!
+				int id = -1;
+				ar_engine->CreateTelevision(cv::Point(x, y), *mem->tv_show, &id);
+				if (session_recorder)
+					session_recorder->RecordCreateTelevision(cv::Point(x, y), id);
+			}
 			mem->left_down = false;
+			mem->dragging = false;
 			break;
 		}
 	case EVENT_RBUTTONUP:
 		if (mem->right_down) {
-			if (mem->holding_obj_id != -1)
+			if (mem->holding_obj_id != -1) {
 				ar_engine->RemoveVObject(mem->holding_obj_id);
+				if (session_recorder)
+					session_recorder->RecordRemove(mem->holding_obj_id);
+			}
 			mem->right_down = false;
 		}
 		break;
 	case EVENT_MBUTTONUP:
 		break;
 	case EVENT_MOUSEMOVE:
-		if (mem->left_down)
+		// A few pixels of jitter of a click do not start a drag.
+		if (mem->left_down && mem->holding_obj_id != -1 && abs(x - mem->ldx) + abs(y - mem->ldy) > 3)
+			mem->dragging = true;
+		if (mem->dragging) {
+			// The engine only keeps the latest location until the next frame.
 			ar_engine->DragVObj(mem->holding_obj_id, x, y);
+			if (session_recorder)
+				session_recorder->RecordDrag(mem->holding_obj_id, x, y);
+		}
 		break;
 	default:
 		break;
 	}
 }
 
+void PrintUsage() {
+	cout << "Usage: offline_demo [scene_video_path] [tv_show_path] [--calib calibration_path] [--record session_path] [--semi-direct]" << endl
+		<< "       offline_demo --replay [session_path] [tv_show_path] [--fast] [--semi-direct]" << endl;
+}
+
+int Replay(const char* session_path, FrameStream& tv_show, bool fast, bool semi_direct) {
+	SessionReplayer replayer;
+	auto ret = replayer.Open(session_path);
+	if (ret < 0) {
+		cerr << "Cannot open the session: " << ErrCode2Msg(ret) << endl;
+		return -1;
+	}
+	// The tracker is overridden in the recorded configs, so that both can be timed on
+	// the same session.
+	if (semi_direct)
+		replayer.SetConfigFilter([](AREngineConfig& config) { config.tracker_type = TRACKER_SEMI_DIRECT; });
+	AREngine ar_engine;
+	namedWindow("Mixed scene");
+	ReplayStats stats;
+	ret = replayer.Replay(ar_engine, tv_show, fast ? REPLAY_FAST : REPLAY_REAL_TIME,
+						  [](int, const Mat& mixed_scene) {
+		imshow("Mixed scene", mixed_scene);
+		waitKey(1);
+	}, &stats);
+	if (ret < 0) {
+		cerr << "Replay failed: " << ErrCode2Msg(ret) << endl;
+		return -1;
+	}
+	cout << stats.frames << " frames and " << stats.actions << " actions replayed in " << stats.wall_ms << "ms. "
+		<< "Mean frame time " << (stats.frames ? stats.total_frame_ms / stats.frames : 0) << "ms, "
+		<< "max " << stats.max_frame_ms << "ms." << endl;
+	return 0;
+}
+
 int main(int argc, char* argv[]) {
-	if (argc < 3) {
-		cout << "Usage: offline_demo [scene_video_path] [tv_show_path]" << endl;
+	const char* positional[2] = { NULL, NULL };
+	int num_positional = 0;
+	const char* calibration_path = NULL;
+	const char* session_path = NULL;
+	bool replay = false, fast = false, semi_direct = false;
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "--calib" && i + 1 < argc)
+			calibration_path = argv[++i];
+		else if (arg == "--record" && i + 1 < argc)
+			session_path = argv[++i];
+		else if (arg == "--replay" && i + 1 < argc) {
+			replay = true;
+			session_path = argv[++i];
+		}
+		else if (arg == "--fast")
+			fast = true;
+		else if (arg == "--semi-direct")
+			semi_direct = true;
+		else if (num_positional < 2 && arg.compare(0, 2, "--"))
+			positional[num_positional++] = argv[i];
+		else {
+			PrintUsage();
+			AR_PAUSE;
+			return 0;
+		}
+	}
+	if (num_positional < (replay ? 1 : 2)) {
+		PrintUsage();
 		AR_PAUSE;
 		return 0;
 	}
 
-	const char* scene_video_path = argv[1];
-	const char* movie_path = argv[2];
-	
-	VideoCapture cap(scene_video_path);
-	if (!cap.isOpened()) {
-		cerr << "Cannot open the scene video at " << scene_video_path
-			<< "! Please check the path and read permission of the video" << endl;
-		AR_PAUSE;
-		return -1;
-	}
-	
+	const char* movie_path = replay ? positional[0] : positional[1];
 	RealtimeLocalVideoStream tv_show;
 	auto ret = tv_show.Open(movie_path);
 	if (ret < 0) {
@@ -105,14 +187,55 @@ int main(int argc, char* argv[]) {
 		AR_PAUSE;
 		return -1;
 	}
+	if (replay)
+		return Replay(session_path, tv_show, fast, semi_direct);
+
+	const char* scene_video_path = positional[0];
+	// Decoding and encoding run on threads of their own, so that the main loop only
+	// does the AR work. No scene frame is dropped, as the video is a file.
+	AsyncCapture cap;
+	if (cap.Open(scene_video_path) < 0) {
+		cerr << "Cannot open the scene video at " << scene_video_path
+			<< "! Please check the path and read permission of the video" << endl;
+		AR_PAUSE;
+		return -1;
+	}
 
 	AREngine ar_engine;
+	if (semi_direct) {
+		AREngineConfig config = ar_engine.GetConfig();
+		config.tracker_type = TRACKER_SEMI_DIRECT;
+		ar_engine.SetConfig(config);
+	}
+	if (calibration_path) {
+		CameraModel camera;
+		ret = CameraModel::Load(calibration_path, camera);
+		if (ret < 0) {
+			cerr << "Cannot load the camera calibration: " << ErrCode2Msg(ret) << endl;
+			AR_PAUSE;
+			return -1;
+		}
+		ar_engine.SetCameraModel(camera);
+	}
 
-	double width = cap.get(VideoCaptureProperties::CAP_PROP_FRAME_WIDTH);
-	double height = cap.get(VideoCaptureProperties::CAP_PROP_FRAME_HEIGHT);
-	VideoWriter recorder("demo.avi", VideoWriter::fourcc('M', 'J', 'P', 'G'), 10, Size(width, height));
+	SessionRecorder session_recorder;
+	if (session_path) {
+		ret = session_recorder.Open(session_path);
+		if (ret < 0) {
+			cerr << "Cannot record the session: " << ErrCode2Msg(ret) << endl;
+			AR_PAUSE;
+			return -1;
+		}
+		session_recorder.RecordConfig(ar_engine.GetConfig());
+		if (calibration_path)
+			session_recorder.RecordCamera(ar_engine.GetCameraModel());
+	}
 
-	Mat raw_scene, mixed_scene;
+	AsyncEncoder recorder;
+	recorder.Open("demo.avi", VideoWriter::fourcc('M', 'J', 'P', 'G'), 10, cap.GetFrameSize());
+
+	FrameRef raw_scene;
+	Mat mixed_scene;
 	//Create the windows
 	namedWindow("Origin scene");
 	namedWindow("Mixed scene");
@@ -120,19 +243,38 @@ int main(int argc, char* argv[]) {
 	MouseListenerMemory mem;
 	mem.ar_engine = &ar_engine;
 	mem.tv_show = &tv_show;
+	if (session_path)
+		mem.session_recorder = &session_recorder;
 	setMouseCallback("Origin scene", RespondMouseAction, &mem);
 	setMouseCallback("Mixed scene", RespondMouseAction, &mem);
+	vector<vector<Point2f>> suggestions;
 	while (true) {
-		cap >> raw_scene;
-		if (raw_scene.empty())
+		if (cap.Read(raw_scene) < 0)
 			break;
-		imshow("Origin scene", raw_scene);
+		imshow("Origin scene", raw_scene->image);
 
-		ar_engine.GetMixedScene(raw_scene, mixed_scene);
-		recorder << mixed_scene;
-		imshow("Mixed scene", mixed_scene);
+		if (session_path)
+			session_recorder.RecordFrame(raw_scene->image);
+		ar_engine.GetMixedScene(raw_scene->image, mixed_scene);
+		recorder.Write(mixed_scene);
+		// Outline where a click would place a television, on the displayed copy only.
+		ar_engine.GetPlacementSuggestions(suggestions);
+		if (suggestions.empty())
+			imshow("Mixed scene", mixed_scene);
+		else {
+			Mat shown = mixed_scene.clone();
+			for (auto& quad : suggestions) {
+				vector<Point> outline(quad.begin(), quad.end());
+				polylines(shown, outline, true, Scalar(0, 255, 255), 2);
+			}
+			imshow("Mixed scene", shown);
+		}
 		waitKey(1);
+		// Without objects, the mixed scene is the raw scene itself, whose buffer goes back
+		// to the pool and must not be written as the next mixed scene.
+		if (mixed_scene.data == raw_scene->image.data)
+			mixed_scene.release();
 	}
 
 	return 0;
-}
\ No newline at end of file
+}